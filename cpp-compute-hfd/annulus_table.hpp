@@ -0,0 +1,138 @@
+// Precomputed background annulus geometry, cached per thread
+// Replaces per-call mask rasterization (cv::Mat + 2x cv::circle + cv::findNonZero)
+// with a list of row spans relative to the annulus center
+// Requires: C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+constexpr int kAnnulusSubPixelBuckets = 4;  // Center quantization (per pixel, per axis) for sub-pixel annuli
+
+// Contiguous run of annulus pixels in one row, relative to the anchor pixel
+struct AnnulusSpan {
+  int dy;
+  int dx;       // First column
+  int length;
+};
+
+struct AnnulusTable {
+  int minRadius = 0;
+  int maxRadius = 0;
+  int subPixelBuckets = 1;        // 1 = cv::circle mask semantics (anchor = rounded center)
+  std::vector<AnnulusSpan> spans; // Raster order
+  size_t pixelCount = 0;
+};
+
+// Half-width of each row of a filled cv::circle (default LINE_8, no shift),
+// reproducing OpenCV's midpoint rasterization so the pixel set is identical
+inline void circleHalfWidths(int radius, std::vector<int>& halfWidths) {
+  halfWidths.assign(static_cast<size_t>(std::max(radius, 0)) + 1, -1);
+  if (radius < 0) return;
+  int err = 0, dx = radius, dy = 0, plus = 1, minus = (radius << 1) - 1;
+  while (dx >= dy) {
+    halfWidths[dy] = std::max(halfWidths[dy], dx);
+    halfWidths[dx] = std::max(halfWidths[dx], dy);
+    dy++;
+    err += plus;
+    plus += 2;
+    const int mask = (err <= 0) - 1;
+    err -= minus & mask;
+    dx += mask;
+    minus -= mask & 2;
+  }
+}
+
+// Annulus matching computeBackgroundStats' mask: filled maxRadius circle minus
+// filled minRadius circle, both around the rounded center
+inline AnnulusTable buildCircleMaskAnnulus(int minRadius, int maxRadius) {
+  AnnulusTable table;
+  table.minRadius = minRadius;
+  table.maxRadius = maxRadius;
+  if (maxRadius < 0) return table;
+
+  std::vector<int> outer, inner;
+  circleHalfWidths(maxRadius, outer);
+  circleHalfWidths(minRadius, inner);
+
+  auto addSpan = [&table](int dy, int first, int last) {
+    if (last < first) return;
+    table.spans.push_back(AnnulusSpan{dy, first, last - first + 1});
+    table.pixelCount += static_cast<size_t>(last - first + 1);
+  };
+
+  for (int dy = -maxRadius; dy <= maxRadius; ++dy) {
+    const int ady = std::abs(dy);
+    const int outerHalf = outer[ady];
+    const int innerHalf = (minRadius >= 0 && ady <= minRadius) ? inner[ady] : -1;
+    if (innerHalf < 0) {
+      addSpan(dy, -outerHalf, outerHalf);
+    } else {
+      addSpan(dy, -outerHalf, -innerHalf - 1);
+      addSpan(dy, innerHalf + 1, outerHalf);
+    }
+  }
+  return table;
+}
+
+// Annulus minRadius < r <= maxRadius measured from pixel centers to a center at
+// fractional offset (fx, fy) inside the anchor pixel (anchor = floor(center))
+inline AnnulusTable buildSubPixelAnnulus(int minRadius, int maxRadius, double fx, double fy, int buckets) {
+  AnnulusTable table;
+  table.minRadius = minRadius;
+  table.maxRadius = maxRadius;
+  table.subPixelBuckets = buckets;
+  if (maxRadius < 0) return table;
+
+  const double minR2 = static_cast<double>(minRadius) * minRadius;
+  const double maxR2 = static_cast<double>(maxRadius) * maxRadius;
+  const int reach = maxRadius + 1;
+  for (int dy = -reach; dy <= reach; ++dy) {
+    const double ry = dy + 0.5 - fy;
+    int runStart = 0;
+    bool inRun = false;
+    for (int dx = -reach; dx <= reach + 1; ++dx) {
+      const double rx = dx + 0.5 - fx;
+      const double r2 = rx * rx + ry * ry;
+      const bool inside = dx <= reach && r2 > minR2 && r2 <= maxR2;
+      if (inside && !inRun) {
+        runStart = dx;
+        inRun = true;
+      } else if (!inside && inRun) {
+        table.spans.push_back(AnnulusSpan{dy, runStart, dx - runStart});
+        table.pixelCount += static_cast<size_t>(dx - runStart);
+        inRun = false;
+      }
+    }
+  }
+  return table;
+}
+
+// Tables are built once per (minRadius, maxRadius, center bucket) per thread and
+// reused across stars and frames; lookups take no lock
+inline const AnnulusTable& annulusTable(int minRadius, int maxRadius, int subPixelBuckets = 1,
+                                        int bucketX = 0, int bucketY = 0) {
+  thread_local std::unordered_map<uint64_t, std::unique_ptr<AnnulusTable>> cache;
+
+  const uint64_t key = (static_cast<uint64_t>(static_cast<uint16_t>(minRadius)) << 48) |
+                       (static_cast<uint64_t>(static_cast<uint16_t>(maxRadius)) << 32) |
+                       (static_cast<uint64_t>(static_cast<uint8_t>(subPixelBuckets)) << 16) |
+                       (static_cast<uint64_t>(static_cast<uint8_t>(bucketX)) << 8) |
+                       static_cast<uint64_t>(static_cast<uint8_t>(bucketY));
+
+  auto it = cache.find(key);
+  if (it == cache.end()) {
+    auto table = std::make_unique<AnnulusTable>(
+        subPixelBuckets <= 1
+            ? buildCircleMaskAnnulus(minRadius, maxRadius)
+            : buildSubPixelAnnulus(minRadius, maxRadius, (bucketX + 0.5) / subPixelBuckets,
+                                   (bucketY + 0.5) / subPixelBuckets, subPixelBuckets));
+    it = cache.emplace(key, std::move(table)).first;
+  }
+  return *it->second;
+}
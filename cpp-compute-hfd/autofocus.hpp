@@ -0,0 +1,200 @@
+// Incremental autofocus V-curve fitter
+// Fits the focus hyperbola HFD(x) = a * sqrt(1 + ((x - c) / b)^2) to
+// (focuser position, median HFD, star count) samples as they arrive. HFD² is a
+// quadratic in x, so the fit is a weighted linear least-squares problem over a
+// handful of running sums: each sample costs O(1), and the best focus, its
+// uncertainty and a stop signal are up to date after every exposure.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "hfd_engine.hpp"
+
+// Autofocus fit parameters
+constexpr int    kAutofocusMinSamples = 5;            // Samples before the fit may converge
+constexpr double kAutofocusConfidence = 2.0;          // Interval half-width that must fit the tolerance (sigma)
+constexpr double kAutofocusOutlierSigma = 5.0;        // Samples this far off the current fit are rejected (sigma)
+constexpr double kAutofocusFocusTolerance = 10.0;     // Required best-focus precision (focuser position units)
+
+struct AutofocusConfig {
+  double focusTolerance = kAutofocusFocusTolerance;
+  int minSamples = kAutofocusMinSamples;
+  double confidence = kAutofocusConfidence;
+  double outlierSigma = kAutofocusOutlierSigma;
+};
+
+// Positions are absolute mechanical focuser positions, the `position` of a
+// V1GotoFocuserPositionRequest with is_relative = false
+struct FocusEstimate {
+  bool valid = false;            // Enough samples and the curve opens upward
+  bool converged = false;        // Best focus known to focusTolerance: stop the sweep
+  double bestPosition = 0.0;     // Hyperbola vertex c
+  double positionStdDev = std::numeric_limits<double>::infinity();
+  float minimumHFD = 0.0f;       // Fitted HFD at best focus a (pixels)
+  double slope = 0.0;            // Asymptotic HFD change per position unit, a / b (pixels)
+  size_t samples = 0;            // Samples in the fit
+  size_t rejected = 0;           // Samples ignored: no stars, no HFD or outliers
+};
+
+class VCurveFitter {
+ public:
+  explicit VCurveFitter(AutofocusConfig config = AutofocusConfig()) : config_(config) {}
+
+  // Add one exposure; returns false if the sample was rejected. HFD noise
+  // shrinks with the number of stars behind the median, so samples are
+  // weighted by starCount / HFD⁴ (the inverse variance of HFD²)
+  bool addSample(double position, float hfd, size_t starCount) {
+    if (!(hfd > 0.0f) || starCount == 0 || !std::isfinite(position)) {
+      estimate_.rejected++;
+      return false;
+    }
+    if (samples_ == 0) {
+      origin_ = position;
+      minPosition_ = maxPosition_ = position;
+    }
+
+    const double x = position - origin_;
+    const double y = static_cast<double>(hfd) * hfd;
+    const double w = static_cast<double>(starCount) / (y * y);
+
+    if (isOutlier(x, y, w)) {
+      estimate_.rejected++;
+      return false;
+    }
+
+    double xk = w;
+    for (int k = 0; k <= 4; ++k) {
+      sumX_[k] += xk;
+      if (k <= 2) sumXY_[k] += xk * y;
+      xk *= x;
+    }
+    sumY2_ += w * y * y;
+    samples_++;
+    minPosition_ = std::min(minPosition_, position);
+    maxPosition_ = std::max(maxPosition_, position);
+    scale_ = std::max({scale_, std::abs(x), 1e-9});
+
+    solve();
+    return true;
+  }
+
+  // Add a measured frame: its median HFD over the stars that had one
+  bool addFrame(double position, const FrameHFDResult& frame) {
+    return addSample(position, frame.medianHFD, frame.measuredStars);
+  }
+
+  const FocusEstimate& estimate() const { return estimate_; }
+  bool shouldStop() const { return estimate_.converged; }
+
+  void reset() { *this = VCurveFitter(config_); }
+
+ private:
+  // Only once the vertex is bracketed by samples: before that the fit is one
+  // arm of the V and its extrapolation is not a reference. The test covers
+  // both the sample's noise and the fit's own prediction uncertainty at x.
+  bool isOutlier(double x, double y, double w) const {
+    if (!estimate_.valid || samples_ < static_cast<size_t>(config_.minSamples) ||
+        estimate_.bestPosition <= minPosition_ || estimate_.bestPosition >= maxPosition_) {
+      return false;
+    }
+    const double t = x / scale_;
+    const double basis[3] = {t * t, t, 1.0};
+    double leverage = 0.0;
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        leverage += basis[i] * inverse_[i][j] * basis[j];
+      }
+    }
+    const double predicted = (coefficients_[0] * t + coefficients_[1]) * t + coefficients_[2];
+    const double sigma = residualSigma_ * std::sqrt(1.0 / w + leverage);
+    return std::abs(y - predicted) > config_.outlierSigma * sigma;
+  }
+
+  // HFD² = A t² + B t + C over t = (x - origin) / scale; the scaling keeps the
+  // normal equations well conditioned for any position units
+  void solve() {
+    const size_t rejected = estimate_.rejected;
+    estimate_ = FocusEstimate();
+    estimate_.samples = samples_;
+    estimate_.rejected = rejected;
+    if (samples_ < 4) return;  // Need residual degrees of freedom for an uncertainty
+
+    double s[5], r[3];
+    double scaleK = 1.0;
+    for (int k = 0; k <= 4; ++k) {
+      s[k] = sumX_[k] / scaleK;
+      if (k <= 2) r[k] = sumXY_[k] / scaleK;
+      scaleK *= scale_;
+    }
+
+    // Symmetric normal matrix over (A, B, C) and its inverse by cofactors
+    const double m00 = s[4], m01 = s[3], m02 = s[2], m11 = s[2], m12 = s[1], m22 = s[0];
+    const double c00 = m11 * m22 - m12 * m12;
+    const double c01 = m02 * m12 - m01 * m22;
+    const double c02 = m01 * m12 - m02 * m11;
+    const double c11 = m00 * m22 - m02 * m02;
+    const double c12 = m01 * m02 - m00 * m12;
+    const double c22 = m00 * m11 - m01 * m01;
+    const double determinant = m00 * c00 + m01 * c01 + m02 * c02;
+    if (!(std::abs(determinant) > 1e-300)) return;
+    const double inverse[3][3] = {{c00 / determinant, c01 / determinant, c02 / determinant},
+                                  {c01 / determinant, c11 / determinant, c12 / determinant},
+                                  {c02 / determinant, c12 / determinant, c22 / determinant}};
+    std::copy(&inverse[0][0], &inverse[0][0] + 9, &inverse_[0][0]);
+
+    const double rhs[3] = {r[2], r[1], r[0]};
+    for (int i = 0; i < 3; ++i) {
+      coefficients_[i] = inverse[i][0] * rhs[0] + inverse[i][1] * rhs[1] + inverse[i][2] * rhs[2];
+    }
+    const double a = coefficients_[0], b = coefficients_[1], c = coefficients_[2];
+    const double vertexHFD2 = c - b * b / (4.0 * a);
+    if (!(a > 0.0) || !(vertexHFD2 > 0.0)) return;
+
+    // Weighted residual variance from the sums: Σ w y² - β · Xᵀ W y
+    const double residual = std::max(0.0, sumY2_ - (a * rhs[0] + b * rhs[1] + c * rhs[2]));
+    residualSigma_ = std::sqrt(residual / static_cast<double>(samples_ - 3));
+
+    // Vertex t = -B / 2A, uncertainty by first-order propagation of Cov(A, B)
+    const double vertex = -b / (2.0 * a);
+    const double gA = b / (2.0 * a * a);
+    const double gB = -1.0 / (2.0 * a);
+    const double variance = residualSigma_ * residualSigma_ *
+                            (gA * gA * inverse[0][0] + 2.0 * gA * gB * inverse[0][1] + gB * gB * inverse[1][1]);
+
+    estimate_.valid = true;
+    estimate_.bestPosition = origin_ + vertex * scale_;
+    estimate_.positionStdDev = std::sqrt(std::max(0.0, variance)) * scale_;
+    estimate_.minimumHFD = static_cast<float>(std::sqrt(vertexHFD2));
+    estimate_.slope = std::sqrt(a) / scale_;
+
+    // Stop once the focus is known well enough and lies inside the sampled
+    // range, so it is interpolated rather than extrapolated
+    const double halfWidth = config_.confidence * estimate_.positionStdDev;
+    estimate_.converged = samples_ >= static_cast<size_t>(config_.minSamples) &&
+                          halfWidth <= config_.focusTolerance &&
+                          estimate_.bestPosition - halfWidth >= minPosition_ &&
+                          estimate_.bestPosition + halfWidth <= maxPosition_;
+  }
+
+  AutofocusConfig config_;
+  FocusEstimate estimate_;
+
+  // Weighted sums over x = position - origin: Σ w xᵏ, Σ w xᵏ y (y = HFD²), Σ w y²
+  double sumX_[5] = {};
+  double sumXY_[3] = {};
+  double sumY2_ = 0.0;
+  size_t samples_ = 0;
+  double origin_ = 0.0;
+  double scale_ = 1e-9;
+  double minPosition_ = 0.0;
+  double maxPosition_ = 0.0;
+
+  double coefficients_[3] = {};  // A, B, C of the last fit
+  double inverse_[3][3] = {};    // Its inverse normal matrix (covariance / residual variance)
+  double residualSigma_ = 0.0;
+};
@@ -0,0 +1,230 @@
+// Linear-time robust background estimator for 16-bit pixel data
+// Same median + sigma clipping semantics as computeRobustBackground, without
+// sorting and without copying the data on every clipping iteration
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "annulus_table.hpp"
+#include "hfd_utils.hpp"
+
+// Histogram path selection
+constexpr int    kBackgroundHistogramMinBins = 4096;  // Value range always binned directly (16 KB of counts)
+constexpr int    kBackgroundHistogramBinsPerValue = 4; // Larger ranges binned only if range <= this * count
+
+enum class BackgroundEstimator {
+  SortAndClip,  // computeRobustBackground: sorted median, copying sigma clip
+  Linear        // computeRobustBackgroundLinear: histogram / nth_element, clipping by bounds
+};
+
+namespace background_detail {
+
+// Sums of d = v - pivot over the surviving pixels. With an integer pivot at the
+// median the sums are exact in int64, and pivot * count + sumD is the exact
+// pixel sum, so the mean matches calculateMeanAndStdDev bit for bit.
+struct ClipSums {
+  int64_t count = 0;
+  int64_t sumD = 0;
+  int64_t sumD2 = 0;
+};
+
+inline std::pair<double, double> meanAndStdDev(const ClipSums& s, int64_t pivot) {
+  if (s.count == 0) {
+    return {0.0, 0.0};
+  }
+  const double n = static_cast<double>(s.count);
+  const double mean = static_cast<double>(pivot * s.count + s.sumD) / n;
+  const double sumD = static_cast<double>(s.sumD);
+  const double variance = std::max(0.0, (static_cast<double>(s.sumD2) - sumD * sumD / n) / n);
+  return {mean, std::sqrt(variance)};
+}
+
+// Integer range [first, last] of values v with lower <= v <= upper
+inline void clipBounds(double lower, double upper, int64_t& first, int64_t& last) {
+  first = std::max<int64_t>(first, static_cast<int64_t>(std::ceil(lower)));
+  last = std::min<int64_t>(last, static_cast<int64_t>(std::floor(upper)));
+}
+
+// Range small enough to bin one counter per value
+inline bool fitsHistogram(int64_t first, int64_t last, size_t count) {
+  const int64_t bins = last - first + 1;
+  return bins <= kBackgroundHistogramMinBins || bins <= static_cast<int64_t>(count) * kBackgroundHistogramBinsPerValue;
+}
+
+// Counts per value over [base, base + histogram.size())
+inline void buildHistogram(const uint16_t* values, size_t count, int64_t first, int64_t last,
+                           std::vector<uint32_t>& histogram) {
+  histogram.assign(static_cast<size_t>(last - first + 1), 0u);
+  for (size_t i = 0; i < count; ++i) {
+    const int64_t v = values[i];
+    if (v >= first && v <= last) {
+      histogram[static_cast<size_t>(v - first)]++;
+    }
+  }
+}
+
+inline ClipSums histogramSums(const std::vector<uint32_t>& histogram, int64_t base,
+                              int64_t first, int64_t last, int64_t pivot) {
+  ClipSums s;
+  for (int64_t v = first; v <= last; ++v) {
+    const int64_t c = histogram[static_cast<size_t>(v - base)];
+    const int64_t d = v - pivot;
+    s.count += c;
+    s.sumD += c * d;
+    s.sumD2 += c * d * d;
+  }
+  return s;
+}
+
+// computeSigmaClipping + computeRobustBackground's final statistics. Every
+// pass filters the survivors of the previous one against bounds centered on
+// the same level, so the survivors are always the values inside the
+// intersection of all bounds so far: clipping only moves [first, last].
+template <typename SumsOver>
+BackgroundStats sigmaClipBounds(double level, int64_t pivot, int64_t first, int64_t last, SumsOver&& sumsOver) {
+  const ClipSums all = sumsOver(first, last);
+  ClipSums clipped = all;
+  for (int iteration = 0; iteration < kClippingMaxIterations; ++iteration) {
+    if (clipped.count == 0) break;
+    const double stddev = meanAndStdDev(clipped, pivot).second;
+    if (stddev <= 0.0) break;
+
+    clipBounds(level - kClippingSigma * stddev, level + kClippingSigma * stddev, first, last);
+    const ClipSums next = first <= last ? sumsOver(first, last) : ClipSums();
+    if (next.count == clipped.count) break;
+    clipped = next;
+  }
+
+  if (clipped.count == 0) {
+    // Fallback to initial statistics if all pixels were clipped
+    return BackgroundStats{level, meanAndStdDev(all, pivot).second};
+  }
+  const auto stats = meanAndStdDev(clipped, pivot);
+  return BackgroundStats{stats.first, stats.second};
+}
+
+// Narrow value range: counts per value; median and every clipping pass walk the bins
+inline BackgroundStats robustBackgroundHistogram(const uint16_t* values, size_t count,
+                                                 int minValue, int maxValue) {
+  thread_local std::vector<uint32_t> histogram;
+  buildHistogram(values, count, minValue, maxValue, histogram);
+
+  // Median: values at ranks (n - 1) / 2 and n / 2
+  const size_t lowRank = (count - 1) / 2;
+  const size_t highRank = count / 2;
+  int lowValue = -1, highValue = -1;
+  size_t seen = 0;
+  for (size_t bin = 0; bin < histogram.size() && highValue < 0; ++bin) {
+    seen += histogram[bin];
+    if (lowValue < 0 && seen > lowRank) lowValue = static_cast<int>(bin) + minValue;
+    if (seen > highRank) highValue = static_cast<int>(bin) + minValue;
+  }
+  const double level = (count % 2 == 0) ? (lowValue + highValue) / 2.0 : static_cast<double>(highValue);
+  const int64_t pivot = lowValue;
+
+  return sigmaClipBounds(level, pivot, minValue, maxValue, [&](int64_t first, int64_t last) {
+    return histogramSums(histogram, minValue, first, last, pivot);
+  });
+}
+
+// Wide value range (bright star or hot pixels in the sample): nth_element for
+// the median, masked sums over the values while the bounds are wide, then a
+// histogram of the survivors once the bounds have narrowed enough to bin
+inline BackgroundStats robustBackgroundSelect(const uint16_t* values, size_t count) {
+  thread_local std::vector<uint16_t> scratch;
+  thread_local std::vector<uint32_t> histogram;
+  scratch.assign(values, values + count);
+
+  const size_t half = count / 2;
+  std::nth_element(scratch.begin(), scratch.begin() + half, scratch.end());
+  const int highValue = scratch[half];
+  const int lowValue = (count % 2 == 0) ? *std::max_element(scratch.begin(), scratch.begin() + half) : highValue;
+  const double level = (count % 2 == 0) ? (lowValue + highValue) / 2.0 : static_cast<double>(highValue);
+  const int64_t pivot = lowValue;
+
+  bool binned = false;
+  int64_t histogramBase = 0;
+  return sigmaClipBounds(level, pivot, 0, 65535, [&](int64_t first, int64_t last) {
+    if (!binned && fitsHistogram(first, last, count)) {
+      buildHistogram(values, count, first, last, histogram);
+      histogramBase = first;
+      binned = true;
+    }
+    if (binned) {
+      return histogramSums(histogram, histogramBase, first, last, pivot);
+    }
+
+    ClipSums s;
+    for (size_t i = 0; i < count; ++i) {
+      const int64_t v = values[i];
+      const int64_t inside = (v >= first) & (v <= last);
+      const int64_t d = (v - pivot) * inside;
+      s.count += inside;
+      s.sumD += d;
+      s.sumD2 += d * d;
+    }
+    return s;
+  });
+}
+
+}  // namespace background_detail
+
+// Robust background of 16-bit values in O(n): computeRobustBackground's result
+// (median, sigma clip around it, mean/stddev of the survivors) with the mean
+// exact and the stddev within rounding (relative difference < 1e-12)
+inline BackgroundStats computeRobustBackgroundLinear(const uint16_t* values, size_t count) {
+  if (count == 0) {
+    return BackgroundStats{0.0, 0.0};
+  }
+
+  const auto range = std::minmax_element(values, values + count);
+  const int minValue = *range.first;
+  const int maxValue = *range.second;
+  if (background_detail::fitsHistogram(minValue, maxValue, count)) {
+    return background_detail::robustBackgroundHistogram(values, count, minValue, maxValue);
+  }
+  return background_detail::robustBackgroundSelect(values, count);
+}
+
+inline BackgroundStats computeRobustBackgroundLinear(const std::vector<uint16_t>& values) {
+  return computeRobustBackgroundLinear(values.data(), values.size());
+}
+
+// Copy the pixels of a precomputed annulus around `anchor`, clipped to the
+// stamp, as raw 16-bit values (same pixels and order as gatherAnnulusTable)
+inline void gatherAnnulusValues(const cv::Mat& starRegion,
+                                const AnnulusTable& table,
+                                const cv::Point& anchor,
+                                std::vector<uint16_t>& values) {
+  values.resize(table.pixelCount);
+  size_t count = 0;
+  for (const AnnulusSpan& span : table.spans) {
+    const int y = anchor.y + span.dy;
+    if (y < 0 || y >= starRegion.rows) continue;
+    const int x0 = std::max(0, anchor.x + span.dx);
+    const int x1 = std::min(starRegion.cols, anchor.x + span.dx + span.length);
+    if (x1 <= x0) continue;
+    std::memcpy(values.data() + count, starRegion.ptr<uint16_t>(y) + x0, sizeof(uint16_t) * (x1 - x0));
+    count += static_cast<size_t>(x1 - x0);
+  }
+  values.resize(count);
+}
+
+// computeBackgroundStats with the linear-time estimator over the same
+// cv::circle annulus
+inline BackgroundStats computeBackgroundStatsLinear(const cv::Mat& starRegion,
+                                                    const cv::Point2f& center,
+                                                    int minRadius = kMinBackgroundRadius,
+                                                    int maxRadius = kMaxBackgroundRadius) {
+  thread_local std::vector<uint16_t> backgroundValues;
+  const cv::Point anchor(cvRound(center.x), cvRound(center.y));  // As cv::circle rounds its center
+  gatherAnnulusValues(starRegion, annulusTable(minRadius, maxRadius), anchor, backgroundValues);
+  return computeRobustBackgroundLinear(backgroundValues);
+}
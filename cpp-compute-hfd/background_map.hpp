@@ -0,0 +1,356 @@
+// Tiled full-frame background and noise map
+// Robust background per tile (median + sigma clipping, as computeBackgroundStats),
+// median-filtered across tiles and bicubically interpolated one row at a time, so
+// a full frame never needs a full-size float copy of the background.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "background_estimator.hpp"
+#include "thread_pool.hpp"
+
+// Background mesh parameters
+constexpr int    kBackgroundTileSize = 64;            // Nominal mesh tile edge (pixels)
+constexpr int    kBackgroundMeshFilterSize = 3;       // Median filter over mesh nodes (tiles), 1 = off
+constexpr int    kBackgroundTileSampleStride = 2;     // Pixel stride within a tile (1 = every pixel)
+
+struct BackgroundMapConfig {
+  int tileSize = kBackgroundTileSize;
+  int meshFilterSize = kBackgroundMeshFilterSize;
+  int sampleStride = kBackgroundTileSampleStride;
+};
+
+// Background level and noise (RMS) over a frame, stored as one node per tile
+// Nodes sit at tile centers; tiles split the frame evenly, so the nodes are
+// uniformly spaced and the interpolation is a plain Catmull-Rom bicubic
+class BackgroundMap {
+ public:
+  BackgroundMap() = default;
+
+  BackgroundMap(cv::Size frameSize, int tilesX, int tilesY, std::vector<float> level, std::vector<float> rms)
+      : frameSize_(frameSize), tilesX_(tilesX), tilesY_(tilesY), level_(std::move(level)), rms_(std::move(rms)) {
+    // Horizontal interpolation is the same for every row: precompute the
+    // weights per column (one array per node, so the row loop vectorizes) and
+    // the column ranges that share the same 4 nodes
+    for (auto& weights : columnWeights_) {
+      weights.resize(static_cast<size_t>(frameSize.width));
+    }
+    for (int x = 0; x < frameSize.width; ++x) {
+      int base;
+      float w[4];
+      nodeWeights(x, frameSize.width, tilesX_, base, w);
+      for (int k = 0; k < 4; ++k) {
+        columnWeights_[k][x] = w[k];
+      }
+      if (segments_.empty() || segments_.back().base != base) {
+        segments_.push_back(ColumnSegment{base, x, x + 1});
+      } else {
+        segments_.back().end = x + 1;
+      }
+    }
+  }
+
+  bool empty() const { return level_.empty(); }
+  cv::Size frameSize() const { return frameSize_; }
+  int tilesX() const { return tilesX_; }
+  int tilesY() const { return tilesY_; }
+
+  // Per-tile nodes, row-major tilesY x tilesX
+  const std::vector<float>& levelMesh() const { return level_; }
+  const std::vector<float>& rmsMesh() const { return rms_; }
+
+  // Interpolated background level and RMS of frame row y (frameSize().width values each)
+  void interpolateRow(int y, float* levelRow, float* rmsRow) const {
+    thread_local std::vector<float> levelNodes, rmsNodes;
+    verticalPass(y, level_, levelNodes);
+    verticalPass(y, rms_, rmsNodes);
+    horizontalPass(levelNodes, levelRow);
+    horizontalPass(rmsNodes, rmsRow);
+  }
+
+  // Call fn(x, level, threshold) for every pixel of row y in [xBegin, xEnd)
+  // brighter than threshold = level + sigma * max(rms, minRms). Each tile-width run of
+  // columns is first screened against a lower bound of its threshold, so only
+  // pixels that may pass (stars, hot pixels) pay for the bicubic interpolation.
+  template <typename Fn>
+  void forEachAboveThreshold(const uint16_t* row, int y, int xBegin, int xEnd,
+                             float sigma, float minRms, Fn&& fn) const {
+    thread_local std::vector<float> levelNodes, rmsNodes;
+    verticalPass(y, level_, levelNodes);
+    verticalPass(y, rms_, rmsNodes);
+
+    for (const ColumnSegment& segment : segments_) {
+      const int begin = std::max(segment.begin, xBegin);
+      const int end = std::min(segment.end, xEnd);
+      if (begin >= end) continue;
+
+      const float* level = &levelNodes[segment.base];
+      const float* rms = &rmsNodes[segment.base];
+      const float bound = lowerBound(level) + sigma * std::max(lowerBound(rms), minRms);
+      const int floor = static_cast<int>(std::min(std::max(bound, -1.0f), 65535.0f));
+      for (int x = begin; x < end; ++x) {
+        if (row[x] <= floor) continue;
+        const float localLevel = columnValue(level, x);
+        const float threshold = localLevel + sigma * std::max(columnValue(rms, x), minRms);
+        if (row[x] > threshold) {
+          fn(x, localLevel, threshold);
+        }
+      }
+    }
+  }
+
+  // Single-pixel lookup; prefer interpolateRow for whole rows
+  float levelAt(int x, int y) const { return pointValue(level_, x, y); }
+  float rmsAt(int x, int y) const { return pointValue(rms_, x, y); }
+
+ private:
+  // Catmull-Rom weights for the 4 nodes around pixel `pos` on an axis of
+  // `length` pixels split into `nodes` tiles; `base` is node i - 1 as an index
+  // into the padded node array (one extrapolated node on each side)
+  static void nodeWeights(int pos, int length, int nodes, int& base, float* w) {
+    const double spacing = static_cast<double>(length) / nodes;
+    const double u = (pos + 0.5) / spacing - 0.5;  // In node units, node i at u = i
+    const int i = std::min(std::max(static_cast<int>(std::floor(u)), 0), std::max(0, nodes - 2));
+    const float t = nodes > 1 ? static_cast<float>(u - i) : 0.0f;  // In [-0.5, 1.5] at the frame edges
+    const float t2 = t * t, t3 = t2 * t;
+    w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+    w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+    w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+    w[3] = 0.5f * (t3 - t2);
+    base = i;
+  }
+
+  // Padded node array for the nodes (i = 0 .. count - 1) of one axis: the
+  // outer nodes are extrapolated linearly, so a gradient continues to the
+  // frame edge instead of flattening half a tile short of it
+  static void padNodes(std::vector<float>& padded, int count) {
+    if (count == 1) {
+      padded[0] = padded[2] = padded[3] = padded[1];
+      return;
+    }
+    padded[0] = 2.0f * padded[1] - padded[2];
+    padded[count + 1] = 2.0f * padded[count] - padded[count - 1];
+  }
+
+  // Row y of the mesh interpolated vertically: one value per tile column,
+  // padded for the horizontal pass
+  void verticalPass(int y, const std::vector<float>& mesh, std::vector<float>& nodes) const {
+    int base;
+    float w[4];
+    nodeWeights(y, frameSize_.height, tilesY_, base, w);
+
+    // Fold the extrapolated rows (-1 and tilesY) into weights on real rows
+    float rowWeight[4] = {0.0f, 0.0f, 0.0f, 0.0f};  // Rows base - 1 .. base + 2
+    const int firstRow = base - 1;
+    for (int k = 0; k < 4; ++k) {
+      const int ty = firstRow + k;
+      if (tilesY_ == 1) {
+        rowWeight[1] += w[k];
+      } else if (ty < 0) {
+        rowWeight[k + 1] += 2.0f * w[k];
+        rowWeight[k + 2] -= w[k];
+      } else if (ty >= tilesY_) {
+        rowWeight[k - 1] += 2.0f * w[k];
+        rowWeight[k - 2] -= w[k];
+      } else {
+        rowWeight[k] += w[k];
+      }
+    }
+
+    nodes.assign(static_cast<size_t>(tilesX_) + 3, 0.0f);
+    for (int k = 0; k < 4; ++k) {
+      const int ty = firstRow + k;
+      if (rowWeight[k] == 0.0f || ty < 0 || ty >= tilesY_) continue;
+      const float* meshRow = &mesh[static_cast<size_t>(ty) * tilesX_];
+      for (int tx = 0; tx < tilesX_; ++tx) {
+        nodes[tx + 1] += rowWeight[k] * meshRow[tx];
+      }
+    }
+    padNodes(nodes, tilesX_);
+  }
+
+  void horizontalPass(const std::vector<float>& nodes, float* row) const {
+    const float* w0 = columnWeights_[0].data();
+    const float* w1 = columnWeights_[1].data();
+    const float* w2 = columnWeights_[2].data();
+    const float* w3 = columnWeights_[3].data();
+    for (const ColumnSegment& segment : segments_) {
+      const float n0 = nodes[segment.base], n1 = nodes[segment.base + 1];
+      const float n2 = nodes[segment.base + 2], n3 = nodes[segment.base + 3];
+      for (int x = segment.begin; x < segment.end; ++x) {
+        row[x] = w0[x] * n0 + w1[x] * n1 + w2[x] * n2 + w3[x] * n3;
+      }
+    }
+  }
+
+  float pointValue(const std::vector<float>& mesh, int x, int y) const {
+    thread_local std::vector<float> nodes;
+    verticalPass(y, mesh, nodes);
+    int base;
+    float w[4];
+    nodeWeights(x, frameSize_.width, tilesX_, base, w);
+    return w[0] * nodes[base] + w[1] * nodes[base + 1] + w[2] * nodes[base + 2] + w[3] * nodes[base + 3];
+  }
+
+  float columnValue(const float* n, int x) const {
+    return columnWeights_[0][x] * n[0] + columnWeights_[1][x] * n[1] +
+           columnWeights_[2][x] * n[2] + columnWeights_[3][x] * n[3];
+  }
+
+  // Smallest value the spline can take between 4 nodes: the weights sum to 1
+  // and their negative part never exceeds kCatmullRomUndershoot for t in
+  // [-0.5, 1.5] (the frame-edge extrapolation range)
+  static float lowerBound(const float* n) {
+    constexpr float kCatmullRomUndershoot = 0.1875f;
+    const float lo = std::min(std::min(n[0], n[1]), std::min(n[2], n[3]));
+    const float hi = std::max(std::max(n[0], n[1]), std::max(n[2], n[3]));
+    return lo - kCatmullRomUndershoot * (hi - lo);
+  }
+
+  // Columns [begin, end) interpolated from padded nodes base .. base + 3
+  struct ColumnSegment {
+    int base;
+    int begin;
+    int end;
+  };
+
+  cv::Size frameSize_;
+  int tilesX_ = 0;
+  int tilesY_ = 0;
+  std::vector<float> level_;
+  std::vector<float> rms_;
+  std::vector<float> columnWeights_[4];
+  std::vector<ColumnSegment> segments_;
+};
+
+namespace background_map_detail {
+
+// Mesh node (x, y), extended beyond the edges by reflecting each axis through
+// its edge node, f(-k) = 2 f(0) - f(k): exact for a linear gradient
+inline float extendedNode(const std::vector<float>& mesh, int tilesX, int tilesY, int x, int y) {
+  if (x < 0 || x >= tilesX) {
+    const int edge = x < 0 ? 0 : tilesX - 1;
+    const int mirror = std::min(std::max(2 * edge - x, 0), tilesX - 1);
+    return 2.0f * extendedNode(mesh, tilesX, tilesY, edge, y) - extendedNode(mesh, tilesX, tilesY, mirror, y);
+  }
+  if (y < 0 || y >= tilesY) {
+    const int edge = y < 0 ? 0 : tilesY - 1;
+    const int mirror = std::min(std::max(2 * edge - y, 0), tilesY - 1);
+    return 2.0f * extendedNode(mesh, tilesX, tilesY, x, edge) - extendedNode(mesh, tilesX, tilesY, x, mirror);
+  }
+  return mesh[static_cast<size_t>(y) * tilesX + x];
+}
+
+// Median of the (size x size) neighbourhood of every node
+// Rejects tiles whose statistics are pulled up by a bright star or nebula.
+// Neighbours beyond the mesh edge come from extendedNode, so a gradient passes
+// unchanged into the corners, where clamping would bias the median.
+inline std::vector<float> medianFilterMesh(const std::vector<float>& mesh, int tilesX, int tilesY, int size) {
+  if (size <= 1) {
+    return mesh;
+  }
+  const int half = size / 2;
+  std::vector<float> filtered(mesh.size());
+  std::vector<float> window;
+  window.reserve(static_cast<size_t>(size) * size);
+  for (int ty = 0; ty < tilesY; ++ty) {
+    for (int tx = 0; tx < tilesX; ++tx) {
+      window.clear();
+      for (int dy = -half; dy <= half; ++dy) {
+        for (int dx = -half; dx <= half; ++dx) {
+          window.push_back(extendedNode(mesh, tilesX, tilesY, tx + dx, ty + dy));
+        }
+      }
+      std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+      filtered[static_cast<size_t>(ty) * tilesX + tx] = window[window.size() / 2];
+    }
+  }
+  return filtered;
+}
+
+}  // namespace background_map_detail
+
+// Estimate the background map of a 16-bit frame, one tile per pool task
+// Each tile's samples (every sampleStride-th pixel and row, about 1000 per
+// default tile) are copied into per-thread scratch and reduced with
+// computeRobustBackgroundLinear; the frame itself is only read
+inline BackgroundMap estimateBackgroundMap(const cv::Mat& frame, WorkStealingPool& pool,
+                                           const BackgroundMapConfig& config = BackgroundMapConfig()) {
+  if (frame.empty()) {
+    return BackgroundMap();
+  }
+  const int tileSize = std::max(1, config.tileSize);
+  const int stride = std::max(1, config.sampleStride);
+  const int tilesX = std::max(1, (frame.cols + tileSize / 2) / tileSize);
+  const int tilesY = std::max(1, (frame.rows + tileSize / 2) / tileSize);
+  const size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+
+  std::vector<float> level(tileCount), rms(tileCount);
+  pool.parallelFor(tileCount, 1, [&](size_t begin, size_t end, unsigned) {
+    thread_local std::vector<uint16_t> values;
+    for (size_t tile = begin; tile < end; ++tile) {
+      const int tx = static_cast<int>(tile % tilesX);
+      const int ty = static_cast<int>(tile / tilesX);
+      const int x0 = static_cast<int>(static_cast<int64_t>(frame.cols) * tx / tilesX);
+      const int x1 = static_cast<int>(static_cast<int64_t>(frame.cols) * (tx + 1) / tilesX);
+      const int y0 = static_cast<int>(static_cast<int64_t>(frame.rows) * ty / tilesY);
+      const int y1 = static_cast<int>(static_cast<int64_t>(frame.rows) * (ty + 1) / tilesY);
+
+      values.clear();
+      for (int y = y0 + stride / 2; y < y1; y += stride) {
+        const uint16_t* row = frame.ptr<uint16_t>(y);
+        if (stride == 1) {
+          values.insert(values.end(), row + x0, row + x1);
+          continue;
+        }
+        for (int x = x0 + stride / 2; x < x1; x += stride) {
+          values.push_back(row[x]);
+        }
+      }
+
+      const BackgroundStats stats = computeRobustBackgroundLinear(values);
+      level[tile] = static_cast<float>(stats.level);
+      rms[tile] = static_cast<float>(stats.stddev);
+    }
+  });
+
+  return BackgroundMap(frame.size(),
+                       tilesX, tilesY,
+                       background_map_detail::medianFilterMesh(level, tilesX, tilesY, config.meshFilterSize),
+                       background_map_detail::medianFilterMesh(rms, tilesX, tilesY, config.meshFilterSize));
+}
+
+// findBrightestRegion against a background map: the window is centered on the
+// most significant pixel, (value - level) / rms, instead of the brightest raw
+// value, so a gradient or a bright corner does not win over a star
+inline cv::Rect findBrightestRegion(const cv::Mat& image, const BackgroundMap& background, int windowSize = 50) {
+  std::vector<float> levelRow(static_cast<size_t>(image.cols)), rmsRow(static_cast<size_t>(image.cols));
+  float bestSignificance = -1e30f;
+  cv::Point best(0, 0);
+  for (int y = 0; y < image.rows; ++y) {
+    background.interpolateRow(y, levelRow.data(), rmsRow.data());
+    const uint16_t* row = image.ptr<uint16_t>(y);
+    for (int x = 0; x < image.cols; ++x) {
+      const float significance = (row[x] - levelRow[x]) / std::max(rmsRow[x], 1.0f);
+      if (significance > bestSignificance) {
+        bestSignificance = significance;
+        best = cv::Point(x, y);
+      }
+    }
+  }
+
+  // Same window clipping as the global findBrightestRegion
+  int halfWindow = windowSize / 2;
+  int x = std::max(0, best.x - halfWindow);
+  int y = std::max(0, best.y - halfWindow);
+  int width = std::min(windowSize, image.cols - x);
+  int height = std::min(windowSize, image.rows - y);
+
+  return cv::Rect(x, y, width, height);
+}
@@ -0,0 +1,11 @@
+// Global heap allocation counter for the benchmarks
+// allocation_counter.cpp replaces operator new/delete for the whole bench
+// binary; benchmarks read the counter before and after the timed region.
+// Requires: C++17 standard library
+
+#pragma once
+
+#include <cstddef>
+
+// operator new calls so far, across all threads
+size_t allocationCount();
@@ -0,0 +1,92 @@
+// Per-star background cost: mask rasterization vs cached annulus tables
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+#include "hfd_simd.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr int kStarsPerIteration = 256;
+
+// Star centers scattered over sub-pixel positions, as the engine sees them
+std::vector<cv::Point2f> starCenters() {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+  std::vector<cv::Point2f> centers(kStarsPerIteration);
+  for (auto& c : centers) {
+    c = cv::Point2f(25.0f + offset(rng), 25.0f + offset(rng));
+  }
+  return centers;
+}
+
+template <typename BackgroundFn>
+void runPerStar(benchmark::State& state, BackgroundFn&& background) {
+  const cv::Mat img = makeGaussianStamp(2.0);
+  const cv::Mat stamp = img(findBrightestRegion(img, 50));
+  const std::vector<cv::Point2f> centers = starCenters();
+
+  for (auto _ : state) {
+    for (const auto& center : centers) {
+      benchmark::DoNotOptimize(background(stamp, center));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kStarsPerIteration);  // items/s = stars/s
+}
+
+// Before: cv::Mat mask, two cv::circle calls, cv::findNonZero, then copy
+void BM_BackgroundPerStarMask(benchmark::State& state) {
+  runPerStar(state, [](const cv::Mat& stamp, const cv::Point2f& center) {
+    return computeBackgroundStats(stamp, center);
+  });
+}
+
+// After: cached span table, straight loads into a reused buffer
+void BM_BackgroundPerStarTable(benchmark::State& state) {
+  runPerStar(state, [](const cv::Mat& stamp, const cv::Point2f& center) {
+    return computeBackgroundStatsSIMD(stamp, center);
+  });
+}
+
+// Sub-pixel annulus tables (4x4 center buckets)
+void BM_BackgroundPerStarSubPixelTable(benchmark::State& state) {
+  runPerStar(state, [](const cv::Mat& stamp, const cv::Point2f& center) {
+    return computeBackgroundStatsSubPixel(stamp, center);
+  });
+}
+
+// Gather only, to separate geometry cost from the median/clipping statistics
+void BM_AnnulusGatherMask(benchmark::State& state) {
+  runPerStar(state, [](const cv::Mat& stamp, const cv::Point2f& center) {
+    cv::Mat mask = cv::Mat::zeros(stamp.size(), CV_8U);
+    cv::circle(mask, center, kMaxBackgroundRadius, cv::Scalar(255), -1);
+    cv::circle(mask, center, kMinBackgroundRadius, cv::Scalar(0), -1);
+    std::vector<cv::Point> locations;
+    cv::findNonZero(mask, locations);
+    std::vector<double> pixels;
+    pixels.reserve(locations.size());
+    for (const auto& pt : locations) {
+      pixels.push_back(static_cast<double>(stamp.at<uint16_t>(pt)));
+    }
+    return pixels.size();
+  });
+}
+
+void BM_AnnulusGatherTable(benchmark::State& state) {
+  std::vector<double> pixels;
+  runPerStar(state, [&pixels](const cv::Mat& stamp, const cv::Point2f& center) {
+    gatherAnnulusPixels(stamp, center, kMinBackgroundRadius, kMaxBackgroundRadius, pixels);
+    return pixels.size();
+  });
+}
+
+}  // namespace
+
+BENCHMARK(BM_BackgroundPerStarMask);
+BENCHMARK(BM_BackgroundPerStarTable);
+BENCHMARK(BM_BackgroundPerStarSubPixelTable);
+BENCHMARK(BM_AnnulusGatherMask);
+BENCHMARK(BM_AnnulusGatherTable);
@@ -0,0 +1,129 @@
+// Incremental V-curve fitter: per-sample cost and exposures saved by early termination
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "autofocus.hpp"
+
+namespace {
+
+// Simulated focus sweep: a hyperbolic V-curve around a focus position that is
+// only known to ±kFocusUncertainty, sampled from one end to the other
+constexpr double kNominalFocus = 10000.0;     // Focuser position units
+constexpr double kFocusUncertainty = 200.0;
+constexpr double kSweepHalfWidth = 1600.0;
+constexpr double kSweepStep = 200.0;          // 17 exposures for a full sweep
+constexpr double kMinimumHFD = 2.5;           // Pixels
+constexpr double kCurveWidth = 350.0;         // Hyperbola b (position units)
+constexpr double kStarHFDSpread = 0.1;        // Relative HFD scatter between stars
+constexpr size_t kStarsInFocus = 300;         // Stars measured at best focus
+constexpr double kCloudProbability = 0.05;    // Exposures with a spoiled median HFD
+constexpr int    kVerifyTrials = 300;
+
+struct SweepResult {
+  int exposures = 0;
+  double error = 0.0;            // Estimated minus true best focus
+  FocusEstimate estimate;
+};
+
+SweepResult runSweep(uint32_t seed, const AutofocusConfig& config, bool stopEarly) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::normal_distribution<double> gauss(0.0, 1.0);
+  const double focus = kNominalFocus + kFocusUncertainty * (2.0 * uniform(rng) - 1.0);
+
+  VCurveFitter fitter(config);
+  SweepResult result;
+  for (double position = kNominalFocus - kSweepHalfWidth; position <= kNominalFocus + kSweepHalfWidth;
+       position += kSweepStep) {
+    const double u = (position - focus) / kCurveWidth;
+    const double hfd = kMinimumHFD * std::sqrt(1.0 + u * u);
+    // Defocused stars spread out and fewer of them clear the detection threshold
+    size_t stars = std::max<size_t>(5, static_cast<size_t>(kStarsInFocus * (kMinimumHFD / hfd) * (kMinimumHFD / hfd)));
+    double median = hfd * (1.0 + 1.25 * kStarHFDSpread / std::sqrt(static_cast<double>(stars)) * gauss(rng));
+    if (uniform(rng) < kCloudProbability) {
+      median *= 1.5;
+      stars /= 4;
+    }
+
+    fitter.addSample(position, static_cast<float>(median), stars);
+    result.exposures++;
+    if (stopEarly && fitter.shouldStop()) break;
+  }
+  result.estimate = fitter.estimate();
+  result.error = result.estimate.bestPosition - focus;
+  return result;
+}
+
+// Converged estimates must be within 3 tolerances of the truth, and the
+// reported uncertainty must match the actual scatter of full sweeps
+std::string verifySweeps() {
+  AutofocusConfig config;
+  double squaredZ = 0.0;
+  for (uint32_t seed = 0; seed < kVerifyTrials; ++seed) {
+    const SweepResult early = runSweep(seed, config, true);
+    if (early.estimate.converged && std::abs(early.error) > 3.0 * config.focusTolerance) {
+      return "converged " + std::to_string(early.error) + " from focus at seed " + std::to_string(seed);
+    }
+    const SweepResult full = runSweep(seed, config, false);
+    if (!full.estimate.valid) {
+      return "no fit after a full sweep at seed " + std::to_string(seed);
+    }
+    squaredZ += full.error * full.error / (full.estimate.positionStdDev * full.estimate.positionStdDev);
+  }
+  const double rmsZ = std::sqrt(squaredZ / kVerifyTrials);
+  if (rmsZ < 0.7 || rmsZ > 1.5) {
+    return "focus uncertainty off by a factor " + std::to_string(rmsZ);
+  }
+  return "";
+}
+
+bool sweepsAgree(benchmark::State& state) {
+  static const std::string error = verifySweeps();
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Cost of one sample after `range(0)` samples: constant, no refit over history
+void BM_VCurveAddSample(benchmark::State& state) {
+  const int history = static_cast<int>(state.range(0));
+  VCurveFitter fitter;
+  for (int i = 0; i < history; ++i) {
+    const double u = (i % 33 - 16) / 4.0;
+    fitter.addSample(kNominalFocus + i % 33 * 100.0, static_cast<float>(kMinimumHFD * std::sqrt(1.0 + u * u)), 100);
+  }
+  for (auto _ : state) {
+    VCurveFitter copy = fitter;
+    benchmark::DoNotOptimize(copy.addSample(kNominalFocus, static_cast<float>(kMinimumHFD), 100));
+  }
+}
+
+// Exposures per autofocus run with early termination, by focus tolerance
+void BM_AutofocusSweep(benchmark::State& state) {
+  if (!sweepsAgree(state)) return;
+  AutofocusConfig config;
+  config.focusTolerance = static_cast<double>(state.range(0));
+
+  double exposures = 0.0, absoluteError = 0.0, runs = 0.0;
+  uint32_t seed = 0;
+  for (auto _ : state) {
+    const SweepResult result = runSweep(seed++, config, true);
+    exposures += result.exposures;
+    absoluteError += std::abs(result.error);
+    runs += 1.0;
+  }
+  state.counters["exposures"] = exposures / runs;
+  state.counters["full_sweep"] = 2.0 * kSweepHalfWidth / kSweepStep + 1.0;
+  state.counters["focus_error"] = absoluteError / runs;
+}
+
+}  // namespace
+
+BENCHMARK(BM_VCurveAddSample)->Arg(8)->Arg(64)->Arg(4096);
+BENCHMARK(BM_AutofocusSweep)->ArgName("tolerance")->Arg(5)->Arg(10)->Arg(20)->Arg(40);
@@ -0,0 +1,36 @@
+// Sort + copying sigma clip vs linear-time robust background estimator
+// (agreement with the reference: test/background_test.cpp)
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "background_estimator.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+void BM_RobustBackground(benchmark::State& state) {
+  const auto values = makeBackgroundSample(7, static_cast<size_t>(state.range(0)), 12.0, state.range(1) != 0);
+  const std::vector<double> asDouble(values.begin(), values.end());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeRobustBackground(asDouble));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_RobustBackgroundLinear(benchmark::State& state) {
+  const auto values = makeBackgroundSample(7, static_cast<size_t>(state.range(0)), 12.0, state.range(1) != 0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeRobustBackgroundLinear(values));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// {sample size, contaminated}: 709 = default annulus, 65536 = frame sample
+#define BACKGROUND_ARGS ArgsProduct({{709, 65536}, {0, 1}})
+
+BENCHMARK(BM_RobustBackground)->BACKGROUND_ARGS;
+BENCHMARK(BM_RobustBackgroundLinear)->BACKGROUND_ARGS;
+
+}  // namespace
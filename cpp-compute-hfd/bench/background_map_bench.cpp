@@ -0,0 +1,105 @@
+// Tiled background map: estimation cost by frame size and threads, row interpolation cost
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <map>
+#include <string>
+
+#include "background_map.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr double kGradient = 1000.0;           // ADU across the frame diagonal
+constexpr double kMaxLevelError = 3.0;         // ADU, against the true gradient (read noise = 10 ADU)
+constexpr double kMaxRmsRelativeError = 0.2;
+
+// Gradient frames: 0 = 4096 x 4096, 1 = full-resolution 9576 x 6388
+const StarField& cachedGradientField(int frame) {
+  static std::map<int, StarField> fields;
+  auto it = fields.find(frame);
+  if (it == fields.end()) {
+    StarFieldConfig config;
+    if (frame == 1) {
+      config.width = 9576;
+      config.height = 6388;
+      config.starCount = 3000;
+    }
+    config.gradient = kGradient;
+    it = fields.emplace(frame, makeStarField(config)).first;
+  }
+  return it->second;
+}
+
+// Empty string if the interpolated map follows the true background of frame 0
+std::string verifyAgainstTruth() {
+  StarFieldConfig config;
+  config.gradient = kGradient;
+  const StarField& field = cachedGradientField(0);
+  WorkStealingPool pool;
+  const BackgroundMap map = estimateBackgroundMap(field.image, pool);
+
+  std::vector<float> level(static_cast<size_t>(field.image.cols)), rms(static_cast<size_t>(field.image.cols));
+  for (int y = 0; y < field.image.rows; y += 7) {
+    map.interpolateRow(y, level.data(), rms.data());
+    for (int x = 0; x < field.image.cols; ++x) {
+      const double truth = syntheticBackground(config, x, y) - 0.5;  // Generator truncates to uint16
+      if (std::abs(level[x] - truth) > kMaxLevelError) {
+        return "level off by " + std::to_string(level[x] - truth) + " ADU at (" + std::to_string(x) + ", " +
+               std::to_string(y) + ")";
+      }
+      if (std::abs(rms[x] - config.readNoise) > kMaxRmsRelativeError * config.readNoise) {
+        return "rms " + std::to_string(rms[x]) + " at (" + std::to_string(x) + ", " + std::to_string(y) + ")";
+      }
+    }
+  }
+  return "";
+}
+
+bool mapMatchesTruth(benchmark::State& state) {
+  static const std::string error = verifyAgainstTruth();
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return false;
+  }
+  return true;
+}
+
+void BM_BackgroundMapEstimate(benchmark::State& state) {
+  if (!mapMatchesTruth(state)) return;
+  const StarField& field = cachedGradientField(static_cast<int>(state.range(0)));
+  WorkStealingPool pool(static_cast<unsigned>(state.range(1)));
+
+  for (auto _ : state) {
+    BackgroundMap map = estimateBackgroundMap(field.image, pool);
+    benchmark::DoNotOptimize(map.levelMesh().data());
+  }
+  state.counters["megapixels_per_second"] = benchmark::Counter(
+      field.image.total() * 1e-6 * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+// Expanding the map for one full-resolution row (what detection pays per row)
+void BM_BackgroundMapInterpolateRow(benchmark::State& state) {
+  const StarField& field = cachedGradientField(1);
+  WorkStealingPool pool;
+  const BackgroundMap map = estimateBackgroundMap(field.image, pool);
+
+  std::vector<float> level(static_cast<size_t>(field.image.cols)), rms(static_cast<size_t>(field.image.cols));
+  int y = 0;
+  for (auto _ : state) {
+    map.interpolateRow(y, level.data(), rms.data());
+    benchmark::DoNotOptimize(level.data());
+    y = (y + 1) % field.image.rows;
+  }
+  state.SetItemsProcessed(state.iterations() * field.image.cols);
+}
+
+}  // namespace
+
+BENCHMARK(BM_BackgroundMapEstimate)
+    ->ArgsProduct({{0, 1}, {1, 2, 4}})
+    ->ArgNames({"frame", "threads"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_BackgroundMapInterpolateRow);
@@ -0,0 +1,160 @@
+// Batch HFD: StarMeasurement records vs the structure-of-arrays StarTable
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "hfd_engine.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+struct BatchInput {
+  StarField field;
+  std::vector<cv::Rect> stamps;
+};
+
+// Fields are expensive to render, so cache one per star count
+const BatchInput& cachedInput(int starCount) {
+  static std::map<int, BatchInput> inputs;
+  auto it = inputs.find(starCount);
+  if (it == inputs.end()) {
+    StarFieldConfig config;
+    config.starCount = starCount;
+    BatchInput input{makeStarField(config), {}};
+
+    HFDEngine engine(HFDEngineConfig(), 1);
+    const int half = kDefaultStampSize / 2;
+    for (const StarCandidate& candidate : engine.detectStars(input.field.image)) {
+      input.stamps.push_back(
+          cv::Rect(candidate.peak.x - half, candidate.peak.y - half, kDefaultStampSize, kDefaultStampSize));
+    }
+    it = inputs.emplace(starCount, std::move(input)).first;
+  }
+  return it->second;
+}
+
+// Every column matches the record path bit for bit, including clipped and
+// empty stamps, and a warmed-up batch does not allocate
+std::string verifyBatch() {
+  BatchInput input = cachedInput(500);
+  const cv::Size size = input.field.image.size();
+  input.stamps.push_back(cv::Rect(-20, -20, kDefaultStampSize, kDefaultStampSize));
+  input.stamps.push_back(cv::Rect(size.width - 10, size.height / 2, kDefaultStampSize, kDefaultStampSize));
+  input.stamps.push_back(cv::Rect(size.width + 100, 0, kDefaultStampSize, kDefaultStampSize));
+
+  HFDEngineConfig config;
+  config.psfShape = true;
+  HFDEngine engine(config, 2);
+  const FrameHFDResult records = engine.measureStamps(input.field.image, input.stamps);
+  StarTable table;
+  engine.measureStamps(input.field.image, input.stamps, table);
+
+  if (table.size() != records.stars.size()) return "row count mismatch";
+  for (size_t i = 0; i < table.size(); ++i) {
+    const StarMeasurement& star = records.stars[i];
+    if (table.x[i] != star.centroid.x || table.y[i] != star.centroid.y ||
+        table.backgroundLevel[i] != static_cast<float>(star.background.level) ||
+        table.backgroundStdDev[i] != static_cast<float>(star.background.stddev) ||
+        table.hfd[i] != star.hfd || table.flux[i] != star.flux ||
+        table.peak[i] != star.peakValue || table.flags[i] != star.flags ||
+        table.fwhm[i] != star.shape.fwhm || table.ellipticity[i] != star.shape.ellipticity ||
+        table.positionAngle[i] != star.shape.positionAngle) {
+      return "column mismatch at row " + std::to_string(i);
+    }
+  }
+  const size_t rows = table.size();
+  if (!(table.flags[rows - 3] & kStarFlagClipped) || !(table.flags[rows - 2] & kStarFlagClipped) ||
+      table.flags[rows - 1] != kStarFlagEmpty) {
+    return "edge stamps not flagged";
+  }
+
+  // One worker, so the warm-up call has sized every thread_local buffer the
+  // timed call can reach
+  HFDEngine serialEngine(HFDEngineConfig(), 1);
+  serialEngine.measureStamps(input.field.image, input.stamps, table);
+  const size_t before = allocationCount();
+  serialEngine.measureStamps(input.field.image, input.stamps, table);
+  const size_t allocations = allocationCount() - before;
+  if (allocations != 0) {
+    return "warmed-up batch allocated " + std::to_string(allocations) + " times";
+  }
+  return "";
+}
+
+bool batchAgrees(benchmark::State& state) {
+  static const std::string error = verifyBatch();
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Median HFD over measured stars, as a typical downstream reduction over one
+// column (upper median; in place in a reused buffer)
+float medianMeasuredHFD(const std::vector<float>& hfd, std::vector<float>& scratch) {
+  scratch.clear();
+  for (float value : hfd) {
+    if (value > 0.0f) scratch.push_back(value);
+  }
+  if (scratch.empty()) return 0.0f;
+  std::nth_element(scratch.begin(), scratch.begin() + scratch.size() / 2, scratch.end());
+  return scratch[scratch.size() / 2];
+}
+
+void BM_BatchMeasureRecords(benchmark::State& state) {
+  const BatchInput& input = cachedInput(static_cast<int>(state.range(0)));
+  HFDEngine engine(HFDEngineConfig(), static_cast<unsigned>(state.range(1)));
+
+  size_t allocations = 0;
+  for (auto _ : state) {
+    const size_t before = allocationCount();
+    FrameHFDResult result = engine.measureStamps(input.field.image, input.stamps);
+    allocations += allocationCount() - before;
+    benchmark::DoNotOptimize(result.medianHFD);
+  }
+  state.counters["allocs_per_batch"] = static_cast<double>(allocations) / state.iterations();
+  state.counters["stars_per_second"] = benchmark::Counter(
+      static_cast<double>(input.stamps.size()) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+void BM_BatchMeasureTable(benchmark::State& state) {
+  if (!batchAgrees(state)) return;
+  const BatchInput& input = cachedInput(static_cast<int>(state.range(0)));
+  HFDEngine engine(HFDEngineConfig(), static_cast<unsigned>(state.range(1)));
+
+  StarTable table;
+  std::vector<float> medianScratch;
+  engine.measureStamps(input.field.image, input.stamps, table);  // Warm-up: size table and thread scratch
+  medianMeasuredHFD(table.hfd, medianScratch);
+
+  size_t allocations = 0;
+  for (auto _ : state) {
+    const size_t before = allocationCount();
+    engine.measureStamps(input.field.image, input.stamps, table);
+    benchmark::DoNotOptimize(medianMeasuredHFD(table.hfd, medianScratch));
+    allocations += allocationCount() - before;
+  }
+  state.counters["allocs_per_batch"] = static_cast<double>(allocations) / state.iterations();
+  state.counters["stars_per_second"] = benchmark::Counter(
+      static_cast<double>(input.stamps.size()) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+void starCountByThreads(benchmark::internal::Benchmark* bench) {
+  for (int stars : {100, 1000, 5000}) {
+    for (int threads : {1, 4}) {
+      bench->Args({stars, threads});
+    }
+  }
+  bench->ArgNames({"stars", "threads"})->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+}  // namespace
+
+BENCHMARK(BM_BatchMeasureRecords)->Apply(starCountByThreads);
+BENCHMARK(BM_BatchMeasureTable)->Apply(starCountByThreads);
@@ -0,0 +1,49 @@
+// In-stamp hot-pixel / cosmic-ray rejection: cost per stamp
+// (repair accuracy: test/defect_test.cpp)
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+#include "hfd_engine.hpp"
+#include "stamp_defects.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr uint16_t kHotValue = 60000;
+
+// state.range(0): defects written into the stamp
+void BM_RejectStampDefects(benchmark::State& state) {
+  std::mt19937 rng(3);
+  cv::Mat stamp = makeNoisyStar(2.0, 20000.0, rng);
+  std::uniform_int_distribution<int> position(1, 48);
+  for (int i = 0; i < state.range(0); ++i) {
+    stamp.at<uint16_t>(position(rng), position(rng)) = kHotValue;
+  }
+  const BackgroundStats background = computeBackgroundStats(stamp, cv::Point2f(25.0f, 25.0f));
+  cv::Mat repaired;
+  int repairedPixels = 0;
+  for (auto _ : state) {
+    repairedPixels = rejectStampDefects(stamp, background, repaired).repaired();
+    benchmark::DoNotOptimize(repairedPixels);
+  }
+  state.counters["repaired"] = repairedPixels;
+  state.counters["stamps_per_second"] = benchmark::Counter(static_cast<double>(state.iterations()),
+                                                           benchmark::Counter::kIsRate);
+}
+
+// HFD pass on the same stamp, for scale
+void BM_HFDHistogramStamp(benchmark::State& state) {
+  std::mt19937 rng(3);
+  const cv::Mat stamp = makeNoisyStar(2.0, 20000.0, rng);
+  const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeHFDHistogram(stamp, bc.centroid, bc.background));
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_RejectStampDefects)->ArgName("defects")->Arg(0)->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK(BM_HFDHistogramStamp);
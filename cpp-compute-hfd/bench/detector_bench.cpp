@@ -0,0 +1,117 @@
+// Connected-component star detection by star density and frame size
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "star_detector.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr float kMatchRadius = 1.0f;           // Detected centroid to true center (pixels)
+constexpr double kMinRecall = 0.99;
+constexpr int kHotPixels = 500;
+
+// Frames: 0 = 4096 x 4096, 1 = full-resolution 9576 x 6388
+StarFieldConfig fieldConfig(int frame, int starCount) {
+  StarFieldConfig config;
+  if (frame == 1) {
+    config.width = 9576;
+    config.height = 6388;
+  }
+  config.starCount = starCount;
+  return config;
+}
+
+const StarField& cachedField(int frame, int starCount) {
+  static std::map<std::pair<int, int>, StarField> fields;
+  const auto key = std::make_pair(frame, starCount);
+  auto it = fields.find(key);
+  if (it == fields.end()) {
+    it = fields.emplace(key, makeStarField(fieldConfig(frame, starCount))).first;
+  }
+  return it->second;
+}
+
+size_t matchedStars(const std::vector<SyntheticStar>& truth, const std::vector<DetectedStar>& detected) {
+  size_t matched = 0;
+  for (const DetectedStar& star : detected) {
+    for (const SyntheticStar& t : truth) {
+      const cv::Point2f d = star.centroid - t.center;
+      if (d.x * d.x + d.y * d.y <= kMatchRadius * kMatchRadius) {
+        matched++;
+        break;
+      }
+    }
+  }
+  return matched;
+}
+
+// Empty string if the detector finds the synthetic stars, and only them, with
+// hot pixels sprinkled in, and rejects a field of saturated stars
+std::string verifyDetector() {
+  WorkStealingPool pool;
+
+  StarFieldConfig config = fieldConfig(0, 1000);
+  config.width = config.height = 2048;
+  StarField field = makeStarField(config);
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> position(0, config.width - 1);
+  for (int i = 0; i < kHotPixels; ++i) {
+    field.image.at<uint16_t>(position(rng), position(rng)) = 60000;
+  }
+
+  const StarDetection detection = detectStarComponents(field.image, estimateBackgroundMap(field.image, pool), pool);
+  const size_t matched = matchedStars(field.stars, detection.stars);
+  if (matched < kMinRecall * field.stars.size()) {
+    return "found " + std::to_string(matched) + " of " + std::to_string(field.stars.size()) + " stars";
+  }
+  if (detection.stars.size() > matched + field.stars.size() / 100) {
+    return std::to_string(detection.stars.size() - matched) + " false detections";
+  }
+  if (detection.rejectedHotPixels < kHotPixels * 9 / 10) {
+    return "only " + std::to_string(detection.rejectedHotPixels) + " hot pixels rejected";
+  }
+
+  config.peakMin = config.peakMax = 200000.0;
+  const StarField saturated = makeStarField(config);
+  const StarDetection rejected = detectStarComponents(saturated.image, estimateBackgroundMap(saturated.image, pool), pool);
+  if (!rejected.stars.empty()) {
+    return std::to_string(rejected.stars.size()) + " saturated stars accepted";
+  }
+  return "";
+}
+
+void BM_DetectStarComponents(benchmark::State& state) {
+  static const std::string error = verifyDetector();
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  const StarField& field = cachedField(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  WorkStealingPool pool;
+  const BackgroundMap background = estimateBackgroundMap(field.image, pool);
+
+  size_t stars = 0;
+  for (auto _ : state) {
+    StarDetection detection = detectStarComponents(field.image, background, pool);
+    stars = detection.stars.size();
+    benchmark::DoNotOptimize(detection.stars.data());
+  }
+  state.counters["stars"] = static_cast<double>(stars);
+  state.counters["megapixels_per_second"] = benchmark::Counter(
+      field.image.total() * 1e-6 * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_DetectStarComponents)
+    ->ArgsProduct({{0, 1}, {100, 1000, 10000}})
+    ->ArgNames({"frame", "stars"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,75 @@
+// Full-frame engine throughput: stars/second against star count and thread count
+
+#include <benchmark/benchmark.h>
+
+#include <map>
+
+#include "hfd_engine.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+// Fields are expensive to render, so cache one per star count
+const StarField& cachedField(int starCount) {
+  static std::map<int, StarField> fields;
+  auto it = fields.find(starCount);
+  if (it == fields.end()) {
+    StarFieldConfig config;
+    config.starCount = starCount;
+    it = fields.emplace(starCount, makeStarField(config)).first;
+  }
+  return it->second;
+}
+
+// Measurement only: background, centroid and HFD on pre-detected stamps
+void BM_EngineMeasureStars(benchmark::State& state) {
+  const int starCount = static_cast<int>(state.range(0));
+  const unsigned threads = static_cast<unsigned>(state.range(1));
+  const StarField& field = cachedField(starCount);
+
+  HFDEngine engine(HFDEngineConfig(), threads);
+  const std::vector<StarCandidate> candidates = engine.detectStars(field.image);
+
+  size_t measured = 0;
+  for (auto _ : state) {
+    FrameHFDResult result = engine.measureCandidates(field.image, candidates);
+    measured = result.measuredStars;
+    benchmark::DoNotOptimize(result.medianHFD);
+  }
+  state.counters["stars"] = static_cast<double>(measured);
+  state.counters["stars_per_second"] = benchmark::Counter(
+      static_cast<double>(candidates.size()) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+// Detection plus measurement on the whole frame
+void BM_EngineMeasureFrame(benchmark::State& state) {
+  const int starCount = static_cast<int>(state.range(0));
+  const unsigned threads = static_cast<unsigned>(state.range(1));
+  const StarField& field = cachedField(starCount);
+
+  HFDEngine engine(HFDEngineConfig(), threads);
+
+  size_t stars = 0;
+  for (auto _ : state) {
+    FrameHFDResult result = engine.measureFrame(field.image);
+    stars = result.stars.size();
+    benchmark::DoNotOptimize(result.medianHFD);
+  }
+  state.counters["stars"] = static_cast<double>(stars);
+  state.counters["stars_per_second"] = benchmark::Counter(
+      static_cast<double>(stars) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+void starCountByThreads(benchmark::internal::Benchmark* bench) {
+  for (int stars : {100, 500, 1000, 2000}) {
+    for (int threads : {1, 2, 4, 8}) {
+      bench->Args({stars, threads});
+    }
+  }
+  bench->ArgNames({"stars", "threads"})->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+}  // namespace
+
+BENCHMARK(BM_EngineMeasureStars)->Apply(starCountByThreads);
+BENCHMARK(BM_EngineMeasureFrame)->Apply(starCountByThreads);
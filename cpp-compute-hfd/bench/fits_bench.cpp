@@ -0,0 +1,36 @@
+// Batch HFD over memory-mapped FITS files: frames/second by worker count
+// (decoding and the columnar file: test/fits_test.cpp)
+
+#include <benchmark/benchmark.h>
+
+#include "fits_batch.hpp"
+#include "synthetic_fits.hpp"
+
+namespace {
+
+// Files in the temp directory, written once per process
+const FitsSet& cachedSet() {
+  static const FitsSet set = writeFitsSet("/tmp/compute_hfd_bench_");
+  return set;
+}
+
+// Mapping, decoding, detection and measurement of the whole set; after the
+// first run the files come from the page cache
+void BM_FitsBatch(benchmark::State& state) {
+  const FitsSet& set = cachedSet();
+  FitsBatchConfig config;
+  config.threads = static_cast<unsigned>(state.range(0));
+  size_t stars = 0;
+  for (auto _ : state) {
+    const FitsBatchResult result = measureFitsFiles(set.paths, config);
+    stars = result.stars.size();
+    benchmark::DoNotOptimize(result.frames.data());
+  }
+  state.counters["stars"] = static_cast<double>(stars);
+  state.counters["frames_per_second"] = benchmark::Counter(
+      static_cast<double>(set.frames.size()) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_FitsBatch)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
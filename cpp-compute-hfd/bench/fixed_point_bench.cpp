@@ -0,0 +1,81 @@
+// Fixed-point HFD pipeline: cost against the floating-point one
+// (bit-reproducibility and the golden hash: test/fixed_point_test.cpp)
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "hfd_engine.hpp"
+#include "hfd_fixed_point.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr int kIntegerStamps = 64;  // Stamps per benchmark pass
+
+const std::vector<cv::Mat>& integerStamps() {
+  static std::vector<cv::Mat> stamps;
+  if (stamps.empty()) {
+    for (int i = 0; i < kIntegerStamps; ++i) stamps.push_back(makeIntegerStamp(static_cast<uint32_t>(i)));
+  }
+  return stamps;
+}
+
+struct FixedResult {
+  BackgroundAndCentroid bc;
+  float hfd;
+  double flux;
+};
+
+FixedResult measureFixed(const cv::Mat& stamp, SimdLevel level) {
+  FixedResult r;
+  r.bc = computeBackgroundAndCentroidFixed(stamp, kBackgroundSigmaThreshold, kMinBackgroundRadius,
+                                           kMaxBackgroundRadius, level);
+  r.hfd = computeHFDFixed(stamp, r.bc.centroid, r.bc.background, kMaxApertureRadius, kHFDBackgroundMultiplier,
+                          &r.flux);
+  return r;
+}
+
+// state.range(0): 0 floating-point (SIMD, linear background), 1 fixed-point
+void BM_StampPipeline(benchmark::State& state) {
+  const std::vector<cv::Mat>& stamps = integerStamps();
+  const bool fixedPoint = state.range(0) != 0;
+  size_t i = 0;
+  for (auto _ : state) {
+    const cv::Mat& stamp = stamps[i++ % stamps.size()];
+    if (fixedPoint) {
+      benchmark::DoNotOptimize(measureFixed(stamp, activeSimdLevel()).hfd);
+    } else {
+      const BackgroundAndCentroid bc = computeBackgroundAndCentroidSIMD(
+          stamp, kBackgroundSigmaThreshold, kMinBackgroundRadius, kMaxBackgroundRadius, activeSimdLevel(),
+          BackgroundEstimator::Linear);
+      benchmark::DoNotOptimize(computeHFDHistogram(stamp, bc.centroid, bc.background));
+    }
+  }
+  state.counters["stars_per_second"] = benchmark::Counter(static_cast<double>(state.iterations()),
+                                                          benchmark::Counter::kIsRate);
+}
+
+// Engine measurement of a detected field, both modes
+void BM_EngineFixedPoint(benchmark::State& state) {
+  static const StarField field = [] {
+    StarFieldConfig config;
+    config.starCount = 1000;
+    return makeStarField(config);
+  }();
+  HFDEngineConfig config;
+  config.fixedPoint = state.range(0) != 0;
+  HFDEngine engine(config, static_cast<unsigned>(state.range(1)));
+  const std::vector<StarCandidate> candidates = engine.detectStars(field.image);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(engine.measureCandidates(field.image, candidates).medianHFD);
+  }
+  state.counters["stars_per_second"] = benchmark::Counter(
+      static_cast<double>(candidates.size()) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_StampPipeline)->ArgName("fixed")->Arg(0)->Arg(1);
+BENCHMARK(BM_EngineFixedPoint)->ArgNames({"fixed", "threads"})->ArgsProduct({{0, 1}, {1, 4}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,145 @@
+// Focal-plane HFD map: cost of the per-region reduction next to measureFrame
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "focal_plane_map.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr double kSigmaTilt = 1.0;                    // Rendered sigma rise across the frame (pixels)
+constexpr double kMaxFrameOverhead = 0.05;            // Map time / measureFrame time
+
+struct MeasuredField {
+  StarField field;
+  FrameHFDResult result;
+  double measureSeconds;         // Best of a few measureFrame calls
+};
+
+// Fields are expensive to render and measure, so cache one per star count
+const MeasuredField& cachedField(int starCount, unsigned threads) {
+  static std::map<std::pair<int, unsigned>, MeasuredField> fields;
+  const auto key = std::make_pair(starCount, threads);
+  auto it = fields.find(key);
+  if (it == fields.end()) {
+    StarFieldConfig config;
+    config.starCount = starCount;
+    config.sigmaTilt = kSigmaTilt;
+    MeasuredField measured{makeStarField(config), {}, 1e9};
+
+    HFDEngine engine(HFDEngineConfig(), threads);
+    for (int run = 0; run < 3; ++run) {
+      const auto start = std::chrono::steady_clock::now();
+      measured.result = engine.measureFrame(measured.field.image);
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      measured.measureSeconds = std::min(measured.measureSeconds, elapsed.count());
+    }
+    it = fields.emplace(key, std::move(measured)).first;
+  }
+  return it->second;
+}
+
+// Serial reference: sort each cell's HFDs
+std::vector<float> referenceMedians(const FrameHFDResult& result, const cv::Size& size, int cols, int rows) {
+  std::vector<std::vector<double>> cells(static_cast<size_t>(cols) * rows);
+  for (const StarMeasurement& star : result.stars) {
+    if (!(star.hfd > 0.0f)) continue;
+    const int col = std::min(cols - 1, static_cast<int>(static_cast<double>(star.centroid.x) * cols / size.width));
+    const int row = std::min(rows - 1, static_cast<int>(static_cast<double>(star.centroid.y) * rows / size.height));
+    cells[static_cast<size_t>(row) * cols + col].push_back(star.hfd);
+  }
+  std::vector<float> medians;
+  for (const std::vector<double>& cell : cells) {
+    medians.push_back(static_cast<float>(computeMedian(cell)));
+  }
+  return medians;
+}
+
+// Empty string if the parallel map matches the serial medians on several grids,
+// sees the rendered left-to-right tilt, and costs under kMaxFrameOverhead of
+// measuring the frame
+std::string verifyFocalPlane() {
+  const MeasuredField& measured = cachedField(1000, 4);
+  const cv::Size size = measured.field.image.size();
+  WorkStealingPool pool(4);
+
+  for (const auto& grid : {std::make_pair(3, 3), std::make_pair(4, 2), std::make_pair(8, 8)}) {
+    FocalPlaneConfig config;
+    config.cols = grid.first;
+    config.rows = grid.second;
+    FocalPlaneMapper mapper(pool, config);
+    const FocalPlaneMap& map = mapper.build(measured.result, size);
+    const std::vector<float> expected = referenceMedians(measured.result, size, grid.first, grid.second);
+    for (size_t cell = 0; cell < expected.size(); ++cell) {
+      if (map.cells[cell].medianHFD != expected[cell]) {
+        return "median mismatch in cell " + std::to_string(cell) + " of a " + std::to_string(grid.first) + "x" +
+               std::to_string(grid.second) + " grid";
+      }
+    }
+  }
+
+  // HFD ~ 2.35 sigma, so the rendered tilt adds ~2.35 px from left to right
+  FocalPlaneMapper mapper(pool);
+  const FocalPlaneMap& map = mapper.build(measured.result, size);
+  const double expectedTiltX = 2.0 / 3.0 * kSigmaTilt * kFWHMPerSigma;
+  if (std::abs(map.tiltX - expectedTiltX) > 0.2 * expectedTiltX) {
+    return "tiltX " + std::to_string(map.tiltX) + ", expected about " + std::to_string(expectedTiltX);
+  }
+  if (std::abs(map.tiltY) > 0.1 * expectedTiltX || std::abs(map.curvature) > 0.1 * expectedTiltX) {
+    return "tilt along y or curvature on a field tilted along x";
+  }
+
+  const int repeats = 100;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    benchmark::DoNotOptimize(mapper.build(measured.result, size).centerHFD);
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  if (elapsed.count() / repeats > kMaxFrameOverhead * measured.measureSeconds) {
+    return "map costs more than 5% of measureFrame";
+  }
+  return "";
+}
+
+void BM_FocalPlaneMap(benchmark::State& state) {
+  static const std::string error = verifyFocalPlane();
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  const int starCount = static_cast<int>(state.range(0));
+  const int grid = static_cast<int>(state.range(1));
+  const MeasuredField& measured = cachedField(starCount, 4);
+  const cv::Size size = measured.field.image.size();
+  WorkStealingPool pool(4);
+  FocalPlaneConfig config;
+  config.cols = grid;
+  config.rows = grid;
+  FocalPlaneMapper mapper(pool, config);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mapper.build(measured.result, size).curvature);
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  const double perMap = elapsed.count() / std::max<benchmark::IterationCount>(1, state.iterations());
+  state.counters["frame_overhead"] = perMap / measured.measureSeconds;
+  state.counters["stars_per_second"] = benchmark::Counter(
+      static_cast<double>(measured.result.stars.size()) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_FocalPlaneMap)
+    ->ArgsProduct({{100, 1000, 5000}, {3, 8}})
+    ->ArgNames({"stars", "grid"})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
@@ -0,0 +1,215 @@
+// Per-function cost of the hfd_utils.hpp pipeline on synthetic star fields,
+// end-to-end stars/second with allocations per star, and HFD accuracy against
+// the rendered ground truth
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "hfd_utils.hpp"
+#include "stamp_defects.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr int    kFieldSize = 2048;                   // Frame edge (pixels)
+constexpr int    kFieldStars = 500;
+constexpr int    kStampSize = 50;                     // As findBrightestRegion and HFDEngine
+constexpr double kOutlierError = 0.1;                 // Relative HFD error counted as an outlier
+
+// A field and one stamp per star, centered on its true position. Stamps are
+// not taken from detection, so every star has a ground truth.
+struct FieldStamps {
+  StarField field;
+  std::vector<cv::Mat> stamps;
+  std::vector<double> truth;     // True HFD of each stamp's star
+};
+
+// Field parameters: sigma in tenths of a pixel, read noise (ADU), hot pixels
+using FieldKey = std::tuple<int, int, int>;
+
+const FieldStamps& cachedStamps(const FieldKey& key) {
+  static std::map<FieldKey, FieldStamps> cases;
+  auto it = cases.find(key);
+  if (it == cases.end()) {
+    StarFieldConfig config;
+    config.width = kFieldSize;
+    config.height = kFieldSize;
+    config.starCount = kFieldStars;
+    config.sigma = std::get<0>(key) / 10.0;
+    config.readNoise = std::get<1>(key);
+    config.hotPixels = std::get<2>(key);
+    FieldStamps stamps{makeStarField(config), {}, {}};
+
+    const cv::Rect frame(0, 0, kFieldSize, kFieldSize);
+    for (const SyntheticStar& star : stamps.field.stars) {
+      const cv::Rect rect(cvFloor(star.center.x) - kStampSize / 2, cvFloor(star.center.y) - kStampSize / 2,
+                          kStampSize, kStampSize);
+      if ((rect & frame) != rect) continue;
+      stamps.stamps.push_back(stamps.field.image(rect));
+      stamps.truth.push_back(syntheticHFD(star.sigma));
+    }
+    it = cases.emplace(key, std::move(stamps)).first;
+  }
+  return it->second;
+}
+
+const FieldStamps& stampsArg(const benchmark::State& state) {
+  return cachedStamps(FieldKey(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)),
+                               static_cast<int>(state.range(2))));
+}
+
+void setStarRate(benchmark::State& state, size_t stars) {
+  state.counters["stars_per_second"] = benchmark::Counter(
+      static_cast<double>(stars) * state.iterations(), benchmark::Counter::kIsRate);
+}
+
+void BM_FieldBackgroundStats(benchmark::State& state) {
+  const FieldStamps& stamps = stampsArg(state);
+  const cv::Point2f center(kStampSize / 2.0f, kStampSize / 2.0f);
+  for (auto _ : state) {
+    for (const cv::Mat& stamp : stamps.stamps) {
+      benchmark::DoNotOptimize(computeBackgroundStats(stamp, center));
+    }
+  }
+  setStarRate(state, stamps.stamps.size());
+}
+
+void BM_FieldCentroid(benchmark::State& state) {
+  const FieldStamps& stamps = stampsArg(state);
+  std::vector<BackgroundStats> backgrounds;
+  for (const cv::Mat& stamp : stamps.stamps) {
+    backgrounds.push_back(computeBackgroundAndCentroid(stamp).background);
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i < stamps.stamps.size(); ++i) {
+      benchmark::DoNotOptimize(computeCentroid(stamps.stamps[i], backgrounds[i]));
+    }
+  }
+  setStarRate(state, stamps.stamps.size());
+}
+
+void BM_FieldHFD(benchmark::State& state) {
+  const FieldStamps& stamps = stampsArg(state);
+  std::vector<BackgroundAndCentroid> prepared;
+  for (const cv::Mat& stamp : stamps.stamps) {
+    prepared.push_back(computeBackgroundAndCentroid(stamp));
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i < stamps.stamps.size(); ++i) {
+      benchmark::DoNotOptimize(computeHFD(stamps.stamps[i], prepared[i].centroid, prepared[i].background));
+    }
+  }
+  setStarRate(state, stamps.stamps.size());
+}
+
+// Everything demo.cpp runs per star after finding it
+void BM_FieldStar(benchmark::State& state) {
+  const FieldStamps& stamps = stampsArg(state);
+  const size_t before = allocationCount();
+  for (auto _ : state) {
+    for (const cv::Mat& stamp : stamps.stamps) {
+      const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp);
+      benchmark::DoNotOptimize(computeHFD(stamp, bc.centroid, bc.background));
+    }
+  }
+  const double starsMeasured = static_cast<double>(stamps.stamps.size()) * state.iterations();
+  state.counters["allocations_per_star"] = static_cast<double>(allocationCount() - before) / starsMeasured;
+  setStarRate(state, stamps.stamps.size());
+}
+
+// Accuracy regression: per-field HFD errors relative to the truth, with the
+// golden bounds the library is held to. Fields have read noise: on a noise-free
+// field the annulus stddev is 0 and computeCentroid leaves the stamp center.
+struct AccuracyBounds {
+  FieldKey field;
+  bool rejectDefects;            // rejectStampDefects before centroiding
+  double maxBias;                // |median relative error|
+  double maxScatter;             // 1.4826 MAD of the relative error
+  double maxOutliers;            // Fraction of stars off by more than kOutlierError
+};
+
+const AccuracyBounds kAccuracyBounds[] = {
+    {FieldKey(15, 10, 0), false, 0.02, 0.04, 0.02},
+    {FieldKey(20, 10, 0), false, 0.02, 0.04, 0.02},
+    {FieldKey(30, 10, 0), false, 0.02, 0.03, 0.02},
+    {FieldKey(20, 30, 0), false, 0.02, 0.05, 0.02},
+    {FieldKey(20, 10, 2000), false, 0.25, 0.35, 0.7},  // Unrejected hot pixels pull centroids and HFDs
+    {FieldKey(20, 10, 0), true, 0.02, 0.04, 0.02},
+    {FieldKey(15, 10, 2000), true, 0.02, 0.04, 0.02},
+    {FieldKey(20, 10, 2000), true, 0.02, 0.04, 0.02},
+};
+
+struct AccuracyStats {
+  double bias;
+  double scatter;
+  double outliers;
+};
+
+AccuracyStats measureAccuracy(const FieldStamps& stamps, bool rejectDefects) {
+  std::vector<double> errors;
+  cv::Mat repaired;
+  for (size_t i = 0; i < stamps.stamps.size(); ++i) {
+    cv::Mat stamp = stamps.stamps[i];
+    if (rejectDefects) {
+      const BackgroundStats initial = computeBackgroundStats(stamp, cv::Point2f(kStampSize / 2.0f, kStampSize / 2.0f));
+      if (rejectStampDefects(stamp, initial, repaired).repaired() > 0) stamp = repaired;
+    }
+    const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp);
+    const float hfd = computeHFD(stamp, bc.centroid, bc.background);
+    errors.push_back(hfd / stamps.truth[i] - 1.0);
+  }
+  AccuracyStats stats;
+  stats.bias = computeMedian(errors);
+  std::vector<double> deviations;
+  size_t outliers = 0;
+  for (double error : errors) {
+    deviations.push_back(std::abs(error - stats.bias));
+    outliers += std::abs(error) > kOutlierError;
+  }
+  stats.scatter = 1.4826 * computeMedian(deviations);
+  stats.outliers = static_cast<double>(outliers) / std::max<size_t>(1, errors.size());
+  return stats;
+}
+
+void BM_HFDAccuracy(benchmark::State& state) {
+  const AccuracyBounds& bounds = kAccuracyBounds[state.range(0)];
+  const FieldStamps& stamps = cachedStamps(bounds.field);
+  AccuracyStats stats{};
+  for (auto _ : state) {
+    stats = measureAccuracy(stamps, bounds.rejectDefects);
+  }
+  state.counters["bias"] = stats.bias;
+  state.counters["scatter"] = stats.scatter;
+  state.counters["outliers"] = stats.outliers;
+  if (std::abs(stats.bias) > bounds.maxBias || stats.scatter > bounds.maxScatter ||
+      stats.outliers > bounds.maxOutliers) {
+    state.SkipWithError("HFD accuracy regressed past the golden bounds");
+  }
+}
+
+void fields(benchmark::internal::Benchmark* bench) {
+  bench->Args({20, 10, 0})->Args({20, 30, 0})->Args({20, 10, 2000})->Args({30, 10, 0});
+  bench->ArgNames({"sigma_x10", "noise", "hot_pixels"})->Unit(benchmark::kMicrosecond);
+}
+
+void accuracyFields(benchmark::internal::Benchmark* bench) {
+  for (size_t i = 0; i < std::size(kAccuracyBounds); ++i) {
+    bench->Arg(static_cast<int64_t>(i));
+  }
+  bench->ArgName("field")->Unit(benchmark::kMillisecond)->Iterations(1);
+}
+
+}  // namespace
+
+BENCHMARK(BM_FieldBackgroundStats)->Apply(fields);
+BENCHMARK(BM_FieldCentroid)->Apply(fields);
+BENCHMARK(BM_FieldHFD)->Apply(fields);
+BENCHMARK(BM_FieldStar)->Apply(fields);
+BENCHMARK(BM_HFDAccuracy)->Apply(accuracyFields);
@@ -0,0 +1,136 @@
+// computeHFD vs computeHFDHistogram vs computeHFDPixelArea on the demo.cpp Gaussian stamps
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "hfd_aperture.hpp"
+#include "hfd_utils.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr double kHistogramTolerance = 1e-4;  // Documented agreement of the sort-free kernel (pixels)
+constexpr double kCoverageTableTolerance = 1e-4;  // Table vs exact arcsine (pixels)
+constexpr double kAnalyticTolerance = 0.005;  // Relative error of the pixel-area HFD vs the analytic value
+constexpr int    kSubPixelOffsets = 20;       // Star centers per sigma for the jitter check
+
+struct PreparedStamp {
+  cv::Mat crop;
+  BackgroundAndCentroid result;
+};
+
+// Same pipeline as demo.cpp main(): brightest region, then background and centroid
+PreparedStamp prepareStamp(double sigma) {
+  cv::Mat img = makeGaussianStamp(sigma);
+  cv::Mat crop = img(findBrightestRegion(img, 50));
+  return PreparedStamp{crop, computeBackgroundAndCentroid(crop)};
+}
+
+double sigmaArg(const benchmark::State& state) { return state.range(0) / 10.0; }
+
+void BM_ComputeHFD(benchmark::State& state) {
+  const PreparedStamp stamp = prepareStamp(sigmaArg(state));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeHFD(stamp.crop, stamp.result.centroid, stamp.result.background));
+  }
+  state.counters["hfd"] = computeHFD(stamp.crop, stamp.result.centroid, stamp.result.background);
+}
+
+void BM_ComputeHFDHistogram(benchmark::State& state) {
+  const PreparedStamp stamp = prepareStamp(sigmaArg(state));
+  const float reference = computeHFD(stamp.crop, stamp.result.centroid, stamp.result.background);
+  const float hfd = computeHFDHistogram(stamp.crop, stamp.result.centroid, stamp.result.background);
+  if (std::abs(hfd - reference) > kHistogramTolerance) {
+    state.SkipWithError("computeHFDHistogram disagrees with computeHFD");
+    return;
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeHFDHistogram(stamp.crop, stamp.result.centroid, stamp.result.background));
+  }
+  state.counters["hfd"] = hfd;
+}
+
+// Gaussian of width sigma, integrated over square pixels: HFD = 2 sqrt(2 ln 2) * sqrt(sigma² + 1/12),
+// the 2.355σ of demo.cpp with the pixel's own variance added
+double analyticPixelAreaHFD(double sigma) {
+  return 2.0 * std::sqrt(2.0 * std::log(2.0)) * std::sqrt(sigma * sigma + 1.0 / 12.0);
+}
+
+// Stars rendered at sub-pixel offsets and measured about their true center:
+// the pixel-area HFD must match the analytic value on average, agree between
+// the exact and table coverage paths, and jitter less than computeHFD
+std::string verifyPixelArea(double sigma, float& pointJitter, float& areaJitter) {
+  float pointMin = 1e9f, pointMax = 0.0f, areaMin = 1e9f, areaMax = 0.0f;
+  double areaSum = 0.0;
+  for (int i = 0; i < kSubPixelOffsets; ++i) {
+    const double offset = static_cast<double>(i) / kSubPixelOffsets;
+    const cv::Mat img = makeGaussianStamp(sigma, 100, 50.0 + offset, 50.0 + 0.7 * offset);
+    const cv::Mat crop = img(cv::Rect(25, 25, 50, 50));
+    const cv::Point2f center(static_cast<float>(25.0 + offset), static_cast<float>(25.0 + 0.7 * offset));
+    const BackgroundStats background = computeBackgroundStats(crop, center);
+
+    const float point = computeHFD(crop, center, background);
+    const float area = computeHFDPixelArea(crop, center, background);
+    const float exact = computeHFDPixelArea(crop, center, background, kMaxApertureRadius, kHFDBackgroundMultiplier,
+                                            ApertureCoverage::Exact);
+    if (std::abs(area - exact) > kCoverageTableTolerance) {
+      return "coverage table disagrees with exact overlap at offset " + std::to_string(offset);
+    }
+    pointMin = std::min(pointMin, point);
+    pointMax = std::max(pointMax, point);
+    areaMin = std::min(areaMin, area);
+    areaMax = std::max(areaMax, area);
+    areaSum += area;
+  }
+  pointJitter = pointMax - pointMin;
+  areaJitter = areaMax - areaMin;
+
+  const double expected = analyticPixelAreaHFD(sigma);
+  const double mean = areaSum / kSubPixelOffsets;
+  if (std::abs(mean - expected) > kAnalyticTolerance * expected) {
+    return "pixel-area HFD " + std::to_string(mean) + " vs analytic " + std::to_string(expected);
+  }
+  if (areaJitter >= pointJitter) {
+    return "pixel-area HFD jitters as much as computeHFD";
+  }
+  return "";
+}
+
+template <ApertureCoverage Coverage>
+void BM_ComputeHFDPixelArea(benchmark::State& state) {
+  const double sigma = sigmaArg(state);
+  float pointJitter = 0.0f, areaJitter = 0.0f;
+  const std::string error = verifyPixelArea(sigma, pointJitter, areaJitter);
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  const PreparedStamp stamp = prepareStamp(sigma);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeHFDPixelArea(stamp.crop, stamp.result.centroid, stamp.result.background,
+                                                 kMaxApertureRadius, kHFDBackgroundMultiplier, Coverage));
+  }
+  state.counters["hfd"] = computeHFDPixelArea(stamp.crop, stamp.result.centroid, stamp.result.background);
+  state.counters["point_jitter"] = pointJitter;
+  state.counters["area_jitter"] = areaJitter;
+}
+
+// Sigma in tenths of a pixel
+void sigmas(benchmark::internal::Benchmark* bench) {
+  for (int sigmaTenths : {10, 20, 30, 50}) {
+    bench->Arg(sigmaTenths);
+  }
+  bench->ArgName("sigma_x10");
+}
+
+}  // namespace
+
+BENCHMARK(BM_ComputeHFD)->Apply(sigmas);
+BENCHMARK(BM_ComputeHFDHistogram)->Apply(sigmas);
+BENCHMARK_TEMPLATE(BM_ComputeHFDPixelArea, ApertureCoverage::Table)->Apply(sigmas);
+BENCHMARK_TEMPLATE(BM_ComputeHFDPixelArea, ApertureCoverage::Exact)->Apply(sigmas);
@@ -0,0 +1,143 @@
+// Generic vs compile-time specialized single-star pipeline, per pixel type
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <type_traits>
+
+#include "hfd_pipeline.hpp"
+
+namespace {
+
+constexpr double kLevelTolerance = 1e-9;     // Relative
+constexpr double kCentroidTolerance = 1e-4;  // Pixels
+constexpr float  kHFDTolerance = 1e-4f;      // Pixels
+
+// Noisy off-center star, scaled to the range of the pixel type: 8-bit previews
+// are the 16-bit stamp / 256, float stamps keep fractional values
+template <typename Pixel>
+cv::Mat noisyStamp(uint32_t seed, int size) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> offset(-3.0, 3.0);
+  std::normal_distribution<double> noise(0.0, 15.0);
+  const double scale = std::is_same_v<Pixel, uint8_t> ? 1.0 / 256.0 : 1.0;
+  const double maxValue = std::is_same_v<Pixel, uint8_t> ? 255.0 : 65535.0;
+  const double cx = size / 2.0 + offset(rng);
+  const double cy = size / 2.0 + offset(rng);
+  cv::Mat img(size, size, PixelDepth<Pixel>::value);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const double dx = (x + 0.5) - cx;
+      const double dy = (y + 0.5) - cy;
+      const double val = (1000.0 + 20000.0 * std::exp(-(dx * dx + dy * dy) / 8.0) + noise(rng)) * scale;
+      img.at<Pixel>(y, x) = static_cast<Pixel>(std::max(0.0, std::min(maxValue, val)));
+    }
+  }
+  return img;
+}
+
+// Reference: the generic functions of hfd_utils.hpp
+StampHFD measureStarGeneric(const cv::Mat& stamp, int minRadius, int maxRadius, double aperture) {
+  const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp, kBackgroundSigmaThreshold, minRadius, maxRadius);
+  return StampHFD{bc.background, bc.centroid, computeHFDHistogram(stamp, bc.centroid, bc.background, aperture)};
+}
+
+std::string compare(const StampHFD& expected, const StampHFD& actual) {
+  const double level = kLevelTolerance * std::max(1.0, std::abs(expected.background.level));
+  const double stddev = kLevelTolerance * std::max(1.0, expected.background.stddev);
+  if (std::abs(expected.background.level - actual.background.level) > level ||
+      std::abs(expected.background.stddev - actual.background.stddev) > stddev) {
+    return "background";
+  }
+  if (std::abs(expected.centroid.x - actual.centroid.x) > kCentroidTolerance ||
+      std::abs(expected.centroid.y - actual.centroid.y) > kCentroidTolerance) {
+    return "centroid";
+  }
+  if (std::abs(expected.hfd - actual.hfd) > kHFDTolerance) {
+    return "HFD";
+  }
+  return "";
+}
+
+// Empty string if every instantiation for Pixel agrees with the generic
+// functions: fixed-size and any-size stamps, both compiled geometries, and the
+// removed float copy in computeHFD
+template <typename Pixel>
+std::string verifyPipeline() {
+  for (uint32_t seed = 0; seed < 100; ++seed) {
+    const int size = seed % 2 == 0 ? StandardStampGeometry::kStampSize : 30 + static_cast<int>(seed % 40);
+    const cv::Mat stamp = noisyStamp<Pixel>(seed, size);
+    const StampHFD expected = measureStarGeneric(stamp, kMinBackgroundRadius, kMaxBackgroundRadius, kMaxApertureRadius);
+    std::string error = compare(expected, measureStar(stamp));
+    if (error.empty()) {
+      error = compare(expected, measureStar(stamp, kMinBackgroundRadius, kMaxBackgroundRadius, kMaxApertureRadius));
+    }
+    if (!error.empty()) {
+      return error + " mismatch at seed " + std::to_string(seed);
+    }
+
+    const float sorted = computeHFD(stamp, expected.centroid, expected.background);
+    if (std::abs(sorted - expected.hfd) > kHFDTolerance) {
+      return "computeHFD mismatch at seed " + std::to_string(seed);
+    }
+
+    using Preview = PreviewStampGeometry;
+    const cv::Mat preview = noisyStamp<Pixel>(seed, Preview::kStampSize);
+    const StampHFD previewExpected = measureStarGeneric(preview, Preview::kMinBackgroundRadius,
+                                                        Preview::kMaxBackgroundRadius, Preview::kApertureRadius);
+    error = compare(previewExpected, measureStar<Preview>(preview));
+    if (!error.empty()) {
+      return "preview " + error + " mismatch at seed " + std::to_string(seed);
+    }
+  }
+  return "";
+}
+
+template <typename Pixel>
+bool pipelineVerified(benchmark::State& state) {
+  static const std::string error = verifyPipeline<Pixel>();
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return false;
+  }
+  return true;
+}
+
+// computeBackgroundAndCentroid + computeHFDHistogram, by stamp size
+template <typename Pixel>
+void BM_StarPipelineGeneric(benchmark::State& state) {
+  if (!pipelineVerified<Pixel>(state)) return;
+  const cv::Mat stamp = noisyStamp<Pixel>(1, static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(measureStarGeneric(stamp, kMinBackgroundRadius, kMaxBackgroundRadius, kMaxApertureRadius));
+  }
+  state.SetItemsProcessed(state.iterations());  // items/s = stars/s
+}
+
+// measureStar: fixed-size instantiation at 50 px, any-size one otherwise
+template <typename Pixel>
+void BM_StarPipelineStatic(benchmark::State& state) {
+  if (!pipelineVerified<Pixel>(state)) return;
+  const cv::Mat stamp = noisyStamp<Pixel>(1, static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(measureStar(stamp));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void stampSizes(benchmark::internal::Benchmark* b) {
+  b->ArgName("size")->Arg(StandardStampGeometry::kStampSize)->Arg(43);
+}
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_StarPipelineGeneric, uint8_t)->Apply(stampSizes);
+BENCHMARK_TEMPLATE(BM_StarPipelineStatic, uint8_t)->Apply(stampSizes);
+BENCHMARK_TEMPLATE(BM_StarPipelineGeneric, uint16_t)->Apply(stampSizes);
+BENCHMARK_TEMPLATE(BM_StarPipelineStatic, uint16_t)->Apply(stampSizes);
+BENCHMARK_TEMPLATE(BM_StarPipelineGeneric, float)->Apply(stampSizes);
+BENCHMARK_TEMPLATE(BM_StarPipelineStatic, float)->Apply(stampSizes);
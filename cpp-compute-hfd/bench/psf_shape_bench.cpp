@@ -0,0 +1,123 @@
+// Cost of the fused PSF shape moments on top of the sort-free HFD pass
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+
+#include "psf_shape.hpp"
+
+namespace {
+
+constexpr double kFWHMTolerance = 0.015;          // Relative, vs the rendered Gaussian
+constexpr double kEllipticityTolerance = 0.01;
+constexpr double kPositionAngleTolerance = 0.02;  // Radians, checked for ellipticity above 0.1
+
+struct EllipticalStar {
+  double sigmaMajor;
+  double sigmaMinor;
+  double angle;                  // Major axis from +x towards +y (radians)
+};
+
+// Point-sampled elliptical Gaussian with read noise, off-center
+cv::Mat ellipticalStamp(const EllipticalStar& star, uint32_t seed, double peak = 20000.0) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> offset(-0.5, 0.5);
+  std::normal_distribution<double> noise(0.0, 10.0);
+  const double cx = 25.0 + offset(rng);
+  const double cy = 25.0 + offset(rng);
+  const double c = std::cos(star.angle);
+  const double s = std::sin(star.angle);
+  cv::Mat img(50, 50, CV_16UC1);
+  for (int y = 0; y < img.rows; y++) {
+    for (int x = 0; x < img.cols; x++) {
+      const double dx = (x + 0.5) - cx;
+      const double dy = (y + 0.5) - cy;
+      const double u = (c * dx + s * dy) / star.sigmaMajor;
+      const double v = (-s * dx + c * dy) / star.sigmaMinor;
+      const double val = 1000.0 + peak * std::exp(-0.5 * (u * u + v * v)) + noise(rng);
+      img.at<uint16_t>(y, x) = static_cast<uint16_t>(std::max(0.0, std::min(65535.0, val)));
+    }
+  }
+  return img;
+}
+
+double angleDifference(double a, double b) {
+  const double d = std::fmod(std::abs(a - b), CV_PI);  // Axes, so modulo π
+  return std::min(d, CV_PI - d);
+}
+
+// Empty string if the fused kernel leaves the HFD unchanged and recovers the
+// FWHM, ellipticity and position angle of bright elliptical stars
+std::string verifyShape() {
+  const EllipticalStar stars[] = {{2.0, 2.0, 0.0}, {3.0, 2.0, 0.5}, {2.5, 1.5, -1.0}, {1.2, 1.0, 0.3}, {4.0, 2.0, 1.4}};
+  for (const EllipticalStar& star : stars) {
+    for (uint32_t seed = 0; seed < 10; ++seed) {
+      const cv::Mat stamp = ellipticalStamp(star, seed);
+      const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp);
+      PSFShape shape;
+      const float hfd = computeHFDAndShape(stamp, bc.centroid, bc.background, shape);
+      if (hfd != computeHFDHistogram(stamp, bc.centroid, bc.background)) {
+        return "HFD differs from computeHFDHistogram";
+      }
+
+      const double fwhm = kFWHMPerSigma * std::sqrt(star.sigmaMajor * star.sigmaMinor);
+      const double ellipticity = 1.0 - star.sigmaMinor / star.sigmaMajor;
+      if (std::abs(shape.fwhm - fwhm) > kFWHMTolerance * fwhm) {
+        return "FWHM off for sigma " + std::to_string(star.sigmaMajor) + "x" + std::to_string(star.sigmaMinor);
+      }
+      if (std::abs(shape.ellipticity - ellipticity) > kEllipticityTolerance) {
+        return "ellipticity off for sigma " + std::to_string(star.sigmaMajor) + "x" + std::to_string(star.sigmaMinor);
+      }
+      if (ellipticity > 0.1 && angleDifference(shape.positionAngle, star.angle) > kPositionAngleTolerance) {
+        return "position angle off for angle " + std::to_string(star.angle);
+      }
+    }
+  }
+  return "";
+}
+
+EllipticalStar starArg(const benchmark::State& state) {
+  const double sigma = state.range(0) / 10.0;
+  return EllipticalStar{sigma * 1.3, sigma, 0.4};
+}
+
+void BM_HFDHistogramNoisy(benchmark::State& state) {
+  const cv::Mat stamp = ellipticalStamp(starArg(state), 1);
+  const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeHFDHistogram(stamp, bc.centroid, bc.background));
+  }
+}
+
+void BM_HFDAndShape(benchmark::State& state) {
+  static const std::string error = verifyShape();
+  if (!error.empty()) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+
+  const cv::Mat stamp = ellipticalStamp(starArg(state), 1);
+  const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp);
+  PSFShape shape;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeHFDAndShape(stamp, bc.centroid, bc.background, shape));
+  }
+  state.counters["fwhm"] = shape.fwhm;
+  state.counters["ellipticity"] = shape.ellipticity;
+}
+
+// Minor-axis sigma in tenths of a pixel; the major axis is 1.3x longer
+void sigmas(benchmark::internal::Benchmark* bench) {
+  for (int sigmaTenths : {10, 20, 30}) {
+    bench->Arg(sigmaTenths);
+  }
+  bench->ArgName("sigma_x10");
+}
+
+}  // namespace
+
+BENCHMARK(BM_HFDHistogramNoisy)->Apply(sigmas);
+BENCHMARK(BM_HFDAndShape)->Apply(sigmas);
@@ -0,0 +1,72 @@
+// Scalar vs vectorized centroid and background annulus gather
+// (agreement with the reference functions: test/simd_test.cpp)
+
+#include <benchmark/benchmark.h>
+
+#include "hfd_simd.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+bool levelUsable(benchmark::State& state, SimdLevel level) {
+  if (level == SimdLevel::AVX2 && activeSimdLevel() != SimdLevel::AVX2) {
+    state.SkipWithError("AVX2 not supported on this CPU");
+    return false;
+  }
+  if (level == SimdLevel::NEON && activeSimdLevel() != SimdLevel::NEON) {
+    state.SkipWithError("NEON not supported on this CPU");
+    return false;
+  }
+  state.SetLabel(simdLevelName(level));
+  return true;
+}
+
+void BM_ComputeCentroid(benchmark::State& state) {
+  const cv::Mat stamp = makeNoisyStamp(1);
+  const BackgroundStats background = computeBackgroundStats(stamp, cv::Point2f(25.0f, 25.0f));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeCentroid(stamp, background));
+  }
+}
+
+void BM_ComputeCentroidSIMD(benchmark::State& state) {
+  const SimdLevel level = static_cast<SimdLevel>(state.range(0));
+  if (!levelUsable(state, level)) return;
+
+  const cv::Mat stamp = makeNoisyStamp(1);
+  const BackgroundStats background = computeBackgroundStats(stamp, cv::Point2f(25.0f, 25.0f));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeCentroidSIMD(stamp, background, kBackgroundSigmaThreshold, level));
+  }
+}
+
+void BM_ComputeBackgroundStats(benchmark::State& state) {
+  const cv::Mat stamp = makeNoisyStamp(1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeBackgroundStats(stamp, cv::Point2f(25.0f, 25.0f)));
+  }
+}
+
+void BM_ComputeBackgroundStatsSIMD(benchmark::State& state) {
+  const SimdLevel level = static_cast<SimdLevel>(state.range(0));
+  if (!levelUsable(state, level)) return;
+
+  const cv::Mat stamp = makeNoisyStamp(1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(computeBackgroundStatsSIMD(stamp, cv::Point2f(25.0f, 25.0f), kMinBackgroundRadius,
+                                                        kMaxBackgroundRadius, level));
+  }
+}
+
+void simdLevels(benchmark::internal::Benchmark* bench) {
+  bench->Arg(static_cast<int>(SimdLevel::Scalar));
+  bench->Arg(static_cast<int>(activeSimdLevel() == SimdLevel::NEON ? SimdLevel::NEON : SimdLevel::AVX2));
+  bench->ArgName("level");
+}
+
+}  // namespace
+
+BENCHMARK(BM_ComputeCentroid);
+BENCHMARK(BM_ComputeCentroidSIMD)->Apply(simdLevels);
+BENCHMARK(BM_ComputeBackgroundStats);
+BENCHMARK(BM_ComputeBackgroundStatsSIMD)->Apply(simdLevels);
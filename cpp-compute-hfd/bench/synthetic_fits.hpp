@@ -0,0 +1,85 @@
+// Synthetic 16-bit FITS files of star fields, for the FITS batch benchmarks and tests
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "fits_mmap.hpp"
+#include "synthetic_star_field.hpp"
+
+constexpr int kFitsFrameSize = 1024;                  // Frame edge (pixels)
+constexpr int kFitsFrameStars = 200;
+constexpr int kFitsFiles = 8;                         // Files in a set; the first is a 4-plane cube
+constexpr int kFitsCubePlanes = 4;
+
+inline std::string fitsCard(const std::string& keyword, const std::string& value) {
+  std::string card = keyword;
+  card.resize(8, ' ');
+  card += "= ";
+  card += std::string(20 - std::min<size_t>(20, value.size()), ' ') + value;
+  card.resize(kFitsCardSize, ' ');
+  return card;
+}
+
+// Big-endian 16-bit FITS of the given planes; signed data is stored with BZERO
+// 0 and pixels minus 32768
+inline void writeFits(const std::string& path, const std::vector<cv::Mat>& planes, bool unsignedData) {
+  std::string header = fitsCard("SIMPLE", "T") + fitsCard("BITPIX", "16") +
+                       fitsCard("NAXIS", planes.size() > 1 ? "3" : "2") +
+                       fitsCard("NAXIS1", std::to_string(planes[0].cols)) +
+                       fitsCard("NAXIS2", std::to_string(planes[0].rows));
+  if (planes.size() > 1) header += fitsCard("NAXIS3", std::to_string(planes.size()));
+  header += fitsCard("BZERO", unsignedData ? "32768" : "0") + fitsCard("BSCALE", "1");
+  header += std::string("END").append(kFitsCardSize - 3, ' ');
+  header.resize((header.size() + kFitsBlockSize - 1) / kFitsBlockSize * kFitsBlockSize, ' ');
+
+  std::FILE* out = std::fopen(path.c_str(), "wb");
+  std::fwrite(header.data(), 1, header.size(), out);
+  size_t bytes = 0;
+  for (const cv::Mat& plane : planes) {
+    for (int y = 0; y < plane.rows; ++y) {
+      const uint16_t* row = plane.ptr<uint16_t>(y);
+      for (int x = 0; x < plane.cols; ++x) {
+        const uint16_t stored = row[x] ^ 0x8000;  // Two's complement of value - 32768
+        const uint8_t be[2] = {static_cast<uint8_t>(stored >> 8), static_cast<uint8_t>(stored & 0xff)};
+        std::fwrite(be, 1, 2, out);
+        bytes += 2;
+      }
+    }
+  }
+  const std::string padding((kFitsBlockSize - bytes % kFitsBlockSize) % kFitsBlockSize, '\0');
+  std::fwrite(padding.data(), 1, padding.size(), out);
+  std::fclose(out);
+}
+
+struct FitsSet {
+  std::vector<std::string> paths;
+  std::vector<cv::Mat> frames;   // Source of every plane, in batch frame order
+};
+
+// kFitsFiles star fields written to `prefix` + index + ".fits". The first file
+// is a cube, odd files hold signed data.
+inline FitsSet writeFitsSet(const std::string& prefix) {
+  FitsSet set;
+  for (int file = 0; file < kFitsFiles; ++file) {
+    std::vector<cv::Mat> planes;
+    for (int plane = 0; plane < (file == 0 ? kFitsCubePlanes : 1); ++plane) {
+      StarFieldConfig config;
+      config.width = kFitsFrameSize;
+      config.height = kFitsFrameSize;
+      config.starCount = kFitsFrameStars;
+      config.seed = static_cast<uint32_t>(100 * file + plane);
+      planes.push_back(makeStarField(config).image);
+    }
+    const std::string path = prefix + std::to_string(file) + ".fits";
+    writeFits(path, planes, file % 2 == 0);
+    set.paths.push_back(path);
+    set.frames.insert(set.frames.end(), planes.begin(), planes.end());
+  }
+  return set;
+}
@@ -0,0 +1,226 @@
+// Deterministic synthetic star-field generator for HFD benchmarks and tests
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <opencv2/core.hpp>
+
+struct StarFieldConfig {
+  int width = 4096;
+  int height = 4096;
+  int starCount = 1000;
+  double sigma = 2.0;             // Gaussian PSF sigma (pixels)
+  double sigmaTilt = 0.0;         // Sigma rise from the left to the right edge (pixels), as a tilted sensor
+  double peakMin = 5000.0;        // Star peak range above background (ADU)
+  double peakMax = 40000.0;
+  double background = 1000.0;     // Background level (ADU)
+  double gradient = 0.0;          // Background rise from top-left to bottom-right corner (ADU)
+  double readNoise = 10.0;        // Gaussian noise stddev (ADU), 0 disables noise
+  int hotPixels = 0;              // Single-pixel defects at random positions, stars stay where they were
+  double hotPixelValue = 60000.0; // Hot pixel level (ADU)
+  cv::Point2f offset;             // Shift of every star (pixels), e.g. drift between frames of a sequence
+  uint32_t seed = 42;
+};
+
+struct SyntheticStar {
+  cv::Point2f center;             // True center in frame coordinates
+  double peak;
+  double sigma;
+};
+
+struct StarField {
+  cv::Mat image;                  // CV_16UC1
+  std::vector<SyntheticStar> stars;
+  std::vector<cv::Point> hotPixels;
+};
+
+// True HFD of a Gaussian star: half its flux lies inside the FWHM circle
+inline double syntheticHFD(double sigma) { return 2.0 * std::sqrt(2.0 * std::log(2.0)) * sigma; }
+
+// True background (before noise) at pixel (x, y)
+inline double syntheticBackground(const StarFieldConfig& config, int x, int y) {
+  const double along = 0.5 * ((x + 0.5) / config.width + (y + 0.5) / config.height);
+  return config.background + config.gradient * along;
+}
+
+// Stars are placed on a jittered grid so that every stamp is isolated and the
+// same config always yields the same frame
+inline StarField makeStarField(const StarFieldConfig& config) {
+  StarField field;
+  field.image = cv::Mat(config.height, config.width, CV_16UC1);
+  std::mt19937 rng(config.seed);
+
+  // Background with optional gradient and read noise
+  std::normal_distribution<double> noise(0.0, std::max(config.readNoise, 1e-9));
+  std::vector<float> canvas(static_cast<size_t>(config.width) * config.height);
+  for (int y = 0; y < config.height; ++y) {
+    for (int x = 0; x < config.width; ++x) {
+      float& v = canvas[static_cast<size_t>(y) * config.width + x];
+      v = static_cast<float>(syntheticBackground(config, x, y));
+      if (config.readNoise > 0.0) {
+        v += static_cast<float>(noise(rng));
+      }
+    }
+  }
+
+  // Jittered grid of star positions
+  const double cellSize = std::sqrt(static_cast<double>(config.width) * config.height / std::max(1, config.starCount));
+  const int gridCols = std::max(1, static_cast<int>(std::ceil(config.width / cellSize)));
+  const int gridRows = std::max(1, static_cast<int>(std::ceil(config.height / cellSize)));
+  const double cellW = static_cast<double>(config.width) / gridCols;
+  const double cellH = static_cast<double>(config.height) / gridRows;
+  std::uniform_real_distribution<double> jitter(-0.2, 0.2);
+  std::uniform_real_distribution<double> peak(config.peakMin, config.peakMax);
+
+  const int renderRadius = static_cast<int>(std::ceil(6.0 * (config.sigma + std::max(0.0, config.sigmaTilt))));
+  for (int gy = 0; gy < gridRows && static_cast<int>(field.stars.size()) < config.starCount; ++gy) {
+    for (int gx = 0; gx < gridCols && static_cast<int>(field.stars.size()) < config.starCount; ++gx) {
+      const double cx = (gx + 0.5 + jitter(rng)) * cellW + config.offset.x;
+      const double cy = (gy + 0.5 + jitter(rng)) * cellH + config.offset.y;
+      const double amplitude = peak(rng);
+      const double sigma = config.sigma + config.sigmaTilt * std::min(1.0, std::max(0.0, cx / config.width));
+      field.stars.push_back(SyntheticStar{cv::Point2f(static_cast<float>(cx), static_cast<float>(cy)),
+                                          amplitude, sigma});
+
+      const int x0 = std::max(0, static_cast<int>(cx) - renderRadius);
+      const int x1 = std::min(config.width - 1, static_cast<int>(cx) + renderRadius);
+      const int y0 = std::max(0, static_cast<int>(cy) - renderRadius);
+      const int y1 = std::min(config.height - 1, static_cast<int>(cy) + renderRadius);
+      for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+          const double dx = (x + 0.5) - cx;
+          const double dy = (y + 0.5) - cy;
+          canvas[static_cast<size_t>(y) * config.width + x] +=
+              static_cast<float>(amplitude * std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma)));
+        }
+      }
+    }
+  }
+
+  // Hot pixels from their own generator, so adding them leaves the stars and
+  // the noise unchanged
+  std::mt19937 hotRng(config.seed ^ 0x9e3779b9u);
+  std::uniform_int_distribution<int> hotX(0, config.width - 1);
+  std::uniform_int_distribution<int> hotY(0, config.height - 1);
+  for (int i = 0; i < config.hotPixels; ++i) {
+    const cv::Point p(hotX(hotRng), hotY(hotRng));
+    canvas[static_cast<size_t>(p.y) * config.width + p.x] = static_cast<float>(config.hotPixelValue);
+    field.hotPixels.push_back(p);
+  }
+
+  for (int y = 0; y < config.height; ++y) {
+    uint16_t* row = field.image.ptr<uint16_t>(y);
+    const float* src = &canvas[static_cast<size_t>(y) * config.width];
+    for (int x = 0; x < config.width; ++x) {
+      row[x] = static_cast<uint16_t>(std::max(0.0f, std::min(65535.0f, src[x])));
+    }
+  }
+  return field;
+}
+
+// Single Gaussian star, rendered exactly as makeGaussianStar in demo.cpp
+inline cv::Mat makeGaussianStamp(double sigma, int size = 100, double cx = 50.0, double cy = 50.0,
+                                 double peak = 50000.0, double bg = 1000.0) {
+  cv::Mat img(size, size, CV_16UC1);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      double dx = (x + 0.5) - cx;
+      double dy = (y + 0.5) - cy;
+      double r2 = dx * dx + dy * dy;
+      double star = peak * std::exp(-r2 / (2.0 * sigma * sigma));
+      double val = std::max(0.0, std::min(65535.0, bg + star));
+      img.at<uint16_t>(y, x) = static_cast<uint16_t>(val);
+    }
+  }
+  return img;
+}
+
+// Noisy stamp with the star off-center, so thresholds and annuli are non-trivial
+inline cv::Mat makeNoisyStamp(uint32_t seed, int size = 50) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> offset(-3.0, 3.0);
+  std::normal_distribution<double> noise(0.0, 15.0);
+  const double cx = size / 2.0 + offset(rng);
+  const double cy = size / 2.0 + offset(rng);
+  cv::Mat img(size, size, CV_16UC1);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const double dx = (x + 0.5) - cx;
+      const double dy = (y + 0.5) - cy;
+      const double val = 1000.0 + 20000.0 * std::exp(-(dx * dx + dy * dy) / 8.0) + noise(rng);
+      img.at<uint16_t>(y, x) = static_cast<uint16_t>(std::max(0.0, std::min(65535.0, val)));
+    }
+  }
+  return img;
+}
+
+// Background sample: Gaussian noise, optionally with a star's wing and a few
+// hot pixels mixed in (what sigma clipping exists to remove)
+inline std::vector<uint16_t> makeBackgroundSample(uint32_t seed, size_t count, double noise, bool contaminated) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gauss(1000.0, noise);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<uint16_t> values(count);
+  for (size_t i = 0; i < count; ++i) {
+    double v = gauss(rng);
+    if (contaminated) {
+      const double u = uniform(rng);
+      if (u < 0.002) {
+        v = 65535.0;                        // Hot / saturated pixel
+      } else if (u < 0.05) {
+        v += 30000.0 * uniform(rng);        // Neighbouring star
+      }
+    }
+    values[i] = static_cast<uint16_t>(std::max(0.0, std::min(65535.0, std::round(v))));
+  }
+  return values;
+}
+
+// Moffat (beta 2) star on a noisy background from integer arithmetic only, so
+// the stamp itself is the same with every compiler and standard library:
+// mt19937's output is fixed by the standard, its distributions are not
+inline cv::Mat makeIntegerStamp(uint32_t seed) {
+  std::mt19937 rng(seed);
+  const int64_t cx = 25 * 16 + static_cast<int64_t>(rng() % 16) - 8;  // 1/16 px
+  const int64_t cy = 25 * 16 + static_cast<int64_t>(rng() % 16) - 8;
+  const int64_t width = 2 + static_cast<int64_t>(rng() % 7);           // Moffat alpha (pixels)
+  const int64_t peak = 500 + static_cast<int64_t>(rng() % 40000);
+  const int64_t width2 = width * width * 256;
+
+  cv::Mat stamp(50, 50, CV_16UC1);
+  for (int y = 0; y < stamp.rows; ++y) {
+    for (int x = 0; x < stamp.cols; ++x) {
+      const int64_t dx = x * 16 + 8 - cx;
+      const int64_t dy = y * 16 + 8 - cy;
+      const int64_t t = width2 * 256 / (width2 + dx * dx + dy * dy);  // 256 at the center
+      int64_t noise = -40;                                             // Sum of 4 uniform, sigma ~12 ADU
+      for (int k = 0; k < 4; ++k) noise += static_cast<int64_t>(rng() % 21);
+      const int64_t value = 1000 + (peak * t * t >> 16) + noise;
+      stamp.at<uint16_t>(y, x) = static_cast<uint16_t>(std::min<int64_t>(65535, std::max<int64_t>(0, value)));
+    }
+  }
+  return stamp;
+}
+
+// Noisy Gaussian star at a random sub-pixel position near the stamp center
+inline cv::Mat makeNoisyStar(double sigma, double peak, std::mt19937& rng) {
+  std::uniform_real_distribution<double> offset(-0.5, 0.5);
+  std::normal_distribution<double> noise(0.0, 10.0);
+  const double cx = 25.0 + offset(rng);
+  const double cy = 25.0 + offset(rng);
+  cv::Mat img(50, 50, CV_16UC1);
+  for (int y = 0; y < img.rows; y++) {
+    for (int x = 0; x < img.cols; x++) {
+      const double dx = (x + 0.5) - cx;
+      const double dy = (y + 0.5) - cy;
+      const double val = 1000.0 + peak * std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma)) + noise(rng);
+      img.at<uint16_t>(y, x) = static_cast<uint16_t>(std::max(0.0, std::min(65535.0, val)));
+    }
+  }
+  return img;
+}
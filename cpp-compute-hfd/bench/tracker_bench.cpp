@@ -0,0 +1,144 @@
+// Steady-state tracking vs full detection on a drifting frame sequence
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "star_tracker.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr int    kSequenceFrames = 4;                 // Frames rendered per sequence, replayed in a loop
+constexpr double kCentroidTolerance = 0.1;            // Tracked vs freshly detected centroid (pixels)
+constexpr double kMedianHFDTolerance = 0.01;          // Tracked vs freshly detected median HFD (relative)
+
+// Star positions walk a one-pixel square, so replaying the sequence never
+// jumps and the motion changes direction every frame
+const cv::Point2f kSequenceOffsets[kSequenceFrames] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+
+const std::vector<StarField>& cachedSequence(int starCount) {
+  static std::map<int, std::vector<StarField>> sequences;
+  auto it = sequences.find(starCount);
+  if (it == sequences.end()) {
+    std::vector<StarField> frames;
+    for (const cv::Point2f& offset : kSequenceOffsets) {
+      StarFieldConfig config;
+      config.starCount = starCount;
+      config.offset = offset;
+      frames.push_back(makeStarField(config));
+    }
+    it = sequences.emplace(starCount, std::move(frames)).first;
+  }
+  return it->second;
+}
+
+// Empty string if tracking runs detection once, finds every star in every
+// frame with the same centroids and median HFD as full detection, and falls
+// back to detection after an unannounced jump
+std::string verifyTracker(int starCount) {
+  const std::vector<StarField>& sequence = cachedSequence(starCount);
+  HFDEngine engine(HFDEngineConfig(), 1);
+  HFDEngine reference(HFDEngineConfig(), 1);
+  StarTracker tracker(engine);
+
+  size_t detected = 0;
+  for (int i = 0; i < 3 * kSequenceFrames; ++i) {
+    const cv::Mat& frame = sequence[i % kSequenceFrames].image;
+    const TrackedFrame tracked = tracker.track(frame);
+    if (tracked.redetected != (i == 0)) {
+      return "unexpected detection at frame " + std::to_string(i);
+    }
+    if (i == 0) {
+      detected = tracker.tracks().size();
+      continue;
+    }
+    if (tracked.reacquired != detected) {
+      return "lost stars at frame " + std::to_string(i);
+    }
+
+    const FrameHFDResult fresh = reference.measureFrame(frame);
+    for (const StarMeasurement& star : tracked.result.stars) {
+      double nearest = 1e9;
+      for (const StarMeasurement& other : fresh.stars) {
+        const cv::Point2f d = star.centroid - other.centroid;
+        nearest = std::min(nearest, std::hypot(static_cast<double>(d.x), static_cast<double>(d.y)));
+      }
+      if (nearest > kCentroidTolerance) {
+        return "centroid mismatch at frame " + std::to_string(i);
+      }
+    }
+    if (std::abs(tracked.result.medianHFD - fresh.medianHFD) > kMedianHFDTolerance * fresh.medianHFD) {
+      return "median HFD mismatch at frame " + std::to_string(i);
+    }
+  }
+
+  StarFieldConfig jumped;
+  jumped.starCount = starCount;
+  jumped.offset = cv::Point2f(20.0f, -15.0f);
+  const TrackedFrame recovered = tracker.track(makeStarField(jumped).image);
+  if (!recovered.redetected || recovered.result.measuredStars < detected * 9 / 10) {  // Some stars left the frame
+    return "no recovery after a jump";
+  }
+  return "";
+}
+
+// Full detection and measurement of every frame
+void BM_SequenceMeasureFrame(benchmark::State& state) {
+  const std::vector<StarField>& sequence = cachedSequence(static_cast<int>(state.range(0)));
+  HFDEngine engine(HFDEngineConfig(), 1);
+
+  size_t frame = 0;
+  for (auto _ : state) {
+    FrameHFDResult result = engine.measureFrame(sequence[frame++ % kSequenceFrames].image);
+    benchmark::DoNotOptimize(result.medianHFD);
+  }
+  state.counters["frames_per_second"] = benchmark::Counter(
+      static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+// Tracked frames after the first detection; state.range(1) passes the true
+// frame-to-frame offset as a mount offset
+void BM_SequenceTrack(benchmark::State& state) {
+  const int starCount = static_cast<int>(state.range(0));
+  static std::map<int, std::string> errors;
+  if (!errors.count(starCount)) errors[starCount] = verifyTracker(starCount);
+  if (!errors[starCount].empty()) {
+    state.SkipWithError(errors[starCount].c_str());
+    return;
+  }
+
+  const std::vector<StarField>& sequence = cachedSequence(starCount);
+  const bool mountOffsets = state.range(1) != 0;
+  HFDEngine engine(HFDEngineConfig(), 1);
+  StarTracker tracker(engine);
+  tracker.track(sequence[0].image);
+
+  size_t frame = 1;
+  size_t detections = 0;
+  for (auto _ : state) {
+    const size_t index = frame % kSequenceFrames;
+    const cv::Point2f offset = kSequenceOffsets[index] - kSequenceOffsets[(frame - 1) % kSequenceFrames];
+    const TrackedFrame tracked = mountOffsets ? tracker.track(sequence[index].image, offset)
+                                              : tracker.track(sequence[index].image);
+    detections += tracked.redetected;
+    benchmark::DoNotOptimize(tracked.result.medianHFD);
+    frame++;
+  }
+  state.counters["detections"] = static_cast<double>(detections);
+  state.counters["frames_per_second"] = benchmark::Counter(
+      static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+BENCHMARK(BM_SequenceMeasureFrame)->ArgName("stars")->Arg(100)->Arg(1000)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SequenceTrack)
+    ->ArgsProduct({{100, 1000}, {0, 1}})
+    ->ArgNames({"stars", "mount_offsets"})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,299 @@
+// Offline HFD over many FITS images and cubes
+// Every plane of every file is one frame. Frames are spread over a
+// WorkStealingPool, each worker measuring with its own single-threaded
+// HFDEngine, so a directory of frames scales with cores without contending
+// inside one frame. While a worker measures a frame the kernel is already
+// reading the next frame of its queue (madvise read-ahead).
+// Results are written as one columnar file (writeStarColumns).
+// Requires: OpenCV, C++17 standard library, POSIX (mmap)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "fits_mmap.hpp"
+#include "hfd_engine.hpp"
+#include "star_table.hpp"
+#include "thread_pool.hpp"
+
+// Columnar result file
+constexpr char     kStarColumnsMagic[8] = {'H', 'F', 'D', 'C', 'O', 'L', 'S', '1'};
+constexpr uint32_t kStarColumnsVersion = 1;
+
+struct FitsBatchConfig {
+  HFDEngineConfig engine;
+  unsigned threads = 0;          // Workers, 0 = hardware concurrency
+};
+
+struct FitsFrameResult {
+  uint32_t file;                 // Index into FitsBatchResult::files
+  uint32_t plane;                // Cube plane, 0 for 2-D images
+  uint64_t firstStar;            // First row of the frame's stars in FitsBatchResult::stars
+  uint32_t starCount;
+  uint32_t measuredStars;        // Stars with an HFD
+  float medianHFD;
+};
+
+struct FitsBatchResult {
+  std::vector<std::string> files;        // Files that could be mapped, in input order
+  std::vector<std::string> errors;       // Files skipped, with the reason
+  std::vector<FitsFrameResult> frames;   // File order, then plane order
+  StarTable stars;                       // All frames' stars; levels and peaks in physical ADU
+  std::vector<uint32_t> starFrame;       // Frame index of each star row
+};
+
+namespace fits_batch_detail {
+
+struct FrameRef {
+  uint32_t file;
+  uint32_t plane;
+};
+
+// File data is little-endian; a big-endian host swaps a copy of each column
+template <typename T>
+void writeColumn(std::FILE* out, const T* values, size_t count) {
+  if (!fits_detail::hostIsBigEndian()) {
+    std::fwrite(values, sizeof(T), count, out);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &values[i], sizeof(T));
+    std::reverse(bytes, bytes + sizeof(T));
+    std::fwrite(bytes, 1, sizeof(T), out);
+  }
+}
+
+template <typename T>
+bool readColumn(std::FILE* in, T* values, size_t count) {
+  if (std::fread(values, sizeof(T), count, in) != count) return false;
+  if (fits_detail::hostIsBigEndian()) {
+    for (size_t i = 0; i < count; ++i) {
+      uint8_t* bytes = reinterpret_cast<uint8_t*>(&values[i]);
+      std::reverse(bytes, bytes + sizeof(T));
+    }
+  }
+  return true;
+}
+
+template <typename T, typename Field>
+void writeFrameColumn(std::FILE* out, const std::vector<FitsFrameResult>& frames, Field field) {
+  std::vector<T> column(frames.size());
+  for (size_t i = 0; i < frames.size(); ++i) column[i] = frames[i].*field;
+  writeColumn(out, column.data(), column.size());
+}
+
+template <typename T, typename Field>
+bool readFrameColumn(std::FILE* in, std::vector<FitsFrameResult>& frames, Field field) {
+  std::vector<T> column(frames.size());
+  if (!readColumn(in, column.data(), column.size())) return false;
+  for (size_t i = 0; i < frames.size(); ++i) frames[i].*field = column[i];
+  return true;
+}
+
+}  // namespace fits_batch_detail
+
+// Measure every frame of `paths`. Unreadable or unsupported files are listed in
+// errors and skipped; the results do not depend on the thread count.
+inline FitsBatchResult measureFitsFiles(const std::vector<std::string>& paths,
+                                        const FitsBatchConfig& config = FitsBatchConfig()) {
+  using namespace fits_batch_detail;
+  WorkStealingPool pool(config.threads);
+  const unsigned workers = pool.threadCount();
+
+  // Map every file and read its header, in parallel: on a cold cache this is
+  // one random read per file
+  std::vector<std::unique_ptr<MappedFits>> mapped(paths.size());
+  std::vector<std::string> mapErrors(paths.size());
+  pool.parallelFor(paths.size(), 8, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; ++i) {
+      try {
+        mapped[i] = std::make_unique<MappedFits>(paths[i]);
+      } catch (const cv::Exception& e) {
+        mapErrors[i] = e.what();
+      }
+    }
+  });
+
+  FitsBatchResult result;
+  std::vector<std::unique_ptr<MappedFits>> files;
+  std::vector<double> levelOffsets;
+  std::vector<FrameRef> frames;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!mapped[i]) {
+      result.errors.push_back(mapErrors[i]);
+      continue;
+    }
+    const uint32_t file = static_cast<uint32_t>(files.size());
+    for (int plane = 0; plane < mapped[i]->planes(); ++plane) {
+      frames.push_back(FrameRef{file, static_cast<uint32_t>(plane)});
+    }
+    result.files.push_back(paths[i]);
+    levelOffsets.push_back(mapped[i]->levelOffset());
+    files.push_back(std::move(mapped[i]));
+  }
+
+  // A file's pages are unmapped once its last plane is decoded, so a long run
+  // keeps only the files in flight resident
+  std::vector<std::atomic<int>> remainingPlanes(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    remainingPlanes[i].store(files[i]->planes());
+  }
+
+  std::vector<std::unique_ptr<HFDEngine>> engines;
+  for (unsigned i = 0; i < workers; ++i) {
+    engines.push_back(std::make_unique<HFDEngine>(config.engine, 1));
+  }
+  std::vector<cv::Mat> planeBuffers(workers);   // Decoded frame, reused by each worker
+  std::vector<FrameHFDResult> measured(frames.size());
+
+  // Chunks of one frame are dealt round-robin, so a worker's next frame is
+  // usually `workers` frames on
+  pool.parallelFor(frames.size(), 1, [&](size_t begin, size_t end, unsigned worker) {
+    for (size_t i = begin; i < end; ++i) {
+      if (i + workers < frames.size()) {
+        const FrameRef next = frames[i + workers];
+        files[next.file]->prefetch(static_cast<int>(next.plane));
+      }
+      const FrameRef frame = frames[i];
+      const cv::Mat& pixels = files[frame.file]->plane(static_cast<int>(frame.plane), planeBuffers[worker]);
+      if (remainingPlanes[frame.file].fetch_sub(1) == 1) {
+        files[frame.file]->release();
+      }
+      measured[i] = engines[worker]->measureFrame(pixels);
+    }
+  });
+
+  // Concatenate in frame order; decoded levels are shifted back to physical ADU
+  size_t starCount = 0;
+  for (const FrameHFDResult& frame : measured) starCount += frame.stars.size();
+  result.stars.resize(starCount);
+  result.starFrame.resize(starCount);
+  result.frames.reserve(frames.size());
+  size_t row = 0;
+  StarTable& t = result.stars;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    const FrameHFDResult& frame = measured[i];
+    const double offset = levelOffsets[frames[i].file];
+    result.frames.push_back(FitsFrameResult{frames[i].file, frames[i].plane, row,
+                                            static_cast<uint32_t>(frame.stars.size()),
+                                            static_cast<uint32_t>(frame.measuredStars), frame.medianHFD});
+    for (const StarMeasurement& star : frame.stars) {
+      t.x[row] = star.centroid.x;
+      t.y[row] = star.centroid.y;
+      t.backgroundLevel[row] = static_cast<float>(star.background.level + offset);
+      t.backgroundStdDev[row] = static_cast<float>(star.background.stddev);
+      t.hfd[row] = star.hfd;
+      t.flux[row] = star.flux;
+      t.peak[row] = static_cast<float>(star.peakValue + offset);
+      t.flags[row] = star.flags;
+      t.fwhm[row] = star.shape.fwhm;
+      t.ellipticity[row] = star.shape.ellipticity;
+      t.positionAngle[row] = star.shape.positionAngle;
+      result.starFrame[row] = static_cast<uint32_t>(i);
+      row++;
+    }
+  }
+  return result;
+}
+
+// Columnar result file, all little-endian:
+//   magic "HFDCOLS1", uint32 version, uint32 files, uint32 frames, uint32 0, uint64 stars
+//   per file: uint32 length, path bytes
+//   frame columns: file u32, plane u32, firstStar u64, starCount u32, measuredStars u32, medianHFD f32
+//   star columns: frame u32, x, y, backgroundLevel, backgroundStdDev, hfd, flux, peak f32, flags u32,
+//                 fwhm, ellipticity, positionAngle f32
+// Each column is contiguous, so a reader loads only the columns it needs.
+inline bool writeStarColumns(const std::string& path, const FitsBatchResult& result) {
+  using namespace fits_batch_detail;
+  std::FILE* out = std::fopen(path.c_str(), "wb");
+  if (!out) return false;
+
+  const uint32_t counts[4] = {kStarColumnsVersion, static_cast<uint32_t>(result.files.size()),
+                              static_cast<uint32_t>(result.frames.size()), 0};
+  const uint64_t stars = result.stars.size();
+  std::fwrite(kStarColumnsMagic, 1, sizeof(kStarColumnsMagic), out);
+  writeColumn(out, counts, 4);
+  writeColumn(out, &stars, 1);
+  for (const std::string& file : result.files) {
+    const uint32_t length = static_cast<uint32_t>(file.size());
+    writeColumn(out, &length, 1);
+    std::fwrite(file.data(), 1, file.size(), out);
+  }
+
+  writeFrameColumn<uint32_t>(out, result.frames, &FitsFrameResult::file);
+  writeFrameColumn<uint32_t>(out, result.frames, &FitsFrameResult::plane);
+  writeFrameColumn<uint64_t>(out, result.frames, &FitsFrameResult::firstStar);
+  writeFrameColumn<uint32_t>(out, result.frames, &FitsFrameResult::starCount);
+  writeFrameColumn<uint32_t>(out, result.frames, &FitsFrameResult::measuredStars);
+  writeFrameColumn<float>(out, result.frames, &FitsFrameResult::medianHFD);
+
+  const StarTable& t = result.stars;
+  writeColumn(out, result.starFrame.data(), stars);
+  for (const std::vector<float>* column : {&t.x, &t.y, &t.backgroundLevel, &t.backgroundStdDev, &t.hfd, &t.flux,
+                                           &t.peak}) {
+    writeColumn(out, column->data(), stars);
+  }
+  writeColumn(out, t.flags.data(), stars);
+  for (const std::vector<float>* column : {&t.fwhm, &t.ellipticity, &t.positionAngle}) {
+    writeColumn(out, column->data(), stars);
+  }
+  const bool written = !std::ferror(out);
+  return std::fclose(out) == 0 && written;
+}
+
+// Read a writeStarColumns file back; errors stays empty
+inline bool readStarColumns(const std::string& path, FitsBatchResult& result) {
+  using namespace fits_batch_detail;
+  std::FILE* in = std::fopen(path.c_str(), "rb");
+  if (!in) return false;
+  std::unique_ptr<std::FILE, int (*)(std::FILE*)> closer(in, std::fclose);
+
+  char magic[sizeof(kStarColumnsMagic)];
+  uint32_t counts[4];
+  uint64_t stars = 0;
+  if (std::fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+      std::memcmp(magic, kStarColumnsMagic, sizeof(magic)) != 0 || !readColumn(in, counts, 4) ||
+      counts[0] != kStarColumnsVersion || !readColumn(in, &stars, 1)) {
+    return false;
+  }
+  result = FitsBatchResult();
+  result.files.resize(counts[1]);
+  for (std::string& file : result.files) {
+    uint32_t length = 0;
+    if (!readColumn(in, &length, 1)) return false;
+    file.resize(length);
+    if (std::fread(&file[0], 1, length, in) != length) return false;
+  }
+
+  result.frames.resize(counts[2]);
+  if (!readFrameColumn<uint32_t>(in, result.frames, &FitsFrameResult::file) ||
+      !readFrameColumn<uint32_t>(in, result.frames, &FitsFrameResult::plane) ||
+      !readFrameColumn<uint64_t>(in, result.frames, &FitsFrameResult::firstStar) ||
+      !readFrameColumn<uint32_t>(in, result.frames, &FitsFrameResult::starCount) ||
+      !readFrameColumn<uint32_t>(in, result.frames, &FitsFrameResult::measuredStars) ||
+      !readFrameColumn<float>(in, result.frames, &FitsFrameResult::medianHFD)) {
+    return false;
+  }
+
+  StarTable& t = result.stars;
+  t.resize(stars);
+  result.starFrame.resize(stars);
+  bool ok = readColumn(in, result.starFrame.data(), stars);
+  for (std::vector<float>* column : {&t.x, &t.y, &t.backgroundLevel, &t.backgroundStdDev, &t.hfd, &t.flux, &t.peak}) {
+    ok = ok && readColumn(in, column->data(), stars);
+  }
+  ok = ok && readColumn(in, t.flags.data(), stars);
+  for (std::vector<float>* column : {&t.fwhm, &t.ellipticity, &t.positionAngle}) {
+    ok = ok && readColumn(in, column->data(), stars);
+  }
+  return ok;
+}
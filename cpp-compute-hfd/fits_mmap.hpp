@@ -0,0 +1,214 @@
+// Memory-mapped FITS images and cubes
+// The primary HDU of an uncompressed FITS file is mapped read-only. FITS data
+// is big-endian; a 16-bit plane is decoded (byte swap plus BZERO) straight from
+// the page cache into a caller-owned cv::Mat, which a worker reuses from frame
+// to frame. The mapping is never written, so no page is copied on write and
+// the file is read without an intermediate read() buffer.
+// Requires: OpenCV, C++17 standard library, POSIX (mmap)
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// FITS layout
+constexpr size_t kFitsBlockSize = 2880;               // Header and data are padded to whole blocks
+constexpr size_t kFitsCardSize = 80;                  // One header keyword record
+constexpr double kFitsUnsignedZero = 32768.0;         // BZERO of unsigned 16-bit data
+
+struct FitsHeader {
+  int bitpix = 0;                // 8, 16, 32, -32 or -64
+  int width = 0;                 // NAXIS1
+  int height = 0;                // NAXIS2
+  int planes = 0;                // NAXIS3, 1 for a 2-D image
+  double bzero = 0.0;
+  double bscale = 1.0;
+  size_t dataOffset = 0;         // First data byte, after the header blocks
+};
+
+namespace fits_detail {
+
+inline bool hostIsBigEndian() {
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+  return __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+#else
+  const uint16_t probe = 1;
+  return *reinterpret_cast<const uint8_t*>(&probe) == 0;
+#endif
+}
+
+// Keyword of a card, trailing blanks removed
+inline std::string cardKeyword(const char* card) {
+  size_t length = 8;
+  while (length > 0 && card[length - 1] == ' ') --length;
+  return std::string(card, length);
+}
+
+// Numeric value of a "KEYWORD = value / comment" card; false without one
+inline bool cardNumber(const char* card, double& value) {
+  if (card[8] != '=') return false;
+  char text[kFitsCardSize - 9];
+  std::memcpy(text, card + 10, sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  char* end = nullptr;
+  value = std::strtod(text, &end);
+  return end != text;
+}
+
+}  // namespace fits_detail
+
+// Parse the primary header of `size` bytes at `data`. Throws cv::Exception for
+// anything but a plain 2-D image or 3-D cube in the primary HDU.
+inline FitsHeader parseFitsHeader(const uint8_t* data, size_t size, const std::string& name = "FITS file") {
+  using namespace fits_detail;
+  FitsHeader header;
+  int naxis = -1;
+  int axes[3] = {0, 0, 1};
+  bool simple = false;
+  bool ended = false;
+
+  for (size_t offset = 0; offset + kFitsCardSize <= size; offset += kFitsCardSize) {
+    const char* card = reinterpret_cast<const char*>(data + offset);
+    const std::string keyword = cardKeyword(card);
+    double value = 0.0;
+    if (offset == 0) {
+      simple = keyword == "SIMPLE";
+    } else if (keyword == "END") {
+      header.dataOffset = (offset / kFitsBlockSize + 1) * kFitsBlockSize;
+      ended = true;
+      break;
+    } else if (keyword == "BITPIX" && cardNumber(card, value)) {
+      header.bitpix = static_cast<int>(value);
+    } else if (keyword == "NAXIS" && cardNumber(card, value)) {
+      naxis = static_cast<int>(value);
+    } else if (keyword.size() == 6 && keyword.compare(0, 5, "NAXIS") == 0 && keyword[5] >= '1' &&
+               keyword[5] <= '3' && cardNumber(card, value)) {
+      axes[keyword[5] - '1'] = static_cast<int>(value);
+    } else if (keyword == "BZERO" && cardNumber(card, value)) {
+      header.bzero = value;
+    } else if (keyword == "BSCALE" && cardNumber(card, value)) {
+      header.bscale = value;
+    }
+  }
+
+  if (!simple || !ended) {
+    CV_Error(cv::Error::StsUnsupportedFormat, name + ": not a FITS file");
+  }
+  if (naxis != 2 && naxis != 3) {
+    CV_Error(cv::Error::StsUnsupportedFormat, name + ": primary HDU is not a 2-D image or 3-D cube");
+  }
+  header.width = axes[0];
+  header.height = axes[1];
+  header.planes = naxis == 3 ? axes[2] : 1;
+  const size_t planeBytes = static_cast<size_t>(header.width) * header.height * (std::abs(header.bitpix) / 8);
+  if (header.width <= 0 || header.height <= 0 || header.planes <= 0 || planeBytes == 0 ||
+      header.dataOffset + planeBytes * header.planes > size) {
+    CV_Error(cv::Error::StsUnsupportedFormat, name + ": truncated or empty data");
+  }
+  return header;
+}
+
+// A FITS file mapped read-only. Planes are decoded to host order into buffers
+// of the caller.
+class MappedFits {
+ public:
+  explicit MappedFits(const std::string& path) : path_(path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      CV_Error(cv::Error::StsError, path + ": cannot open");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+      ::close(fd);
+      CV_Error(cv::Error::StsError, path + ": cannot stat or empty");
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // The mapping keeps the file referenced
+    if (mapping == MAP_FAILED) {
+      CV_Error(cv::Error::StsError, path + ": mmap failed");
+    }
+    data_ = static_cast<uint8_t*>(mapping);
+
+    try {
+      header_ = parseFitsHeader(data_, size_, path);
+      if (header_.bitpix != 16 || header_.bscale != 1.0 ||
+          (header_.bzero != 0.0 && header_.bzero != kFitsUnsignedZero)) {
+        CV_Error(cv::Error::StsUnsupportedFormat, path + ": only 16-bit data with BSCALE 1 and BZERO 0 or 32768");
+      }
+    } catch (...) {
+      ::munmap(data_, size_);
+      throw;
+    }
+  }
+
+  ~MappedFits() { ::munmap(data_, size_); }
+
+  MappedFits(const MappedFits&) = delete;
+  MappedFits& operator=(const MappedFits&) = delete;
+
+  const std::string& path() const { return path_; }
+  const FitsHeader& header() const { return header_; }
+  int planes() const { return header_.planes; }
+
+  // Offset to add to decoded pixels for physical ADU: signed data (BZERO 0) is
+  // shifted by 32768 to fit CV_16U, which the HFD kernels and detection take
+  double levelOffset() const { return header_.bzero == kFitsUnsignedZero ? 0.0 : -kFitsUnsignedZero; }
+
+  // Ask the kernel to start reading a plane (read-ahead for the next frame)
+  void prefetch(int plane) const {
+    const long page = ::sysconf(_SC_PAGESIZE);
+    const size_t begin = planeOffset(plane) / page * page;
+    ::madvise(data_ + begin, planeOffset(plane) + planeBytes() - begin, MADV_WILLNEED);
+  }
+
+  // Unmap the file's pages from this process. They are clean page-cache pages,
+  // so nothing is written back; the mapping stays valid and rereads them.
+  void release() const { ::madvise(data_, size_, MADV_DONTNEED); }
+
+  // Plane decoded to host order into `buffer` (CV_16UC1, reallocated only if
+  // its size differs), which is returned. Safe to call from several threads
+  // with different buffers.
+  const cv::Mat& plane(int plane, cv::Mat& buffer) const {
+    buffer.create(header_.height, header_.width, CV_16UC1);
+    const uint16_t* pixels = reinterpret_cast<const uint16_t*>(data_ + planeOffset(plane));
+    for (int y = 0; y < header_.height; ++y) {
+      decode(pixels + static_cast<size_t>(y) * header_.width, buffer.ptr<uint16_t>(y), header_.width);
+    }
+    return buffer;
+  }
+
+ private:
+  size_t planeBytes() const { return static_cast<size_t>(header_.width) * header_.height * sizeof(uint16_t); }
+  size_t planeOffset(int plane) const { return header_.dataOffset + planeBytes() * static_cast<size_t>(plane); }
+
+  // Big-endian two's complement to host order; BZERO 32768 (unsigned data) is
+  // applied by flipping the sign bit, and signed data gets the same flip so it
+  // lands in CV_16U 32768 ADU up. Plain loops that compilers vectorize.
+  static void decode(const uint16_t* src, uint16_t* dst, size_t count) {
+    if (fits_detail::hostIsBigEndian()) {
+      for (size_t i = 0; i < count; ++i) dst[i] = src[i] ^ 0x8000;
+    } else {
+      for (size_t i = 0; i < count; ++i) {
+        const uint16_t v = src[i];
+        dst[i] = static_cast<uint16_t>(((v >> 8) | (v << 8)) ^ 0x8000);
+      }
+    }
+  }
+
+  std::string path_;
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  FitsHeader header_;
+};
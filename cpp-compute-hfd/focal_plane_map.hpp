@@ -0,0 +1,245 @@
+// Focal-plane quality map: median HFD and ellipticity per region of the frame
+// Stars are binned into an N x M grid by their centroid. Each pool worker
+// fills its own partial (no locks, no shared writes), the partials are merged
+// by a counting sort on the cell, and per-cell medians come from
+// std::nth_element. Corner-versus-center deltas estimate sensor tilt and field
+// curvature.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "hfd_engine.hpp"
+#include "star_table.hpp"
+#include "thread_pool.hpp"
+
+// Focal-plane map parameters
+constexpr int    kFocalPlaneGridCols = 3;             // Default grid: corners, edges and center
+constexpr int    kFocalPlaneGridRows = 3;
+constexpr size_t kFocalPlaneStarsPerTask = 512;       // Stars binned per pool task
+
+struct FocalPlaneConfig {
+  int cols = kFocalPlaneGridCols;
+  int rows = kFocalPlaneGridRows;
+};
+
+struct FocalPlaneCell {
+  cv::Rect region;               // Frame pixels covered by the cell
+  size_t stars = 0;              // Stars with an HFD
+  float medianHFD = 0.0f;        // 0 if the cell has no stars
+  size_t shapedStars = 0;        // Stars with a PSF shape (HFDEngineConfig::psfShape)
+  float medianEllipticity = 0.0f;
+};
+
+// Corners are ordered top-left, top-right, bottom-left, bottom-right. Deltas are
+// corner minus center median HFD (pixels), 0 where either cell is empty.
+struct FocalPlaneMap {
+  int cols = 0;
+  int rows = 0;
+  std::vector<FocalPlaneCell> cells;   // Row-major
+  float centerHFD = 0.0f;              // Median over the cells covering the frame center
+  float cornerHFD[4] = {};
+  float cornerDelta[4] = {};
+  float tiltX = 0.0f;                  // Right corners minus left corners (mean HFD)
+  float tiltY = 0.0f;                  // Bottom corners minus top corners
+  float curvature = 0.0f;              // Mean corner minus center: > 0 when the center is sharpest
+
+  const FocalPlaneCell& cell(int col, int row) const { return cells[static_cast<size_t>(row) * cols + col]; }
+};
+
+namespace focal_plane_detail {
+
+struct CellSample {
+  uint32_t cell;
+  float hfd;
+  float ellipticity;             // < 0 without a PSF shape
+};
+
+// One worker's share of the stars, cleared but not freed between frames
+struct Partial {
+  std::vector<CellSample> samples;
+  std::vector<uint32_t> counts;  // Samples per cell
+};
+
+// Median of values[0, count), reordering them
+inline float medianInPlace(float* values, size_t count) {
+  if (count == 0) return 0.0f;
+  float* middle = values + count / 2;
+  std::nth_element(values, middle, values + count);
+  if (count % 2 == 1) return *middle;
+  const float upper = *middle;
+  const float lower = *std::max_element(values, middle);
+  return static_cast<float>((static_cast<double>(lower) + upper) / 2.0);  // As computeMedian
+}
+
+}  // namespace focal_plane_detail
+
+class FocalPlaneMapper {
+ public:
+  explicit FocalPlaneMapper(WorkStealingPool& pool, FocalPlaneConfig config = FocalPlaneConfig())
+      : pool_(pool), config_(config), partials_(pool.threadCount()) {}
+
+  // Map of a frame measured by HFDEngine::measureFrame / measureStamps
+  const FocalPlaneMap& build(const FrameHFDResult& result, const cv::Size& frameSize) {
+    const std::vector<StarMeasurement>& stars = result.stars;
+    return build(stars.size(), frameSize, [&](size_t i, float& x, float& y, float& hfd, float& ellipticity) {
+      const StarMeasurement& star = stars[i];
+      x = star.centroid.x;
+      y = star.centroid.y;
+      hfd = star.hfd;
+      ellipticity = star.shape.fwhm > 0.0f ? star.shape.ellipticity : -1.0f;
+    });
+  }
+
+  // Same from the batch columns
+  const FocalPlaneMap& build(const StarTable& table, const cv::Size& frameSize) {
+    return build(table.size(), frameSize, [&](size_t i, float& x, float& y, float& hfd, float& ellipticity) {
+      x = table.x[i];
+      y = table.y[i];
+      hfd = table.hfd[i];
+      ellipticity = table.fwhm[i] > 0.0f ? table.ellipticity[i] : -1.0f;
+    });
+  }
+
+  const FocalPlaneMap& map() const { return map_; }
+
+ private:
+  template <typename StarAt>
+  const FocalPlaneMap& build(size_t starCount, const cv::Size& frameSize, StarAt&& starAt) {
+    using namespace focal_plane_detail;
+    const int cols = std::max(1, config_.cols);
+    const int rows = std::max(1, config_.rows);
+    const size_t cellCount = static_cast<size_t>(cols) * rows;
+    resetMap(cols, rows, frameSize);
+
+    // Map: every worker bins its chunks into its own partial
+    for (Partial& partial : partials_) {
+      partial.samples.clear();
+      partial.counts.assign(cellCount, 0);
+    }
+    const double cellsPerPixelX = static_cast<double>(cols) / std::max(1, frameSize.width);
+    const double cellsPerPixelY = static_cast<double>(rows) / std::max(1, frameSize.height);
+    pool_.parallelFor(starCount, kFocalPlaneStarsPerTask, [&](size_t begin, size_t end, unsigned worker) {
+      Partial& partial = partials_[worker];
+      for (size_t i = begin; i < end; ++i) {
+        float x, y, hfd, ellipticity;
+        starAt(i, x, y, hfd, ellipticity);
+        if (!(hfd > 0.0f)) continue;
+        const int col = std::min(cols - 1, std::max(0, static_cast<int>(x * cellsPerPixelX)));
+        const int row = std::min(rows - 1, std::max(0, static_cast<int>(y * cellsPerPixelY)));
+        const uint32_t cell = static_cast<uint32_t>(row * cols + col);
+        partial.samples.push_back(CellSample{cell, hfd, ellipticity});
+        partial.counts[cell]++;
+      }
+    });
+
+    // Reduce: counting sort of all partials by cell, then per-cell medians
+    offsets_.assign(cellCount + 1, 0);
+    for (const Partial& partial : partials_) {
+      for (size_t cell = 0; cell < cellCount; ++cell) {
+        offsets_[cell + 1] += partial.counts[cell];
+      }
+    }
+    for (size_t cell = 0; cell < cellCount; ++cell) {
+      offsets_[cell + 1] += offsets_[cell];
+    }
+    hfds_.resize(offsets_[cellCount]);
+    ellipticities_.resize(offsets_[cellCount]);
+    cursor_.assign(offsets_.begin(), offsets_.end() - 1);
+    shapedEnd_.assign(offsets_.begin(), offsets_.end() - 1);
+    for (const Partial& partial : partials_) {
+      for (const CellSample& sample : partial.samples) {
+        hfds_[cursor_[sample.cell]++] = sample.hfd;
+        if (sample.ellipticity >= 0.0f) {
+          ellipticities_[shapedEnd_[sample.cell]++] = sample.ellipticity;
+        }
+      }
+    }
+
+    for (size_t cell = 0; cell < cellCount; ++cell) {
+      FocalPlaneCell& out = map_.cells[cell];
+      out.stars = offsets_[cell + 1] - offsets_[cell];
+      out.medianHFD = medianInPlace(hfds_.data() + offsets_[cell], out.stars);
+      out.shapedStars = shapedEnd_[cell] - offsets_[cell];
+      out.medianEllipticity = medianInPlace(ellipticities_.data() + offsets_[cell], out.shapedStars);
+    }
+
+    summarize();
+    return map_;
+  }
+
+  void resetMap(int cols, int rows, const cv::Size& frameSize) {
+    // Fields reset in place: the cells keep their capacity across frames
+    map_.cols = cols;
+    map_.rows = rows;
+    map_.cells.assign(static_cast<size_t>(cols) * rows, FocalPlaneCell{});
+    map_.centerHFD = 0.0f;
+    std::fill(std::begin(map_.cornerHFD), std::end(map_.cornerHFD), 0.0f);
+    std::fill(std::begin(map_.cornerDelta), std::end(map_.cornerDelta), 0.0f);
+    map_.tiltX = 0.0f;
+    map_.tiltY = 0.0f;
+    map_.curvature = 0.0f;
+    for (int row = 0; row < rows; ++row) {
+      for (int col = 0; col < cols; ++col) {
+        const int x0 = static_cast<int>(static_cast<int64_t>(frameSize.width) * col / cols);
+        const int x1 = static_cast<int>(static_cast<int64_t>(frameSize.width) * (col + 1) / cols);
+        const int y0 = static_cast<int>(static_cast<int64_t>(frameSize.height) * row / rows);
+        const int y1 = static_cast<int>(static_cast<int64_t>(frameSize.height) * (row + 1) / rows);
+        map_.cells[static_cast<size_t>(row) * cols + col].region = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+      }
+    }
+  }
+
+  // Center: the one central cell, or the star-weighted mean of the two or four
+  // central cells of an even grid
+  void summarize() {
+    const int cols = map_.cols;
+    const int rows = map_.rows;
+    double centerSum = 0.0;
+    size_t centerStars = 0;
+    for (int row = (rows - 1) / 2; row <= rows / 2; ++row) {
+      for (int col = (cols - 1) / 2; col <= cols / 2; ++col) {
+        const FocalPlaneCell& c = map_.cell(col, row);
+        centerSum += static_cast<double>(c.medianHFD) * c.stars;
+        centerStars += c.stars;
+      }
+    }
+    map_.centerHFD = centerStars > 0 ? static_cast<float>(centerSum / centerStars) : 0.0f;
+
+    const FocalPlaneCell* corners[4] = {&map_.cell(0, 0), &map_.cell(cols - 1, 0), &map_.cell(0, rows - 1),
+                                        &map_.cell(cols - 1, rows - 1)};
+    bool allCorners = true;
+    for (int i = 0; i < 4; ++i) {
+      map_.cornerHFD[i] = corners[i]->medianHFD;
+      const bool measured = corners[i]->stars > 0;
+      allCorners = allCorners && measured;
+      map_.cornerDelta[i] = measured && centerStars > 0 ? map_.cornerHFD[i] - map_.centerHFD : 0.0f;
+    }
+    if (allCorners) {
+      const float* h = map_.cornerHFD;
+      map_.tiltX = 0.5f * ((h[1] + h[3]) - (h[0] + h[2]));
+      map_.tiltY = 0.5f * ((h[2] + h[3]) - (h[0] + h[1]));
+      if (centerStars > 0) {
+        map_.curvature = 0.25f * (h[0] + h[1] + h[2] + h[3]) - map_.centerHFD;
+      }
+    }
+  }
+
+  WorkStealingPool& pool_;
+  FocalPlaneConfig config_;
+  FocalPlaneMap map_;
+
+  // Reused between frames, so a steady stream does not allocate
+  std::vector<focal_plane_detail::Partial> partials_;
+  std::vector<size_t> offsets_;
+  std::vector<size_t> cursor_;
+  std::vector<size_t> shapedEnd_;
+  std::vector<float> hfds_;
+  std::vector<float> ellipticities_;
+};
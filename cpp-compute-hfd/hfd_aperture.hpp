@@ -0,0 +1,314 @@
+// Sub-pixel-exact HFD with pixel-area aperture integration
+// computeHFD treats every pixel as a point at its center, so the enclosed flux
+// jumps whenever the radius passes a pixel center and the aperture edge cuts
+// whole pixels. Here every pixel is a uniform square of flux: the enclosed flux
+// is the exact circle/square overlap, a continuous function of the radius.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "hfd_utils.hpp"
+
+// Pixel-area HFD parameters
+constexpr int    kArcsineTableSize = 1024;            // Arcsine samples over [0, 0.5] for the table path
+constexpr double kHalfFluxRadiusTolerance = 1e-5;     // Half-flux radius convergence (pixels)
+constexpr int    kHalfFluxMaxIterations = 60;         // Root finder iteration cap
+constexpr double kPixelHalfDiagonal = 0.70710678118654752;  // Pixel center to corner (pixels)
+
+enum class ApertureCoverage {
+  Exact,  // Closed-form circle/square overlap with std::asin
+  Table   // Same closed form, arcsine interpolated from a table (default)
+};
+
+namespace aperture_detail {
+
+// asin over [0, 0.5], linearly interpolated. Larger arguments go through
+// asin(u) = pi/2 - 2 asin(sqrt((1 - u) / 2)), which keeps the table away from
+// the singular slope at u = 1
+inline double arcsineTable(double u) {
+  static const std::array<double, kArcsineTableSize + 1> table = [] {
+    std::array<double, kArcsineTableSize + 1> values{};
+    for (int i = 0; i <= kArcsineTableSize; ++i) {
+      values[i] = std::asin(0.5 * i / kArcsineTableSize);
+    }
+    return values;
+  }();
+
+  auto lookup = [&](double v) {
+    const double position = v * (2.0 * kArcsineTableSize);
+    const int i = std::min(kArcsineTableSize - 1, static_cast<int>(position));
+    const double fraction = position - i;
+    return table[i] + fraction * (table[i + 1] - table[i]);
+  };
+  if (u <= 0.5) {
+    return lookup(u);
+  }
+  return 0.5 * CV_PI - 2.0 * lookup(std::sqrt(0.5 * (1.0 - u)));
+}
+
+template <ApertureCoverage Coverage>
+inline double arcsine(double u) {
+  return Coverage == ApertureCoverage::Exact ? std::asin(u) : arcsineTable(u);
+}
+
+// Part of the disk of radius r about the origin inside a region: its area and
+// the length of the circle inside it (the derivative of the area in r)
+struct Overlap {
+  double area = 0.0;
+  double arc = 0.0;
+};
+
+// Overlap of the disk with [0, x] x [0, y], extended as an odd function of x
+// and y so that rectangles can straddle the axes. Past the point where the
+// circle crosses Y = y at xc < x, the area is a y-high rectangle plus the area
+// under the arc: ∫ sqrt(r² - t²) dt = (t sqrt(r² - t²) + r² asin(t / r)) / 2
+template <ApertureCoverage Coverage>
+inline Overlap cornerOverlap(double x, double y, double r, double r2, double inverseR) {
+  const double sign = (x < 0.0) != (y < 0.0) ? -1.0 : 1.0;
+  x = std::min(std::abs(x), r);
+  y = std::min(std::abs(y), r);
+  if (x * x + y * y <= r2) {
+    return Overlap{sign * x * y, 0.0};
+  }
+  const double xc = std::sqrt(std::max(0.0, r2 - y * y));
+  const double angleX = arcsine<Coverage>(std::min(1.0, x * inverseR));
+  const double angleC = arcsine<Coverage>(std::min(1.0, xc * inverseR));
+  const double underArc = 0.5 * (x * std::sqrt(std::max(0.0, r2 - x * x)) - xc * y + r2 * (angleX - angleC));
+  return Overlap{sign * (y * xc + underArc), sign * r * (angleX - angleC)};
+}
+
+// Squared distances from the origin to the nearest and farthest point of the
+// unit pixel centered at (dx, dy)
+inline double nearestSquared(double dx, double dy) {
+  const double nx = std::max(0.0, std::abs(dx) - 0.5);
+  const double ny = std::max(0.0, std::abs(dy) - 0.5);
+  return nx * nx + ny * ny;
+}
+
+inline double farthestSquared(double dx, double dy) {
+  const double fx = std::abs(dx) + 0.5;
+  const double fy = std::abs(dy) + 0.5;
+  return fx * fx + fy * fy;
+}
+
+// Overlap of the disk of radius r about the origin with the unit pixel
+// centered at (dx, dy), as a fraction of the pixel
+template <ApertureCoverage Coverage>
+inline Overlap pixelOverlap(double dx, double dy, double r) {
+  const double r2 = r * r;
+  if (farthestSquared(dx, dy) <= r2) {
+    return Overlap{1.0, 0.0};
+  }
+  if (nearestSquared(dx, dy) >= r2) {
+    return Overlap{0.0, 0.0};
+  }
+  const double inverseR = 1.0 / r;
+  dx = std::abs(dx);
+  dy = std::abs(dy);
+  const double x0 = dx - 0.5, x1 = dx + 0.5;
+  const double y0 = dy - 0.5, y1 = dy + 0.5;
+  const Overlap a = cornerOverlap<Coverage>(x1, y1, r, r2, inverseR);
+  const Overlap b = cornerOverlap<Coverage>(x0, y1, r, r2, inverseR);
+  const Overlap c = cornerOverlap<Coverage>(x1, y0, r, r2, inverseR);
+  const Overlap d = cornerOverlap<Coverage>(x0, y0, r, r2, inverseR);
+  return Overlap{a.area - b.area - c.area + d.area, a.arc - b.arc - c.arc + d.arc};
+}
+
+// Pixel straddling the half-flux search interval
+struct BandPixel {
+  double dx;
+  double dy;
+  double flux;
+  double nearest;    // Squared distance to the nearest point of the pixel
+  double farthest;   // Squared distance to the farthest point
+};
+
+// Squared radii around a circle of radius r: pixels centered inside the first
+// are entirely inside the circle, pixels centered beyond the second entirely outside
+inline double innerSquared(double r) {
+  const double inner = std::max(0.0, r - kPixelHalfDiagonal);
+  return inner * inner;
+}
+
+inline double outerSquared(double r) {
+  return (r + kPixelHalfDiagonal) * (r + kPixelHalfDiagonal);
+}
+
+template <ApertureCoverage Coverage>
+float pixelAreaHFD(const cv::Mat& starRegion, const cv::Point2f& centroid, const BackgroundStats& background,
+                   double maxApertureRadius, float backgroundStdDevMultiplier, double* apertureFlux) {
+  // Same threshold as computeHFD, subtracted in float precision
+  const float backgroundThreshold =
+      static_cast<float>(background.level + backgroundStdDevMultiplier * background.stddev);
+
+  const double apertureRadius = maxApertureRadius;
+  const double apertureSquared = apertureRadius * apertureRadius;
+  const double binWidth = std::max(1.0, apertureSquared / (kHFDRadialBins - 1));
+  const double inverseBinWidth = 1.0 / binWidth;
+  const int binCount = std::min(kHFDRadialBins, static_cast<int>(apertureSquared * inverseBinWidth) + 1);
+
+  // Pass 1: aperture flux with exact edge pixels, plus the point-sample radial
+  // histogram (by pixel center) that brackets the half-flux radius
+  double binFlux[kHFDRadialBins];
+  std::fill(binFlux, binFlux + binCount, 0.0);
+  double totalFlux = 0.0;
+  const double apertureInner = innerSquared(apertureRadius);
+  const double apertureOuter = outerSquared(apertureRadius);
+
+  const int yFirst = std::max(0, static_cast<int>(std::floor(centroid.y - apertureRadius - 0.5)));
+  const int yLast = std::min(starRegion.rows - 1, static_cast<int>(std::ceil(centroid.y + apertureRadius - 0.5)));
+  const int xFirst = std::max(0, static_cast<int>(std::floor(centroid.x - apertureRadius - 0.5)));
+  const int xLast = std::min(starRegion.cols - 1, static_cast<int>(std::ceil(centroid.x + apertureRadius - 0.5)));
+  for (int y = yFirst; y <= yLast; y++) {
+    const uint16_t* row = starRegion.ptr<uint16_t>(y);
+    const double dy = (y + 0.5) - centroid.y;
+    for (int x = xFirst; x <= xLast; x++) {
+      const float pixel = static_cast<float>(row[x]) - backgroundThreshold;
+      if (pixel <= 0.0f) continue;
+
+      const double dx = (x + 0.5) - centroid.x;
+      const double r2 = dx * dx + dy * dy;
+      if (r2 <= apertureInner) {
+        totalFlux += pixel;
+      } else {
+        if (r2 >= apertureOuter || nearestSquared(dx, dy) >= apertureSquared) continue;
+        totalFlux += pixel * pixelOverlap<Coverage>(dx, dy, apertureRadius).area;
+      }
+      binFlux[std::min(binCount - 1, static_cast<int>(r2 * inverseBinWidth))] += pixel;
+    }
+  }
+
+  if (apertureFlux) {
+    *apertureFlux = totalFlux;
+  }
+  if (totalFlux <= 0.0) {
+    return 0.0f;
+  }
+  const double halfFlux = totalFlux / 2.0;
+
+  // A pixel is entirely inside radius r once its center is within r - half a
+  // diagonal and entirely outside while its center is beyond r + half a
+  // diagonal, so the half-flux radius is within half a diagonal of the bin
+  // where the center-binned flux crosses half the total
+  double fluxBefore = 0.0;
+  int crossingBin = binCount - 1;
+  for (int bin = 0; bin < binCount; ++bin) {
+    if (fluxBefore + binFlux[bin] >= halfFlux) {
+      crossingBin = bin;
+      break;
+    }
+    fluxBefore += binFlux[bin];
+  }
+  double low = std::max(0.0, std::sqrt(crossingBin * binWidth) - kPixelHalfDiagonal);
+  double high = std::min(apertureRadius, std::sqrt((crossingBin + 1) * binWidth) + kPixelHalfDiagonal);
+
+  // Pass 2: flux entirely inside `low`, and the pixels that are partly inside
+  // somewhere in [low, high]
+  thread_local std::vector<BandPixel> band;
+  band.clear();
+  double insideFlux = 0.0;
+  const double lowInner = innerSquared(low);
+  const double highOuter = outerSquared(high);
+  const double reach = high + 0.5;
+  const int bandYFirst = std::max(yFirst, static_cast<int>(std::floor(centroid.y - reach)));
+  const int bandYLast = std::min(yLast, static_cast<int>(std::ceil(centroid.y + reach)));
+  const int bandXFirst = std::max(xFirst, static_cast<int>(std::floor(centroid.x - reach)));
+  const int bandXLast = std::min(xLast, static_cast<int>(std::ceil(centroid.x + reach)));
+  for (int y = bandYFirst; y <= bandYLast; y++) {
+    const uint16_t* row = starRegion.ptr<uint16_t>(y);
+    const double dy = (y + 0.5) - centroid.y;
+    for (int x = bandXFirst; x <= bandXLast; x++) {
+      const float pixel = static_cast<float>(row[x]) - backgroundThreshold;
+      if (pixel <= 0.0f) continue;
+
+      const double dx = (x + 0.5) - centroid.x;
+      const double r2 = dx * dx + dy * dy;
+      if (r2 <= lowInner) {
+        insideFlux += pixel;
+      } else if (r2 < highOuter) {
+        band.push_back(BandPixel{dx, dy, pixel, nearestSquared(dx, dy), farthestSquared(dx, dy)});
+      }
+    }
+  }
+
+  // Enclosed flux minus half the total, and its derivative: continuous and
+  // nondecreasing in r
+  auto excess = [&](double r, double& slope) {
+    double flux = insideFlux;
+    slope = 0.0;
+    for (const BandPixel& p : band) {
+      const Overlap overlap = pixelOverlap<Coverage>(p.dx, p.dy, r);
+      flux += p.flux * overlap.area;
+      slope += p.flux * overlap.arc;
+    }
+    return flux - halfFlux;
+  };
+
+  // Newton from the point-sample crossing, falling back to bisection whenever
+  // a step would leave the bracket
+  const double fraction = binFlux[crossingBin] > 0.0 ? (halfFlux - fluxBefore) / binFlux[crossingBin] : 0.5;
+  double r = std::sqrt((crossingBin + std::min(1.0, fraction)) * binWidth);
+  if (!(r > low && r < high)) r = 0.5 * (low + high);
+  for (int iteration = 0; iteration < kHalfFluxMaxIterations; ++iteration) {
+    double slope;
+    const double f = excess(r, slope);
+    if (f == 0.0) break;
+    if (f < 0.0) {
+      low = r;
+    } else {
+      high = r;
+    }
+
+    // Pixels now entirely inside or outside the bracket drop out of the band
+    const double lowSquared = low * low;
+    const double highSquared = high * high;
+    size_t kept = 0;
+    for (const BandPixel& p : band) {
+      if (p.farthest <= lowSquared) {
+        insideFlux += p.flux;
+      } else if (p.nearest < highSquared) {
+        band[kept++] = p;
+      }
+    }
+    band.resize(kept);
+
+    double next = slope > 0.0 ? r - f / slope : 0.5 * (low + high);
+    if (!(next > low && next < high)) next = 0.5 * (low + high);
+    const bool converged = std::abs(next - r) < kHalfFluxRadiusTolerance || high - low < kHalfFluxRadiusTolerance;
+    r = next;
+    if (converged) break;
+  }
+  return static_cast<float>(2.0 * r);
+}
+
+}  // namespace aperture_detail
+
+// Compute HFD with every pixel integrated as a uniform square of flux
+// Same arguments as computeHFD. The aperture edge takes the exact fraction of
+// each pixel it crosses, and the half-flux radius is where the exact enclosed
+// flux reaches half the total, so the result varies smoothly with the
+// centroid instead of jumping as pixel centers cross a radius.
+// For a Gaussian of width sigma the result tends to 2.355 * sqrt(sigma² + 1/12)
+// (the star convolved with the pixel), not the 2.55 * sigma of computeHFD.
+// If apertureFlux is given it receives the total flux inside the aperture.
+inline float computeHFDPixelArea(const cv::Mat& starRegion,
+                                 const cv::Point2f& centroid,
+                                 const BackgroundStats& background,
+                                 double maxApertureRadius = kMaxApertureRadius,
+                                 float backgroundStdDevMultiplier = kHFDBackgroundMultiplier,
+                                 ApertureCoverage coverage = ApertureCoverage::Table,
+                                 double* apertureFlux = nullptr) {
+  if (coverage == ApertureCoverage::Exact) {
+    return aperture_detail::pixelAreaHFD<ApertureCoverage::Exact>(
+        starRegion, centroid, background, maxApertureRadius, backgroundStdDevMultiplier, apertureFlux);
+  }
+  return aperture_detail::pixelAreaHFD<ApertureCoverage::Table>(
+      starRegion, centroid, background, maxApertureRadius, backgroundStdDevMultiplier, apertureFlux);
+}
@@ -0,0 +1,419 @@
+// Full-frame multi-star HFD engine
+// Detects stars across a 16-bit frame and runs the hfd_utils.hpp pipeline on
+// every star stamp in parallel.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "background_map.hpp"
+#include "hfd_aperture.hpp"
+#include "hfd_fixed_point.hpp"
+#include "hfd_simd.hpp"
+#include "hfd_utils.hpp"
+#include "psf_shape.hpp"
+#include "stamp_defects.hpp"
+#include "star_detector.hpp"
+#include "star_table.hpp"
+#include "thread_pool.hpp"
+
+// Detection parameters
+constexpr int    kDefaultStampSize = 50;              // Stamp edge length, same as findBrightestRegion (pixels)
+constexpr double kDetectionSigma = 5.0;               // Peak threshold above the background map (sigma)
+constexpr int    kDefaultMaxStars = 5000;             // Upper bound on stars measured per frame
+constexpr int    kBackgroundSampleTarget = 65536;     // Approximate pixel count sampled for global background
+
+// Scheduling parameters
+constexpr size_t kStarsPerTask = 16;                  // Stamps per work-stealing task
+constexpr int    kRowsPerDetectionTask = 64;          // Frame rows per detection task
+
+struct HFDEngineConfig {
+  int stampSize = kDefaultStampSize;
+  int maxStars = kDefaultMaxStars;
+  double detectionSigma = kDetectionSigma;
+  int backgroundTileSize = kBackgroundTileSize;  // Detection background mesh tile (pixels), 0 = one global level
+  bool componentDetection = true;  // Connected components (star_detector.hpp) instead of local maxima
+  uint16_t saturationLevel = kSaturationLevel;  // Component detection rejects stars with pixels at or above this
+  float backgroundStdDevMultiplier = kBackgroundSigmaThreshold;
+  double maxApertureRadius = kMaxApertureRadius;
+  bool sortFreeHFD = true;       // computeHFDHistogram instead of computeHFD
+  bool pixelAreaHFD = false;     // computeHFDPixelArea (pixels as squares) instead of either point-sample kernel
+  bool psfShape = false;         // FWHM, ellipticity and position angle (psf_shape.hpp), fused with computeHFDHistogram
+  BackgroundEstimator backgroundEstimator = BackgroundEstimator::Linear;  // Frame and stamp background estimator
+  bool rejectDefects = false;    // Repair hot pixels and cosmic rays in each stamp before centroiding (stamp_defects.hpp)
+  std::shared_ptr<const BadPixelMap> badPixels;  // Static sensor defects, repaired with rejectDefects
+  bool fixedPoint = false;       // Integer background, centroid and HFD (hfd_fixed_point.hpp), bit-identical across
+                                 // CPUs, SIMD levels and thread counts; replaces the HFD kernel choice above
+};
+
+struct StarCandidate {
+  cv::Point peak;       // Peak pixel in frame coordinates
+  uint16_t peakValue;
+};
+
+struct StarMeasurement {
+  cv::Rect stamp;                // Stamp window in frame coordinates
+  cv::Point2f centroid;          // Centroid in frame coordinates
+  BackgroundStats background;
+  float hfd;                     // Half-flux diameter (pixels), 0 if not measurable
+  uint16_t peakValue;
+  float flux;                    // Background-subtracted flux inside the aperture
+  uint32_t flags;                // kStarFlag* bits (star_table.hpp)
+  PSFShape shape;                // Zero unless HFDEngineConfig::psfShape
+};
+
+struct FrameHFDResult {
+  std::vector<StarMeasurement> stars;
+  float medianHFD = 0.0f;        // Median over stars with hfd > 0
+  size_t measuredStars = 0;      // Stars that contributed to medianHFD
+};
+
+// Fill medianHFD and measuredStars from result.stars
+inline void summarizeFrame(FrameHFDResult& result) {
+  std::vector<double> hfds;
+  hfds.reserve(result.stars.size());
+  for (const auto& star : result.stars) {
+    if (star.hfd > 0.0f) {
+      hfds.push_back(star.hfd);
+    }
+  }
+  result.measuredStars = hfds.size();
+  result.medianHFD = static_cast<float>(computeMedian(hfds));
+}
+
+// Estimate the global background of a frame from a strided pixel sample
+// Uses the same median + sigma clipping semantics as computeBackgroundStats.
+// frame must be CV_16UC1
+inline BackgroundStats estimateFrameBackground(const cv::Mat& frame,
+                                               int sampleTarget = kBackgroundSampleTarget,
+                                               BackgroundEstimator estimator = BackgroundEstimator::SortAndClip) {
+  CV_Assert(frame.type() == CV_16UC1);
+  const double pixelCount = static_cast<double>(frame.rows) * frame.cols;
+  const int stride = std::max(1, static_cast<int>(std::sqrt(pixelCount / std::max(1, sampleTarget))));
+
+  std::vector<uint16_t> samples;
+  samples.reserve(static_cast<size_t>(pixelCount / (stride * stride)) + 1);
+  for (int y = stride / 2; y < frame.rows; y += stride) {
+    const uint16_t* row = frame.ptr<uint16_t>(y);
+    for (int x = stride / 2; x < frame.cols; x += stride) {
+      samples.push_back(row[x]);
+    }
+  }
+
+  if (estimator == BackgroundEstimator::Linear) {
+    return computeRobustBackgroundLinear(samples);
+  }
+  return computeRobustBackground(std::vector<double>(samples.begin(), samples.end()));
+}
+
+class HFDEngine {
+ public:
+  explicit HFDEngine(HFDEngineConfig config = HFDEngineConfig(), unsigned threadCount = 0)
+      : config_(config), pool_(threadCount) {}
+
+  unsigned threadCount() const { return pool_.threadCount(); }
+  const HFDEngineConfig& config() const { return config_; }
+  WorkStealingPool& pool() { return pool_; }   // Shared with per-frame reductions (focal_plane_map.hpp)
+
+  // Detect stars and measure all of them; frame must be CV_16UC1
+  FrameHFDResult measureFrame(const cv::Mat& frame) {
+    CV_Assert(frame.type() == CV_16UC1);
+    return measureCandidates(frame, detectStars(frame));
+  }
+
+  // Find stars above the background map threshold whose stamp fits entirely
+  // inside the frame, brightest first, at most one per stamp half-width.
+  // Stars are connected components (saturated and hot-pixel blobs rejected),
+  // or plain local maxima with componentDetection off. frame must be CV_16UC1
+  std::vector<StarCandidate> detectStars(const cv::Mat& frame) {
+    CV_Assert(frame.type() == CV_16UC1);
+    if (config_.backgroundTileSize > 0) {
+      const BackgroundMapConfig mapConfig{config_.backgroundTileSize, kBackgroundMeshFilterSize};
+      backgroundMap_ = estimateBackgroundMap(frame, pool_, mapConfig);
+    } else {
+      const BackgroundStats background =
+          estimateFrameBackground(frame, kBackgroundSampleTarget, config_.backgroundEstimator);
+      backgroundMap_ = BackgroundMap(frame.size(), 1, 1, {static_cast<float>(background.level)},
+                                     {static_cast<float>(background.stddev)});
+    }
+
+    const int margin = config_.stampSize / 2;
+    const int yBegin = std::max(1, margin);
+    const int yEnd = std::min(frame.rows - 1, frame.rows - (config_.stampSize - margin));
+    const int xBegin = std::max(1, margin);
+    const int xEnd = std::min(frame.cols - 1, frame.cols - (config_.stampSize - margin));
+    if (yEnd <= yBegin || xEnd <= xBegin) {
+      return {};
+    }
+
+    if (config_.componentDetection) {
+      StarDetectorConfig detectorConfig;
+      detectorConfig.sigma = config_.detectionSigma;
+      detectorConfig.saturationLevel = config_.saturationLevel;
+      const StarDetection detection = detectStarComponents(frame, backgroundMap_, pool_, detectorConfig);
+
+      std::vector<StarCandidate> candidates;
+      candidates.reserve(detection.stars.size());
+      for (const DetectedStar& star : detection.stars) {
+        if (star.peak.x >= xBegin && star.peak.x < xEnd && star.peak.y >= yBegin && star.peak.y < yEnd) {
+          candidates.push_back(StarCandidate{star.peak, star.peakValue});
+        }
+      }
+      return suppressNeighbours(std::move(candidates), frame.size());
+    }
+
+    const size_t bandCount = static_cast<size_t>((yEnd - yBegin + kRowsPerDetectionTask - 1) / kRowsPerDetectionTask);
+    std::vector<std::vector<StarCandidate>> bandCandidates(bandCount);
+
+    pool_.parallelFor(bandCount, 1, [&](size_t begin, size_t end, unsigned) {
+      for (size_t band = begin; band < end; ++band) {
+        const int bandStart = yBegin + static_cast<int>(band) * kRowsPerDetectionTask;
+        const int bandStop = std::min(yEnd, bandStart + kRowsPerDetectionTask);
+        findLocalMaxima(frame, bandStart, bandStop, xBegin, xEnd, bandCandidates[band]);
+      }
+    });
+
+    std::vector<StarCandidate> candidates;
+    for (auto& band : bandCandidates) {
+      candidates.insert(candidates.end(), band.begin(), band.end());
+    }
+    return suppressNeighbours(std::move(candidates), frame.size());
+  }
+
+  // Background map used by the last detectStars / measureFrame call
+  const BackgroundMap& backgroundMap() const { return backgroundMap_; }
+
+  // Measure the stars at the given candidates; stamps are ROI views into frame
+  FrameHFDResult measureCandidates(const cv::Mat& frame, const std::vector<StarCandidate>& candidates) {
+    std::vector<cv::Rect> stamps;
+    stamps.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+      stamps.push_back(stampAround(candidate.peak));
+    }
+    return measureStamps(frame, stamps);
+  }
+
+  // Run background, centroid and HFD on every stamp across the pool
+  FrameHFDResult measureStamps(const cv::Mat& frame, const std::vector<cv::Rect>& stamps) {
+    FrameHFDResult result;
+    result.stars.resize(stamps.size());
+
+    pool_.parallelFor(stamps.size(), kStarsPerTask, [&](size_t begin, size_t end, unsigned) {
+      for (size_t i = begin; i < end; ++i) {
+        result.stars[i] = measureStamp(frame, stamps[i]);
+      }
+    });
+
+    summarizeFrame(result);
+    return result;
+  }
+
+  // measureStamps with each stamp's background already known (backgrounds[i]
+  // for stamps[i], e.g. from the previous frame): no annulus estimates, one
+  // centroid pass per star
+  FrameHFDResult measureStamps(const cv::Mat& frame, const std::vector<cv::Rect>& stamps,
+                               const std::vector<BackgroundStats>& backgrounds) {
+    FrameHFDResult result;
+    result.stars.resize(stamps.size());
+
+    pool_.parallelFor(stamps.size(), kStarsPerTask, [&](size_t begin, size_t end, unsigned) {
+      for (size_t i = begin; i < end; ++i) {
+        result.stars[i] = measureStamp(frame, stamps[i], &backgrounds[i]);
+      }
+    });
+
+    summarizeFrame(result);
+    return result;
+  }
+
+  // Batch form of measureStamps: row i of `table` is stamps[i]. Each worker
+  // writes straight into the columns, and the per-star scratch (annulus
+  // values, histograms) is thread_local, so with a reused table and the
+  // Linear estimator a batch allocates nothing after the first call
+  void measureStamps(const cv::Mat& frame, const std::vector<cv::Rect>& stamps, StarTable& table) {
+    table.resize(stamps.size());
+
+    pool_.parallelFor(stamps.size(), kStarsPerTask, [&](size_t begin, size_t end, unsigned) {
+      for (size_t i = begin; i < end; ++i) {
+        const StarMeasurement star = measureStamp(frame, stamps[i]);
+        table.x[i] = star.centroid.x;
+        table.y[i] = star.centroid.y;
+        table.backgroundLevel[i] = static_cast<float>(star.background.level);
+        table.backgroundStdDev[i] = static_cast<float>(star.background.stddev);
+        table.hfd[i] = star.hfd;
+        table.flux[i] = star.flux;
+        table.peak[i] = star.peakValue;
+        table.flags[i] = star.flags;
+        table.fwhm[i] = star.shape.fwhm;
+        table.ellipticity[i] = star.shape.ellipticity;
+        table.positionAngle[i] = star.shape.positionAngle;
+      }
+    });
+  }
+
+ private:
+  cv::Rect stampAround(const cv::Point& peak) const {
+    const int half = config_.stampSize / 2;
+    return cv::Rect(peak.x - half, peak.y - half, config_.stampSize, config_.stampSize);
+  }
+
+  StarMeasurement measureStamp(const cv::Mat& frame, const cv::Rect& stamp,
+                               const BackgroundStats* knownBackground = nullptr) const {
+    StarMeasurement star{stamp, cv::Point2f(), BackgroundStats(), 0.0f, 0, 0.0f, 0, PSFShape()};
+    const cv::Rect clipped = stamp & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (clipped.area() == 0) {
+      star.flags = kStarFlagEmpty;
+      return star;
+    }
+    if (clipped != stamp) {
+      star.flags |= kStarFlagClipped;
+    }
+    star.stamp = clipped;
+
+    cv::Mat region = frame(clipped);  // View, no pixel copy
+
+    // Defects are found against the first background estimate and repaired in
+    // a per-thread copy, which is then measured instead of the view
+    BackgroundStats initialBackground;
+    if (config_.rejectDefects) {
+      thread_local cv::Mat repaired;
+      const cv::Point2f center(region.cols / 2.0f, region.rows / 2.0f);
+      initialBackground = knownBackground     ? *knownBackground
+                          : config_.fixedPoint ? computeBackgroundStatsFixed(region, center)
+                                               : computeBackgroundStatsWith(config_.backgroundEstimator, region, center);
+      StampDefectConfig defectConfig;
+      defectConfig.badPixels = config_.badPixels.get();
+      if (rejectStampDefects(region, initialBackground, repaired, clipped.tl(), defectConfig).repaired() > 0) {
+        region = repaired;
+        star.flags |= kStarFlagDefectsRepaired;
+      }
+    }
+
+    const BackgroundStats* firstBackground = config_.rejectDefects ? &initialBackground : nullptr;
+    BackgroundAndCentroid bc;
+    if (config_.fixedPoint) {
+      bc = knownBackground
+               ? BackgroundAndCentroid{*knownBackground, computeCentroidFixed(region, *knownBackground,
+                                                                              config_.backgroundStdDevMultiplier)}
+               : computeBackgroundAndCentroidFixed(region, config_.backgroundStdDevMultiplier, kMinBackgroundRadius,
+                                                   kMaxBackgroundRadius, activeSimdLevel(), firstBackground);
+    } else {
+      bc = knownBackground
+               ? BackgroundAndCentroid{*knownBackground, computeCentroidSIMD(region, *knownBackground,
+                                                                             config_.backgroundStdDevMultiplier,
+                                                                             activeSimdLevel())}
+               : computeBackgroundAndCentroidSIMD(region, config_.backgroundStdDevMultiplier, kMinBackgroundRadius,
+                                                  kMaxBackgroundRadius, activeSimdLevel(), config_.backgroundEstimator,
+                                                  firstBackground);
+    }
+    star.background = bc.background;
+    star.centroid = cv::Point2f(bc.centroid.x + clipped.x, bc.centroid.y + clipped.y);
+    double flux = 0.0;
+    if (config_.fixedPoint) {
+      star.hfd = computeHFDFixed(region, bc.centroid, bc.background, config_.maxApertureRadius,
+                                 kHFDBackgroundMultiplier, &flux);
+      if (config_.psfShape) {
+        star.shape = computePSFShape(region, bc.centroid, bc.background, config_.maxApertureRadius);
+      }
+    } else if (config_.pixelAreaHFD) {
+      star.hfd = computeHFDPixelArea(region, bc.centroid, bc.background, config_.maxApertureRadius,
+                                     kHFDBackgroundMultiplier, ApertureCoverage::Table, &flux);
+      if (config_.psfShape) {
+        star.shape = computePSFShape(region, bc.centroid, bc.background, config_.maxApertureRadius);
+      }
+    } else if (config_.sortFreeHFD) {
+      star.hfd = config_.psfShape
+                     ? computeHFDAndShape(region, bc.centroid, bc.background, star.shape, config_.maxApertureRadius,
+                                          kHFDBackgroundMultiplier, &flux)
+                     : computeHFDHistogram(region, bc.centroid, bc.background, config_.maxApertureRadius,
+                                           kHFDBackgroundMultiplier, &flux);
+    } else {
+      star.hfd = computeHFD(region, bc.centroid, bc.background, config_.maxApertureRadius,
+                            kHFDBackgroundMultiplier, &flux);
+      if (config_.psfShape) {
+        star.shape = computePSFShape(region, bc.centroid, bc.background, config_.maxApertureRadius);
+      }
+    }
+    star.flux = static_cast<float>(flux);
+
+    double minVal, maxVal;
+    cv::minMaxLoc(region, &minVal, &maxVal);
+    star.peakValue = static_cast<uint16_t>(maxVal);
+
+    if (star.hfd <= 0.0f) star.flags |= kStarFlagNoHFD;
+    if (star.peakValue >= config_.saturationLevel) star.flags |= kStarFlagSaturated;
+    if (bc.background.stddev <= 0.0) star.flags |= kStarFlagFlatBackground;
+    return star;
+  }
+
+  // The map is evaluated only at pixels above its threshold's lower bound and
+  // is never expanded to a full-size image
+  void findLocalMaxima(const cv::Mat& frame, int yBegin, int yEnd, int xBegin, int xEnd,
+                       std::vector<StarCandidate>& out) const {
+    CV_Assert(frame.type() == CV_16UC1);
+    const float sigma = static_cast<float>(config_.detectionSigma);
+    for (int y = yBegin; y < yEnd; ++y) {
+      const uint16_t* above = frame.ptr<uint16_t>(y - 1);
+      const uint16_t* row = frame.ptr<uint16_t>(y);
+      const uint16_t* below = frame.ptr<uint16_t>(y + 1);
+      backgroundMap_.forEachAboveThreshold(row, y, xBegin, xEnd, sigma, 1.0f, [&](int x, float, float) {
+        const uint16_t v = row[x];
+
+        // Strict comparison against already-visited neighbours breaks ties on flat peaks
+        if (v <= above[x - 1] || v <= above[x] || v <= above[x + 1] || v <= row[x - 1]) return;
+        if (v < row[x + 1] || v < below[x - 1] || v < below[x] || v < below[x + 1]) return;
+
+        out.push_back(StarCandidate{cv::Point(x, y), v});
+      });
+    }
+  }
+
+  // Keep the brightest candidate within each stamp half-width, up to maxStars
+  std::vector<StarCandidate> suppressNeighbours(std::vector<StarCandidate> candidates, const cv::Size& frameSize) const {
+    std::sort(candidates.begin(), candidates.end(),
+              [](const StarCandidate& a, const StarCandidate& b) { return a.peakValue > b.peakValue; });
+
+    // Cells are half a separation wide, so their diagonal is shorter than the
+    // separation and each cell can hold at most one accepted star
+    const int separation = std::max(2, config_.stampSize / 2);
+    const int cellSize = separation / 2;
+    const int gridCols = frameSize.width / cellSize + 1;
+    const int gridRows = frameSize.height / cellSize + 1;
+    std::vector<int> grid(static_cast<size_t>(gridCols) * gridRows, -1);  // Accepted index per cell
+
+    std::vector<StarCandidate> accepted;
+    for (const auto& candidate : candidates) {
+      if (static_cast<int>(accepted.size()) >= config_.maxStars) break;
+
+      const int cellX = candidate.peak.x / cellSize;
+      const int cellY = candidate.peak.y / cellSize;
+      bool isolated = true;
+      for (int gy = std::max(0, cellY - 2); isolated && gy <= std::min(gridRows - 1, cellY + 2); ++gy) {
+        for (int gx = std::max(0, cellX - 2); gx <= std::min(gridCols - 1, cellX + 2); ++gx) {
+          const int index = grid[static_cast<size_t>(gy) * gridCols + gx];
+          if (index < 0) continue;
+          const cv::Point d = accepted[index].peak - candidate.peak;
+          if (d.x * d.x + d.y * d.y < separation * separation) {
+            isolated = false;
+            break;
+          }
+        }
+      }
+      if (!isolated) continue;
+
+      grid[static_cast<size_t>(cellY) * gridCols + cellX] = static_cast<int>(accepted.size());
+      accepted.push_back(candidate);
+    }
+    return accepted;
+  }
+
+  HFDEngineConfig config_;
+  WorkStealingPool pool_;
+  BackgroundMap backgroundMap_;
+};
@@ -0,0 +1,345 @@
+// Deterministic fixed-point background, centroid and HFD for 16-bit stamps
+// The floating-point kernels agree across CPUs only to within rounding:
+// summation order (SIMD lane count, thread split), FMA contraction (on by
+// default on AArch64) and libm all move the last bits. Here every sum,
+// comparison and interpolation is an integer operation, so the results are
+// bit-identical on x86-64 and AArch64, at every SimdLevel and thread count:
+//   - Background level and stddev in 1/65536 ADU: median, sigma clipping with
+//     exact integer bounds, mean and integer square root of the variance
+//   - Centroid from the exact integer moments of computeCentroidMoments, in
+//     1/65536 px
+//   - HFD from integer flux (1/65536 ADU) binned by integer r^2 (1/65536 px
+//     positions), interpolated and square-rooted in integers
+// Inputs and outputs are the usual BackgroundStats / cv::Point2f / float;
+// every value produced here converts to and from them exactly. The int64
+// ranges hold for stamps up to 200 x 200 px and apertures up to 32 px.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "background_estimator.hpp"
+#include "hfd_simd.hpp"
+#include "hfd_utils.hpp"
+
+// Fixed-point formats
+constexpr int     kFixedLevelBits = 16;                // Background, threshold and flux: 1/65536 ADU
+constexpr int     kFixedPositionBits = 16;             // Centroid and radii: 1/65536 px
+constexpr int64_t kFixedLevelOne = int64_t(1) << kFixedLevelBits;
+constexpr int64_t kFixedPositionOne = int64_t(1) << kFixedPositionBits;
+constexpr int64_t kFixedClippingSigma = static_cast<int64_t>(kClippingSigma);
+static_assert(kFixedClippingSigma == kClippingSigma, "fixed-point clipping needs an integer kClippingSigma");
+
+namespace fixed_point_detail {
+
+// floor(sqrt(n)); the double estimate is only a starting point, the result is exact
+inline uint64_t isqrt(uint64_t n) {
+  uint64_t r = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+  while (r > 0 && r * r > n) --r;
+  while ((r + 1) * (r + 1) <= n) ++r;
+  return r;
+}
+
+// floor(a * m / d) without forming a * m (needs m * d < 2^63)
+inline int64_t mulDiv(int64_t a, int64_t m, int64_t d) {
+  return (a / d) * m + ((a % d) * m) / d;
+}
+
+// Exact conversions between the fixed-point formats and the float types
+inline int64_t toFixedLevel(double value) { return std::llround(value * kFixedLevelOne); }
+inline double fromFixedLevel(int64_t value) { return static_cast<double>(value) / kFixedLevelOne; }
+inline int64_t toFixedPosition(float value) { return std::llround(static_cast<double>(value) * kFixedPositionOne); }
+inline float fromFixedPosition(int64_t value) { return static_cast<float>(value) / kFixedPositionOne; }
+
+// n * Σd² - (Σd)², the variance times n², exact
+inline int64_t varianceNumerator(const background_detail::ClipSums& s) {
+  return s.count * s.sumD2 - s.sumD * s.sumD;
+}
+
+// Level (rounded) and stddev (floored) of the summed values, in 1/65536 ADU
+inline BackgroundStats fixedStats(const background_detail::ClipSums& s, int64_t pivot) {
+  if (s.count == 0) {
+    return BackgroundStats{0.0, 0.0};
+  }
+  const int64_t sum = pivot * s.count + s.sumD;
+  const int64_t level = (sum * kFixedLevelOne + s.count / 2) / s.count;
+  const int64_t variance = mulDiv(varianceNumerator(s) / s.count, kFixedLevelOne * kFixedLevelOne, s.count);
+  return BackgroundStats{fromFixedLevel(level), fromFixedLevel(static_cast<int64_t>(isqrt(variance)))};
+}
+
+// Threshold level + multiplier * stddev, in 1/65536 ADU
+inline int64_t fixedThreshold(const BackgroundStats& background, float multiplier) {
+  const int64_t scaledMultiplier = std::llround(static_cast<double>(multiplier) * kFixedLevelOne);
+  return toFixedLevel(background.level) + scaledMultiplier * toFixedLevel(background.stddev) / kFixedLevelOne;
+}
+
+}  // namespace fixed_point_detail
+
+// computeRobustBackground in integers: median, sigma clipping around it, then
+// the survivors' mean (rounded) and stddev (floored) to 1/65536 ADU
+inline BackgroundStats computeRobustBackgroundFixed(const uint16_t* values, size_t count) {
+  using namespace fixed_point_detail;
+  if (count == 0) {
+    return BackgroundStats{0.0, 0.0};
+  }
+
+  thread_local std::vector<uint16_t> scratch;
+  scratch.assign(values, values + count);
+  const size_t half = count / 2;
+  std::nth_element(scratch.begin(), scratch.begin() + half, scratch.end());
+  const int64_t highValue = scratch[half];
+  const int64_t lowValue = (count % 2 == 0) ? *std::max_element(scratch.begin(), scratch.begin() + half) : highValue;
+  const int64_t twiceMedian = lowValue + highValue;
+  const int64_t pivot = lowValue;
+
+  auto sumsOver = [&](int64_t first, int64_t last) {
+    background_detail::ClipSums s;
+    for (size_t i = 0; i < count; ++i) {
+      const int64_t v = values[i];
+      const int64_t inside = (v >= first) & (v <= last);
+      const int64_t d = (v - pivot) * inside;
+      s.count += inside;
+      s.sumD += d;
+      s.sumD2 += d * d;
+    }
+    return s;
+  };
+
+  // |2v - 2·median| <= 2·kClippingSigma·stddev, i.e. (2v - 2·median)² n² <= (2·kClippingSigma)² · variance numerator
+  int64_t first = 0;
+  int64_t last = 65535;
+  const background_detail::ClipSums all = sumsOver(first, last);
+  background_detail::ClipSums clipped = all;
+  for (int iteration = 0; iteration < kClippingMaxIterations; ++iteration) {
+    if (clipped.count == 0) break;
+    const int64_t numerator = varianceNumerator(clipped);
+    if (numerator <= 0) break;
+
+    const int64_t n = clipped.count;
+    const int64_t width = static_cast<int64_t>(
+        isqrt(mulDiv(numerator, 4 * kFixedClippingSigma * kFixedClippingSigma, n) / n));
+    if (twiceMedian - width > 0) first = std::max(first, (twiceMedian - width + 1) / 2);
+    last = std::min(last, (twiceMedian + width) / 2);
+    const background_detail::ClipSums next = first <= last ? sumsOver(first, last) : background_detail::ClipSums();
+    if (next.count == clipped.count) break;
+    clipped = next;
+  }
+
+  if (clipped.count == 0) {
+    // Fallback to the median and the stddev of all values, as computeRobustBackground
+    const BackgroundStats initial = fixedStats(all, pivot);
+    return BackgroundStats{fromFixedLevel(twiceMedian * kFixedLevelOne / 2), initial.stddev};
+  }
+  return fixedStats(clipped, pivot);
+}
+
+// computeBackgroundStats over the same cv::circle annulus, in fixed point
+inline BackgroundStats computeBackgroundStatsFixed(const cv::Mat& starRegion,
+                                                   const cv::Point2f& center,
+                                                   int minRadius = kMinBackgroundRadius,
+                                                   int maxRadius = kMaxBackgroundRadius) {
+  thread_local std::vector<uint16_t> backgroundValues;
+  const cv::Point anchor(cvRound(center.x), cvRound(center.y));
+  gatherAnnulusValues(starRegion, annulusTable(minRadius, maxRadius), anchor, backgroundValues);
+  return computeRobustBackgroundFixed(backgroundValues.data(), backgroundValues.size());
+}
+
+// computeCentroid in fixed point: the thresholded integer moments (any
+// SimdLevel gives the same sums) weighted by v - level in 1/65536 ADU, divided
+// to 1/65536 px
+inline cv::Point2f computeCentroidFixed(const cv::Mat& starRegion,
+                                        const BackgroundStats& background,
+                                        float backgroundStdDevMultiplier = kBackgroundSigmaThreshold,
+                                        SimdLevel level = activeSimdLevel()) {
+  using namespace fixed_point_detail;
+  const cv::Point2f center(starRegion.cols / 2.0f, starRegion.rows / 2.0f);
+  if (background.stddev <= 0.0) {
+    return center;
+  }
+
+  // v·65536 > max(threshold, level) for integer v
+  const int64_t levelQ = toFixedLevel(background.level);
+  const int64_t cutoff = std::max(fixedThreshold(background, backgroundStdDevMultiplier), levelQ);
+  const int64_t minSelected = cutoff < 0 ? 0 : cutoff / kFixedLevelOne + 1;
+  const CentroidMoments m = computeCentroidMoments(starRegion, static_cast<uint32_t>(std::min<int64_t>(minSelected, 65536)),
+                                                   level);
+
+  // Σw and Σw·(2x + 1) with w = v·65536 - level
+  const int64_t sumW = m.sumV * kFixedLevelOne - levelQ * m.count;
+  if (sumW <= 0) {
+    return center;
+  }
+  const int64_t sumWX = (2 * m.sumVX + m.sumV) * kFixedLevelOne - levelQ * (2 * m.sumX + m.count);
+  const int64_t sumWY = (2 * m.sumVY + m.sumV) * kFixedLevelOne - levelQ * (2 * m.sumY + m.count);
+  const int64_t halfOne = kFixedPositionOne / 2;
+  return cv::Point2f(fromFixedPosition(mulDiv(sumWX, halfOne, sumW)), fromFixedPosition(mulDiv(sumWY, halfOne, sumW)));
+}
+
+// computeHFDHistogram in fixed point: same aperture, threshold and radial
+// histogram, with the crossing bin's pixels walked in (r², flux) order and
+// the half-flux radius interpolated in 1/65536 px
+inline float computeHFDFixed(const cv::Mat& starRegion,
+                             const cv::Point2f& centroid,
+                             const BackgroundStats& background,
+                             double maxApertureRadius = kMaxApertureRadius,
+                             float backgroundStdDevMultiplier = kHFDBackgroundMultiplier,
+                             double* apertureFlux = nullptr) {
+  using namespace fixed_point_detail;
+  const int64_t threshold = fixedThreshold(background, backgroundStdDevMultiplier);
+  const int64_t cx = toFixedPosition(centroid.x);
+  const int64_t cy = toFixedPosition(centroid.y);
+  const int64_t maxRadius = std::llround(maxApertureRadius * kFixedPositionOne);
+  const int64_t maxRadiusSquared = maxRadius * maxRadius;
+
+  // Bins of r² as wide as a power of two, at least 1 px²
+  int binShift = 2 * kFixedPositionBits;
+  while ((maxRadiusSquared >> binShift) >= kHFDRadialBins - 1) ++binShift;
+  const int binCount = static_cast<int>(std::min<int64_t>(kHFDRadialBins, (maxRadiusSquared >> binShift) + 1));
+
+  int64_t binFlux[kHFDRadialBins];
+  int64_t binMaxRadiusSquared[kHFDRadialBins];
+  std::fill(binFlux, binFlux + binCount, 0);
+  std::fill(binMaxRadiusSquared, binMaxRadiusSquared + binCount, -1);
+
+  // Pass 1: radial histogram of flux
+  int64_t totalFlux = 0;
+  for (int y = 0; y < starRegion.rows; y++) {
+    const uint16_t* row = starRegion.ptr<uint16_t>(y);
+    const int64_t dy = y * kFixedPositionOne + kFixedPositionOne / 2 - cy;
+    const int64_t dy2 = dy * dy;
+    if (dy2 > maxRadiusSquared) continue;
+
+    for (int x = 0; x < starRegion.cols; x++) {
+      const int64_t pixel = row[x] * kFixedLevelOne - threshold;
+      if (pixel <= 0) continue;
+
+      const int64_t dx = x * kFixedPositionOne + kFixedPositionOne / 2 - cx;
+      const int64_t r2 = dx * dx + dy2;
+      if (r2 > maxRadiusSquared) continue;
+
+      const int bin = std::min(binCount - 1, static_cast<int>(r2 >> binShift));
+      totalFlux += pixel;
+      binFlux[bin] += pixel;
+      binMaxRadiusSquared[bin] = std::max(binMaxRadiusSquared[bin], r2);
+    }
+  }
+
+  if (apertureFlux) {
+    *apertureFlux = fromFixedLevel(totalFlux);
+  }
+  if (totalFlux <= 0) {
+    return 0.0f;
+  }
+
+  // Half flux reached when 2 · cumulative >= total
+  int64_t fluxBefore = 0;
+  int64_t previousDistance = 0;
+  int crossingBin = -1;
+  for (int bin = 0; bin < binCount; ++bin) {
+    if (binMaxRadiusSquared[bin] < 0) continue;
+    if (2 * (fluxBefore + binFlux[bin]) >= totalFlux) {
+      crossingBin = bin;
+      break;
+    }
+    fluxBefore += binFlux[bin];
+    previousDistance = static_cast<int64_t>(isqrt(binMaxRadiusSquared[bin]));
+  }
+  if (crossingBin < 0) {
+    return 0.0f;
+  }
+
+  // Pass 2: gather the crossing bin's pixels
+  std::pair<int64_t, int64_t> crossing[kHFDCrossingCapacity];  // (r², flux)
+  int crossingCount = 0;
+  bool overflow = false;
+  for (int y = 0; y < starRegion.rows && !overflow; y++) {
+    const uint16_t* row = starRegion.ptr<uint16_t>(y);
+    const int64_t dy = y * kFixedPositionOne + kFixedPositionOne / 2 - cy;
+    const int64_t dy2 = dy * dy;
+    if (dy2 > maxRadiusSquared) continue;
+    for (int x = 0; x < starRegion.cols; x++) {
+      const int64_t pixel = row[x] * kFixedLevelOne - threshold;
+      if (pixel <= 0) continue;
+
+      const int64_t dx = x * kFixedPositionOne + kFixedPositionOne / 2 - cx;
+      const int64_t r2 = dx * dx + dy2;
+      if (r2 > maxRadiusSquared || std::min(binCount - 1, static_cast<int>(r2 >> binShift)) != crossingBin) continue;
+
+      if (crossingCount == kHFDCrossingCapacity) {
+        overflow = true;
+        break;
+      }
+      crossing[crossingCount++] = {r2, pixel};
+    }
+  }
+
+  const int64_t needed = totalFlux - 2 * fluxBefore;  // Twice the flux still missing at the bin start
+  if (overflow) {
+    // Degenerate bin (huge aperture): interpolate across the bin by flux fraction
+    const int64_t low = static_cast<int64_t>(isqrt(static_cast<uint64_t>(crossingBin) << binShift));
+    const int64_t high = static_cast<int64_t>(
+        isqrt(std::min(maxRadiusSquared, static_cast<int64_t>(crossingBin + 1) << binShift)));
+    int64_t missing = needed;
+    int64_t binTotal = 2 * binFlux[crossingBin];
+    while (binTotal > (int64_t(1) << 31)) {  // Keep the product below 2^53
+      missing >>= 1;
+      binTotal >>= 1;
+    }
+    const int64_t hfr = low + (high - low) * missing / binTotal;
+    return fromFixedPosition(2 * hfr);
+  }
+
+  // Insertion sort of a handful of pixels, in (distance, flux) order as computeHFD
+  for (int i = 1; i < crossingCount; ++i) {
+    const auto item = crossing[i];
+    int j = i - 1;
+    while (j >= 0 && item < crossing[j]) {
+      crossing[j + 1] = crossing[j];
+      --j;
+    }
+    crossing[j + 1] = item;
+  }
+
+  int64_t cumulativeFlux = fluxBefore;
+  for (int i = 0; i < crossingCount; ++i) {
+    const int64_t distance = static_cast<int64_t>(isqrt(crossing[i].first));
+    const int64_t previousCumulativeFlux = cumulativeFlux;
+    cumulativeFlux += crossing[i].second;
+
+    if (2 * cumulativeFlux >= totalFlux) {
+      // Distances differ by at most the aperture radius (< 2^22), the flux term by 2 pixels (< 2^34)
+      const int64_t hfr = previousDistance + (distance - previousDistance) * (totalFlux - 2 * previousCumulativeFlux) /
+                                                 (2 * crossing[i].second);
+      return fromFixedPosition(2 * hfr);
+    }
+    previousDistance = distance;
+  }
+
+  return fromFixedPosition(2 * previousDistance);
+}
+
+// computeBackgroundAndCentroid in fixed point: annulus around the stamp
+// center, centroid, annulus around the centroid, centroid
+inline BackgroundAndCentroid computeBackgroundAndCentroidFixed(
+    const cv::Mat& starRegion,
+    float backgroundStdDevMultiplier = kBackgroundSigmaThreshold,
+    int minBackgroundRadius = kMinBackgroundRadius,
+    int maxBackgroundRadius = kMaxBackgroundRadius,
+    SimdLevel level = activeSimdLevel(),
+    const BackgroundStats* initialBackground = nullptr) {
+  const cv::Point2f initialCenter(starRegion.cols / 2.0f, starRegion.rows / 2.0f);
+  BackgroundStats background =
+      initialBackground ? *initialBackground
+                        : computeBackgroundStatsFixed(starRegion, initialCenter, minBackgroundRadius, maxBackgroundRadius);
+  cv::Point2f centroid = computeCentroidFixed(starRegion, background, backgroundStdDevMultiplier, level);
+
+  background = computeBackgroundStatsFixed(starRegion, centroid, minBackgroundRadius, maxBackgroundRadius);
+  centroid = computeCentroidFixed(starRegion, background, backgroundStdDevMultiplier, level);
+
+  return BackgroundAndCentroid{background, centroid};
+}
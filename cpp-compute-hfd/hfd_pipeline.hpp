@@ -0,0 +1,201 @@
+// Compile-time specialized single-star pipeline
+// Background, centroid and sort-free HFD instantiated per pixel type (8-bit
+// previews, 16-bit raws, 32-bit float calibrated frames) and per stamp
+// geometry known at compile time: constexpr radii and stamp size give fixed
+// loop trip counts, and the annulus scratch is a stack array sized from the
+// radii. measureStar picks the instantiation for a stamp at runtime.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <opencv2/core.hpp>
+
+#include "annulus_table.hpp"
+#include "background_estimator.hpp"
+#include "hfd_utils.hpp"
+
+// Stamp geometry fixed at compile time. StampSize = 0 keeps the radii constant
+// but takes the stamp size from the Mat (stamps clipped by the frame edge)
+template <int StampSize, int MinBackgroundRadius, int MaxBackgroundRadius, int ApertureRadius>
+struct StampGeometry {
+  static_assert(StampSize >= 0 && MinBackgroundRadius > 0 && MinBackgroundRadius < MaxBackgroundRadius,
+                "Annulus radii must satisfy 0 < min < max");
+  static_assert(ApertureRadius > 0, "Aperture radius must be positive");
+
+  static constexpr int kStampSize = StampSize;
+  static constexpr int kMinBackgroundRadius = MinBackgroundRadius;
+  static constexpr int kMaxBackgroundRadius = MaxBackgroundRadius;
+  static constexpr int kApertureRadius = ApertureRadius;
+
+  // Bound on the annulus pixel count: the bounding square of the outer circle
+  static constexpr size_t kMaxAnnulusPixels =
+      static_cast<size_t>(2 * MaxBackgroundRadius + 1) * (2 * MaxBackgroundRadius + 1);
+
+  using AnySize = StampGeometry<0, MinBackgroundRadius, MaxBackgroundRadius, ApertureRadius>;
+};
+
+// Geometries with compiled pipelines
+using StandardStampGeometry = StampGeometry<50, kMinBackgroundRadius, kMaxBackgroundRadius, 20>;  // findBrightestRegion / engine stamps
+using PreviewStampGeometry = StampGeometry<25, 10, 13, 10>;                                      // 2x2 binned previews
+using StampGeometries = std::tuple<StandardStampGeometry, PreviewStampGeometry>;
+
+static_assert(StandardStampGeometry::kApertureRadius == kMaxApertureRadius,
+              "Standard geometry must match the computeHFD defaults");
+
+struct StampHFD {
+  BackgroundStats background;
+  cv::Point2f centroid;
+  float hfd;                     // 0 if not measurable
+};
+
+namespace hfd_pipeline_detail {
+
+// computeRobustBackground over values sorted in place: the pixels surviving a
+// clip around the median are a contiguous range of the sorted values, so each
+// iteration only moves the range bounds
+inline BackgroundStats robustBackgroundSorted(double* values, size_t count) {
+  if (count == 0) {
+    return BackgroundStats{0.0, 0.0};
+  }
+  std::sort(values, values + count);
+  const double median = count % 2 == 0 ? (values[count / 2 - 1] + values[count / 2]) / 2.0 : values[count / 2];
+
+  auto meanAndStdDev = [values](size_t first, size_t last) {
+    double sum = 0.0;
+    for (size_t i = first; i < last; ++i) sum += values[i];
+    const double mean = sum / static_cast<double>(last - first);
+    double squares = 0.0;
+    for (size_t i = first; i < last; ++i) squares += (values[i] - mean) * (values[i] - mean);
+    return std::make_pair(mean, std::sqrt(squares / static_cast<double>(last - first)));
+  };
+
+  size_t first = 0;
+  size_t last = count;
+  for (int iteration = 0; iteration < kClippingMaxIterations && first < last; ++iteration) {
+    const double stddev = meanAndStdDev(first, last).second;
+    if (stddev <= 0.0) break;
+
+    const double lowerBound = median - kClippingSigma * stddev;
+    const double upperBound = median + kClippingSigma * stddev;
+    const size_t nextFirst = static_cast<size_t>(std::lower_bound(values + first, values + last, lowerBound) - values);
+    const size_t nextLast = static_cast<size_t>(std::upper_bound(values + nextFirst, values + last, upperBound) - values);
+    if (nextFirst == first && nextLast == last) break;
+    first = nextFirst;
+    last = nextLast;
+  }
+
+  if (first >= last) {
+    return BackgroundStats{median, meanAndStdDev(0, count).second};
+  }
+  const auto [mean, stddev] = meanAndStdDev(first, last);
+  return BackgroundStats{mean, stddev};
+}
+
+// computeBackgroundStats over the geometry's cv::circle annulus, gathered into
+// a stack array. Integer pixels take the linear-time estimator, float pixels
+// the in-place sorted one.
+template <typename Pixel, typename Geometry>
+BackgroundStats annulusBackground(const cv::Mat& stamp, const cv::Point2f& center) {
+  using Value = std::conditional_t<std::is_integral_v<Pixel>, uint16_t, double>;
+  std::array<Value, Geometry::kMaxAnnulusPixels> values;
+
+  const int rows = Geometry::kStampSize > 0 ? Geometry::kStampSize : stamp.rows;
+  const int cols = Geometry::kStampSize > 0 ? Geometry::kStampSize : stamp.cols;
+  const AnnulusTable& table = annulusTable(Geometry::kMinBackgroundRadius, Geometry::kMaxBackgroundRadius);
+  const cv::Point anchor(cvRound(center.x), cvRound(center.y));  // As cv::circle rounds its center
+
+  size_t count = 0;
+  for (const AnnulusSpan& span : table.spans) {
+    const int y = anchor.y + span.dy;
+    if (y < 0 || y >= rows) continue;
+    const int x0 = std::max(0, anchor.x + span.dx);
+    const int x1 = std::min(cols, anchor.x + span.dx + span.length);
+    const Pixel* row = stamp.ptr<Pixel>(y);
+    for (int x = x0; x < x1; ++x) {
+      values[count++] = static_cast<Value>(row[x]);
+    }
+  }
+
+  if constexpr (std::is_integral_v<Pixel>) {
+    return computeRobustBackgroundLinear(values.data(), count);
+  } else {
+    return robustBackgroundSorted(values.data(), count);
+  }
+}
+
+}  // namespace hfd_pipeline_detail
+
+// computeBackgroundAndCentroid + computeHFDHistogram for one pixel type and
+// geometry. The stamp must be Geometry::kStampSize square unless that is 0.
+// Same results as the generic functions: background level exact (stddev within
+// rounding), centroid and HFD within 1e-4 px.
+template <typename Pixel, typename Geometry>
+StampHFD measureStarStatic(const cv::Mat& stamp,
+                           float backgroundStdDevMultiplier = kBackgroundSigmaThreshold,
+                           float hfdBackgroundMultiplier = kHFDBackgroundMultiplier) {
+  using namespace hfd_pipeline_detail;
+  constexpr int kSize = Geometry::kStampSize;
+
+  // First pass around the stamp center, second around the measured centroid
+  const cv::Point2f initialCenter((kSize > 0 ? kSize : stamp.cols) / 2.0f, (kSize > 0 ? kSize : stamp.rows) / 2.0f);
+  BackgroundStats background = annulusBackground<Pixel, Geometry>(stamp, initialCenter);
+  cv::Point2f centroid = hfd_detail::thresholdedCentroid<Pixel, kSize>(stamp, background, backgroundStdDevMultiplier);
+  background = annulusBackground<Pixel, Geometry>(stamp, centroid);
+  centroid = hfd_detail::thresholdedCentroid<Pixel, kSize>(stamp, background, backgroundStdDevMultiplier);
+
+  const float hfd = hfd_detail::histogramHFD<Pixel, kSize>(stamp, centroid, background, Geometry::kApertureRadius,
+                                                           hfdBackgroundMultiplier, nullptr);
+  return StampHFD{background, centroid, hfd};
+}
+
+// Dispatch on the stamp's pixel type: the fixed-size instantiation for
+// Geometry::kStampSize square stamps, the any-size one otherwise
+template <typename Geometry = StandardStampGeometry>
+StampHFD measureStar(const cv::Mat& stamp) {
+  return dispatchPixelType(stamp, [&](auto pixelType) {
+    using Pixel = decltype(pixelType);
+    if (stamp.cols == Geometry::kStampSize && stamp.rows == Geometry::kStampSize) {
+      return measureStarStatic<Pixel, Geometry>(stamp);
+    }
+    return measureStarStatic<Pixel, typename Geometry::AnySize>(stamp);
+  });
+}
+
+// Runtime radii: the compiled geometry with these radii if there is one in
+// StampGeometries, else the generic functions
+inline StampHFD measureStar(const cv::Mat& stamp,
+                            int minBackgroundRadius,
+                            int maxBackgroundRadius,
+                            double maxApertureRadius) {
+  StampHFD result;
+  const bool compiled = std::apply([&](auto... geometries) {
+    auto tryGeometry = [&](auto geometry) {
+      using Geometry = decltype(geometry);
+      if (minBackgroundRadius != Geometry::kMinBackgroundRadius ||
+          maxBackgroundRadius != Geometry::kMaxBackgroundRadius ||
+          maxApertureRadius != Geometry::kApertureRadius) {
+        return false;
+      }
+      result = measureStar<Geometry>(stamp);
+      return true;
+    };
+    return (tryGeometry(geometries) || ...);
+  }, StampGeometries());
+  if (compiled) {
+    return result;
+  }
+
+  const BackgroundAndCentroid bc =
+      computeBackgroundAndCentroid(stamp, kBackgroundSigmaThreshold, minBackgroundRadius, maxBackgroundRadius);
+  result.background = bc.background;
+  result.centroid = bc.centroid;
+  result.hfd = computeHFDHistogram(stamp, bc.centroid, bc.background, maxApertureRadius);
+  return result;
+}
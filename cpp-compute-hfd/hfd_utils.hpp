@@ -6,7 +6,9 @@
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <numeric>
+#include <type_traits>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 
@@ -19,6 +21,10 @@ constexpr int    kMaxBackgroundRadius = 25;          // Maximum radius for backg
 constexpr double kMaxApertureRadius = 20.0;          // Maximum aperture radius for HFD (pixels)
 constexpr float  kHFDBackgroundMultiplier = 0.0f;    // Background stddev multiplier for HFD (0 = level only)
 
+// Sort-free HFD kernel parameters
+constexpr int    kHFDRadialBins = 1024;              // Radial bins over r^2 (unit width up to r = 32 px)
+constexpr int    kHFDCrossingCapacity = 256;         // Pixels kept from the half-flux bin for exact interpolation
+
 // Sigma clipping parameters (for robust background estimation)
 constexpr double kClippingSigma = 3.0;               // Sigma clipping threshold
 constexpr int    kClippingMaxIterations = 5;         // Maximum sigma clipping iterations
@@ -34,6 +40,25 @@ struct BackgroundAndCentroid {
   cv::Point2f centroid;
 };
 
+// Pixel types the kernels are instantiated for: 8-bit previews, 16-bit raw
+// frames and 32-bit float calibrated frames
+template <typename Pixel> struct PixelDepth;
+template <> struct PixelDepth<uint8_t> { static constexpr int value = CV_8U; };
+template <> struct PixelDepth<uint16_t> { static constexpr int value = CV_16U; };
+template <> struct PixelDepth<float> { static constexpr int value = CV_32F; };
+
+// Call fn(Pixel()) with the pixel type of a single-channel image, once per
+// call rather than per pixel
+template <typename Fn>
+decltype(auto) dispatchPixelType(const cv::Mat& image, Fn&& fn) {
+  switch (image.depth()) {
+    case CV_8U: return fn(uint8_t());
+    case CV_16U: return fn(uint16_t());
+    case CV_32F: return fn(float());
+    default: CV_Error(cv::Error::StsUnsupportedFormat, "HFD kernels take CV_8U, CV_16U or CV_32F images");
+  }
+}
+
 // Compute mean and standard deviation of a vector
 inline std::pair<double, double> calculateMeanAndStdDev(const std::vector<double>& data) {
   if (data.empty()) {
@@ -116,6 +141,34 @@ inline std::vector<double> computeSigmaClipping(const std::vector<double>& data,
   return clippedData;
 }
 
+// Robust background level and noise from annulus pixel values
+// Median, then sigma clipping around it, then mean/stddev of what survives
+inline BackgroundStats computeRobustBackground(const std::vector<double>& backgroundPixels) {
+  if (backgroundPixels.empty()) {
+    return BackgroundStats{0.0, 0.0};
+  }
+
+  // Compute median for background level
+  const double backgroundLevel = computeMedian(backgroundPixels);
+
+  // Robust sigma clipping around the median
+  // This removes hot pixels / nearby faint stars from the background annulus
+  const std::vector<double> clippedPixels = computeSigmaClipping(
+      backgroundPixels, backgroundLevel, kClippingSigma, kClippingMaxIterations);
+
+  if (clippedPixels.empty()) {
+    // Fallback to initial statistics if all pixels were clipped
+    const auto initialStats = calculateMeanAndStdDev(backgroundPixels);
+    return BackgroundStats{backgroundLevel, initialStats.second};
+  }
+
+  // Compute final mean and standard deviation from clipped data
+  const auto clippedStats = calculateMeanAndStdDev(clippedPixels);
+
+  // Use mean after robust estimation
+  return BackgroundStats{clippedStats.first, clippedStats.second};
+}
+
 // Compute background statistics from circular annulus beyond star PSF
 // Samples pixels in annulus at radius [minRadius, maxRadius] from center
 inline BackgroundStats computeBackgroundStats(const cv::Mat& starRegion,
@@ -138,37 +191,30 @@ inline BackgroundStats computeBackgroundStats(const cv::Mat& starRegion,
   // Collect pixel values at mask locations
   std::vector<double> backgroundPixels;
   backgroundPixels.reserve(locations.size());
-  for (const auto& pt : locations) {
-    backgroundPixels.push_back(static_cast<double>(starRegion.at<uint16_t>(pt)));
-  }
-
-  // Compute median for background level
-  const double backgroundLevel = computeMedian(backgroundPixels);
-
-  // Robust sigma clipping around the median
-  // This removes hot pixels / nearby faint stars from the background annulus
-  const std::vector<double> clippedPixels = computeSigmaClipping(
-      backgroundPixels, backgroundLevel, kClippingSigma, kClippingMaxIterations);
+  dispatchPixelType(starRegion, [&](auto pixelType) {
+    using Pixel = decltype(pixelType);
+    for (const auto& pt : locations) {
+      backgroundPixels.push_back(static_cast<double>(starRegion.at<Pixel>(pt)));
+    }
+  });
 
-  if (clippedPixels.empty()) {
-    // Fallback to initial statistics if all pixels were clipped
-    const auto initialStats = calculateMeanAndStdDev(backgroundPixels);
-    return BackgroundStats{backgroundLevel, initialStats.second};
-  }
+  return computeRobustBackground(backgroundPixels);
+}
 
-  // Compute final mean and standard deviation from clipped data
-  const auto clippedStats = calculateMeanAndStdDev(clippedPixels);
+namespace hfd_detail {
 
-  // Use mean after robust estimation
-  return BackgroundStats{clippedStats.first, clippedStats.second};
-}
+// Kernels templated on the pixel type and, for fixed-size stamps, on the stamp
+// size (0 = take it from the Mat): with constant trip counts the compiler
+// unrolls and vectorizes the row loops. The public functions below dispatch
+// to the FixedSize = 0 instantiations; hfd_pipeline.hpp to the fixed ones.
 
-// Compute intensity-weighted centroid using pixels above threshold
-inline cv::Point2f computeCentroid(const cv::Mat& starRegion,
-                                    const BackgroundStats& background,
-                                    float backgroundStdDevMultiplier = kBackgroundSigmaThreshold) {
+template <typename Pixel, int FixedSize = 0>
+cv::Point2f thresholdedCentroid(const cv::Mat& starRegion, const BackgroundStats& background,
+                                float backgroundStdDevMultiplier) {
+  const int rows = FixedSize > 0 ? FixedSize : starRegion.rows;
+  const int cols = FixedSize > 0 ? FixedSize : starRegion.cols;
   if (background.stddev <= 0.0) {
-    return cv::Point2f(starRegion.cols / 2.0f, starRegion.rows / 2.0f);
+    return cv::Point2f(cols / 2.0f, rows / 2.0f);
   }
 
   const double threshold = background.level + backgroundStdDevMultiplier * background.stddev;
@@ -177,9 +223,10 @@ inline cv::Point2f computeCentroid(const cv::Mat& starRegion,
   double sumX = 0.0;
   double sumY = 0.0;
 
-  for (int y = 0; y < starRegion.rows; y++) {
-    for (int x = 0; x < starRegion.cols; x++) {
-      double val = starRegion.at<uint16_t>(y, x);
+  for (int y = 0; y < rows; y++) {
+    const Pixel* row = starRegion.ptr<Pixel>(y);
+    for (int x = 0; x < cols; x++) {
+      double val = row[x];
       if (val > threshold) {
         double weight = val - background.level;
         if (weight > 0.0) {
@@ -192,48 +239,223 @@ inline cv::Point2f computeCentroid(const cv::Mat& starRegion,
   }
 
   if (sumIntensity <= 0.0) {
-    return cv::Point2f(starRegion.cols / 2.0f, starRegion.rows / 2.0f);
+    return cv::Point2f(cols / 2.0f, rows / 2.0f);
   }
 
   return cv::Point2f(static_cast<float>(sumX / sumIntensity),
                      static_cast<float>(sumY / sumIntensity));
 }
 
+// Receives the aperture pixels of the HFD pass, so other per-pixel statistics
+// (psf_shape.hpp) can share it; this one compiles away. Sinks with
+// kAllPixels also get the pixels at or below the threshold.
+struct NoPixelSink {
+  static constexpr bool kAllPixels = false;
+  void add(float, double, double, double) {}
+};
+
+// Sort-free HFD kernel behind computeHFDHistogram. sink.add(flux, dx, dy, r2)
+// is called for each pixel inside the aperture that passes the threshold (or
+// all of them, see NoPixelSink), with its offset from the centroid
+template <typename Pixel, int FixedSize = 0, typename PixelSink = NoPixelSink>
+float histogramHFD(const cv::Mat& starRegion, const cv::Point2f& centroid, const BackgroundStats& background,
+                   double maxApertureRadius, float backgroundStdDevMultiplier, double* apertureFlux,
+                   PixelSink&& sink = PixelSink()) {
+  constexpr bool kSinkAllPixels = std::decay_t<PixelSink>::kAllPixels;
+
+  // Match computeHFD, which subtracts the threshold in float precision
+  const float backgroundThreshold =
+      static_cast<float>(background.level + backgroundStdDevMultiplier * background.stddev);
+
+  const double maxRadiusSquared = maxApertureRadius * maxApertureRadius;
+  const double binWidth = std::max(1.0, maxRadiusSquared / (kHFDRadialBins - 1));
+  const double inverseBinWidth = 1.0 / binWidth;
+  const int binCount = std::min(kHFDRadialBins, static_cast<int>(maxRadiusSquared * inverseBinWidth) + 1);
+
+  double binFlux[kHFDRadialBins];
+  float binMaxRadiusSquared[kHFDRadialBins];
+  std::fill(binFlux, binFlux + binCount, 0.0);
+  std::fill(binMaxRadiusSquared, binMaxRadiusSquared + binCount, -1.0f);
+
+  const int rows = FixedSize > 0 ? FixedSize : starRegion.rows;
+  const int cols = FixedSize > 0 ? FixedSize : starRegion.cols;
+
+  // Pass 1: radial histogram of flux
+  double totalFlux = 0.0;
+  for (int y = 0; y < rows; y++) {
+    const Pixel* row = starRegion.ptr<Pixel>(y);
+    const double dy = (y + 0.5) - centroid.y;
+    const double dy2 = dy * dy;
+    if (dy2 > maxRadiusSquared) continue;
+
+    for (int x = 0; x < cols; x++) {
+      const float pixel = static_cast<float>(row[x]) - backgroundThreshold;
+      if (!kSinkAllPixels && pixel <= 0.0f) continue;
+
+      const double dx = (x + 0.5) - centroid.x;
+      const double r2 = dx * dx + dy2;
+      if (r2 > maxRadiusSquared) continue;
+
+      sink.add(pixel, dx, dy, r2);
+      if (kSinkAllPixels && pixel <= 0.0f) continue;
+
+      const int bin = std::min(binCount - 1, static_cast<int>(r2 * inverseBinWidth));
+      totalFlux += pixel;
+      binFlux[bin] += pixel;
+      binMaxRadiusSquared[bin] = std::max(binMaxRadiusSquared[bin], static_cast<float>(r2));
+    }
+  }
+
+  if (apertureFlux) {
+    *apertureFlux = totalFlux;
+  }
+  if (totalFlux <= 0.0) {
+    return 0.0f;
+  }
+
+  const double halfFlux = totalFlux / 2.0;
+
+  // Locate the crossing bin and the last non-empty bin before it
+  double fluxBefore = 0.0;
+  double previousDistance = 0.0;
+  int crossingBin = -1;
+  for (int bin = 0; bin < binCount; ++bin) {
+    if (binMaxRadiusSquared[bin] < 0.0f) continue;
+    if (fluxBefore + binFlux[bin] >= halfFlux) {
+      crossingBin = bin;
+      break;
+    }
+    fluxBefore += binFlux[bin];
+    previousDistance = std::sqrt(static_cast<double>(binMaxRadiusSquared[bin]));
+  }
+  if (crossingBin < 0) {
+    return 0.0f;
+  }
+
+  // Pass 2: gather the crossing bin's pixels, visiting only rows that can reach it
+  const double binLow = crossingBin * binWidth;
+  const double binHigh = std::min(maxRadiusSquared, (crossingBin + 1) * binWidth);
+  std::pair<double, float> crossing[kHFDCrossingCapacity];  // (distance^2, flux)
+  int crossingCount = 0;
+  bool overflow = false;
+
+  const double reach = std::sqrt(binHigh);
+  const int yFirst = std::max(0, static_cast<int>(std::floor(centroid.y - reach - 0.5)));
+  const int yLast = std::min(rows - 1, static_cast<int>(std::ceil(centroid.y + reach - 0.5)));
+  for (int y = yFirst; y <= yLast && !overflow; y++) {
+    const Pixel* row = starRegion.ptr<Pixel>(y);
+    const double dy = (y + 0.5) - centroid.y;
+    const double dy2 = dy * dy;
+    for (int x = 0; x < cols; x++) {
+      const float pixel = static_cast<float>(row[x]) - backgroundThreshold;
+      if (pixel <= 0.0f) continue;
+
+      const double dx = (x + 0.5) - centroid.x;
+      const double r2 = dx * dx + dy2;
+      if (r2 > maxRadiusSquared) continue;
+      if (std::min(binCount - 1, static_cast<int>(r2 * inverseBinWidth)) != crossingBin) continue;
+
+      if (crossingCount == kHFDCrossingCapacity) {
+        overflow = true;
+        break;
+      }
+      crossing[crossingCount++] = {r2, pixel};
+    }
+  }
+
+  if (overflow) {
+    // Degenerate bin (huge aperture): interpolate across the bin by flux fraction
+    const double fraction = (halfFlux - fluxBefore) / binFlux[crossingBin];
+    const double hfr = std::sqrt(binLow) + fraction * (std::sqrt(binHigh) - std::sqrt(binLow));
+    return static_cast<float>(hfr * 2.0f);
+  }
+
+  // Insertion sort of a handful of pixels, in the same (distance, flux) order as computeHFD
+  for (int i = 1; i < crossingCount; ++i) {
+    const auto item = crossing[i];
+    int j = i - 1;
+    while (j >= 0 && item < crossing[j]) {
+      crossing[j + 1] = crossing[j];
+      --j;
+    }
+    crossing[j + 1] = item;
+  }
+
+  double cumulativeFlux = fluxBefore;
+  double previousCumulativeFlux = fluxBefore;
+  for (int i = 0; i < crossingCount; ++i) {
+    const double dist = std::sqrt(crossing[i].first);
+    cumulativeFlux += crossing[i].second;
+
+    if (cumulativeFlux >= halfFlux) {
+      double crossingFlux = cumulativeFlux - previousCumulativeFlux;
+      double fraction = crossingFlux > 0.0 ? (halfFlux - previousCumulativeFlux) / crossingFlux : 0.0;
+
+      double hfr = previousDistance + fraction * (dist - previousDistance);
+      return static_cast<float>(hfr * 2.0f);  // Return diameter (HFD = 2 × HFR)
+    }
+
+    previousCumulativeFlux = cumulativeFlux;
+    previousDistance = dist;
+  }
+
+  // Summation-order rounding put the crossing at the very end of the bin
+  return static_cast<float>(previousDistance * 2.0f);
+}
+
+}  // namespace hfd_detail
+
+// Compute intensity-weighted centroid using pixels above threshold
+inline cv::Point2f computeCentroid(const cv::Mat& starRegion,
+                                    const BackgroundStats& background,
+                                    float backgroundStdDevMultiplier = kBackgroundSigmaThreshold) {
+  return dispatchPixelType(starRegion, [&](auto pixelType) {
+    return hfd_detail::thresholdedCentroid<decltype(pixelType)>(starRegion, background, backgroundStdDevMultiplier);
+  });
+}
+
 // Compute HFD (Half-Flux Diameter) using pixel-by-pixel method
 // Diameter of circle containing 50% of total flux
+// If apertureFlux is given it receives the total flux inside the aperture.
 inline float computeHFD(const cv::Mat& starRegion,
                         const cv::Point2f& centroid,
                         const BackgroundStats& background,
                         double maxApertureRadius = kMaxApertureRadius,
-                        float backgroundStdDevMultiplier = kHFDBackgroundMultiplier) {
+                        float backgroundStdDevMultiplier = kHFDBackgroundMultiplier,
+                        double* apertureFlux = nullptr) {
 
   double backgroundThreshold = background.level + backgroundStdDevMultiplier * background.stddev;
 
-  // Background-subtract the image
-  cv::Mat floatMat;
-  starRegion.convertTo(floatMat, CV_32FC1);
-  floatMat -= static_cast<float>(backgroundThreshold);
+  // Background-subtract in float precision while reading the stamp, without a float copy of it
+  const float threshold = static_cast<float>(backgroundThreshold);
 
   // Collect all pixels within maxApertureRadius aperture
   double totalFlux = 0.0;
   std::vector<std::pair<double, float>> pixelsByDistance;  // (distance, flux)
 
-  for (int y = 0; y < floatMat.rows; y++) {
-    for (int x = 0; x < floatMat.cols; x++) {
-      float pixel = floatMat.at<float>(y, x);
-      if (pixel <= 0.0f) continue;  // Skip negative/zero pixels
-
-      double dx = (x + 0.5) - centroid.x;
-      double dy = (y + 0.5) - centroid.y;
-      double dist = std::sqrt(dx * dx + dy * dy);
-
-      if (dist <= maxApertureRadius) {
-        totalFlux += pixel;
-        pixelsByDistance.push_back({dist, pixel});
+  dispatchPixelType(starRegion, [&](auto pixelType) {
+    using Pixel = decltype(pixelType);
+    for (int y = 0; y < starRegion.rows; y++) {
+      const Pixel* row = starRegion.ptr<Pixel>(y);
+      for (int x = 0; x < starRegion.cols; x++) {
+        float pixel = static_cast<float>(row[x]) - threshold;
+        if (pixel <= 0.0f) continue;  // Skip negative/zero pixels
+
+        double dx = (x + 0.5) - centroid.x;
+        double dy = (y + 0.5) - centroid.y;
+        double dist = std::sqrt(dx * dx + dy * dy);
+
+        if (dist <= maxApertureRadius) {
+          totalFlux += pixel;
+          pixelsByDistance.push_back({dist, pixel});
+        }
       }
     }
-  }
+  });
 
+  if (apertureFlux) {
+    *apertureFlux = totalFlux;
+  }
   if (totalFlux <= 0.0) {
     return 0.0f;
   }
@@ -267,6 +489,27 @@ inline float computeHFD(const cv::Mat& starRegion,
   return 0.0f;
 }
 
+// Compute HFD without sorting or heap allocation
+// Same result as computeHFD to within floating-point summation order (|ΔHFD| < 1e-4 px):
+//   1. Bin background-subtracted flux by squared distance (no per-pixel sqrt),
+//      recording the largest r^2 seen in each bin
+//   2. Find the bin where cumulative flux crosses half the total
+//   3. Re-gather only that bin's pixels (a thin annulus, a few pixels) and walk
+//      them in distance order, interpolating exactly as computeHFD does
+// Works directly on the stamp's pixels; all scratch lives on the stack.
+// If apertureFlux is given it receives the total flux inside the aperture.
+inline float computeHFDHistogram(const cv::Mat& starRegion,
+                                 const cv::Point2f& centroid,
+                                 const BackgroundStats& background,
+                                 double maxApertureRadius = kMaxApertureRadius,
+                                 float backgroundStdDevMultiplier = kHFDBackgroundMultiplier,
+                                 double* apertureFlux = nullptr) {
+  return dispatchPixelType(starRegion, [&](auto pixelType) {
+    return hfd_detail::histogramHFD<decltype(pixelType)>(starRegion, centroid, background, maxApertureRadius,
+                                                         backgroundStdDevMultiplier, apertureFlux);
+  });
+}
+
 // Compute background and centroid with iterative refinement
 // First pass around region center, second pass around measured centroid
 inline BackgroundAndCentroid computeBackgroundAndCentroid(
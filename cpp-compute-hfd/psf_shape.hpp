@@ -0,0 +1,189 @@
+// PSF shape (FWHM, ellipticity, position angle) fused with the HFD pass
+// Second-order moments of the background-subtracted star are accumulated in
+// computeHFDHistogram's pixel loop, so tilt and tracking errors show up
+// without a second pass over the stamp and without allocation.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core.hpp>
+
+#include "hfd_utils.hpp"
+
+// Shape measurement parameters
+constexpr double kShapeRadiusPerHFD = 2.0;                    // Moments taken inside this many HFDs (~4.7 sigma)
+constexpr double kShapeBinWidth = 4.0;                        // Radial moment bin width (pixels²)
+constexpr int    kShapeRadialBins = 256;                      // Bins up to r = 32 px, as kHFDRadialBins
+constexpr double kFWHMPerSigma = 2.3548200450309493;          // Gaussian FWHM / sigma, 2·sqrt(2 ln 2)
+constexpr double kArcSecondsPerRadian = 206264.80624709636;
+
+struct PSFShape {
+  double xx = 0.0;               // Second central moments (pixels²), corrected for the radius cut
+  double yy = 0.0;
+  double xy = 0.0;
+  float fwhm = 0.0f;             // Gaussian FWHM over the geometric mean of the axes (pixels), 0 if not measurable
+  float semiMajorAxis = 0.0f;    // Semi-axes of the half-maximum ellipse (pixels)
+  float semiMinorAxis = 0.0f;
+  float ellipticity = 0.0f;      // 1 - minor / major
+  float positionAngle = 0.0f;    // Major axis from +x towards +y (radians, -π/2..π/2)
+};
+
+// The shape fields of MatchedStar (cpp-sensorpackage/flatbuffers/PlateSolveResult.fbs)
+struct PSFShapeArcSeconds {
+  double fullWidthHalfMax;
+  double semiMajorAxisLength;
+  double semiMinorAxisLength;
+};
+
+namespace psf_shape_detail {
+
+struct MomentSums {
+  double sum = 0.0;
+  double sumX = 0.0;
+  double sumY = 0.0;
+  double sumXX = 0.0;
+  double sumYY = 0.0;
+  double sumXY = 0.0;
+};
+
+// Moments of every aperture pixel, weighted by its value above the background
+// level and binned by squared radius. Noise pixels below the level are kept,
+// so the noise cancels instead of widening the star; the radius the moments
+// are taken to is picked from the HFD after the pass.
+struct RadialMoments {
+  static constexpr bool kAllPixels = true;
+
+  explicit RadialMoments(double maxRadiusSquared, double thresholdAboveLevel)
+      : binCount(std::min(kShapeRadialBins, static_cast<int>(maxRadiusSquared / kShapeBinWidth) + 1)),
+        offset(thresholdAboveLevel) {
+    std::fill(bins, bins + binCount, MomentSums());
+  }
+
+  void add(float pixel, double dx, double dy, double r2) {
+    const double w = pixel + offset;
+    MomentSums& b = bins[std::min(binCount - 1, static_cast<int>(r2 * (1.0 / kShapeBinWidth)))];
+    const double wx = w * dx;
+    const double wy = w * dy;
+    b.sum += w;
+    b.sumX += wx;
+    b.sumY += wy;
+    b.sumXX += wx * dx;
+    b.sumYY += wy * dy;
+    b.sumXY += wx * dy;
+  }
+
+  int binCount;
+  double offset;                 // HFD threshold - background level
+  MomentSums bins[kShapeRadialBins];
+};
+
+// Cutting a Gaussian off at radius R shrinks its second moments by
+// (1 - q(1 - ln q)) / (1 - q), q = exp(-R² / 2σ²)
+inline double truncatedMomentFraction(double q) {
+  if (!(q > 0.0)) return 1.0;
+  if (q >= 1.0) return 0.0;
+  return (1.0 - q * (1.0 - std::log(q))) / (1.0 - q);
+}
+
+inline PSFShape shapeFromMoments(const RadialMoments& moments, float hfd) {
+  PSFShape shape;
+  if (!(hfd > 0.0f)) return shape;
+
+  // Whole bins inside the shape radius
+  const double radius = kShapeRadiusPerHFD * hfd;
+  const int lastBin = std::min(moments.binCount, static_cast<int>(radius * radius / kShapeBinWidth));
+  MomentSums m;
+  for (int bin = 0; bin < lastBin; ++bin) {
+    const MomentSums& b = moments.bins[bin];
+    m.sum += b.sum;
+    m.sumX += b.sumX;
+    m.sumY += b.sumY;
+    m.sumXX += b.sumXX;
+    m.sumYY += b.sumYY;
+    m.sumXY += b.sumXY;
+  }
+  if (m.sum <= 0.0) return shape;
+
+  const double meanX = m.sumX / m.sum;
+  const double meanY = m.sumY / m.sum;
+  double xx = m.sumXX / m.sum - meanX * meanX;
+  double yy = m.sumYY / m.sum - meanY * meanY;
+  double xy = m.sumXY / m.sum - meanX * meanY;
+
+  // Undo the radius cut, with the Gaussian sigma of the uncut moments
+  const double cutRadiusSquared = lastBin * kShapeBinWidth;
+  double fraction = 1.0;
+  for (int iteration = 0; iteration < 2; ++iteration) {
+    const double sigma2 = 0.5 * (xx + yy) / fraction;
+    if (!(sigma2 > 0.0)) return shape;
+    fraction = truncatedMomentFraction(std::exp(-cutRadiusSquared / (2.0 * sigma2)));
+  }
+  if (!(fraction > 0.0)) return shape;
+  shape.xx = xx /= fraction;
+  shape.yy = yy /= fraction;
+  shape.xy = xy /= fraction;
+
+  // Principal axes: eigenvalues of the moment matrix are the squared sigmas
+  const double mean = 0.5 * (xx + yy);
+  const double spread = std::sqrt(0.25 * (xx - yy) * (xx - yy) + xy * xy);
+  const double major = mean + spread;
+  const double minor = mean - spread;
+  if (!(minor > 0.0)) return shape;
+
+  const double sigmaMajor = std::sqrt(major);
+  const double sigmaMinor = std::sqrt(minor);
+  shape.fwhm = static_cast<float>(kFWHMPerSigma * std::sqrt(sigmaMajor * sigmaMinor));
+  shape.semiMajorAxis = static_cast<float>(0.5 * kFWHMPerSigma * sigmaMajor);
+  shape.semiMinorAxis = static_cast<float>(0.5 * kFWHMPerSigma * sigmaMinor);
+  shape.ellipticity = static_cast<float>(1.0 - sigmaMinor / sigmaMajor);
+  shape.positionAngle = static_cast<float>(0.5 * std::atan2(2.0 * xy, xx - yy));
+  return shape;
+}
+
+}  // namespace psf_shape_detail
+
+// computeHFDHistogram that also measures the PSF shape in the same pixel loop.
+// Second moments are taken inside kShapeRadiusPerHFD HFDs of the centroid and
+// corrected for that cut as for a Gaussian; all scratch is on the stack.
+inline float computeHFDAndShape(const cv::Mat& starRegion,
+                                const cv::Point2f& centroid,
+                                const BackgroundStats& background,
+                                PSFShape& shape,
+                                double maxApertureRadius = kMaxApertureRadius,
+                                float backgroundStdDevMultiplier = kHFDBackgroundMultiplier,
+                                double* apertureFlux = nullptr) {
+  const float hfdThreshold = static_cast<float>(background.level + backgroundStdDevMultiplier * background.stddev);
+  psf_shape_detail::RadialMoments moments(maxApertureRadius * maxApertureRadius,
+                                          static_cast<double>(hfdThreshold) - background.level);
+
+  const float hfd = dispatchPixelType(starRegion, [&](auto pixelType) {
+    return hfd_detail::histogramHFD<decltype(pixelType)>(starRegion, centroid, background, maxApertureRadius,
+                                                         backgroundStdDevMultiplier, apertureFlux, moments);
+  });
+  shape = psf_shape_detail::shapeFromMoments(moments, hfd);
+  return hfd;
+}
+
+// Shape alone, for stamps measured with another HFD kernel
+inline PSFShape computePSFShape(const cv::Mat& starRegion,
+                                const cv::Point2f& centroid,
+                                const BackgroundStats& background,
+                                double maxApertureRadius = kMaxApertureRadius) {
+  PSFShape shape;
+  computeHFDAndShape(starRegion, centroid, background, shape, maxApertureRadius);
+  return shape;
+}
+
+// Plate scale from the camera pixel size and the focal length
+inline double arcSecondsPerPixel(double pixelSizeMicrons, double focalLengthMillimeters) {
+  return kArcSecondsPerRadian * pixelSizeMicrons * 1e-3 / focalLengthMillimeters;
+}
+
+// fullWidthHalfMaxArcSeconds, semiMajorAxisLengthArcSeconds and
+// semiMinorAxisLengthArcSeconds of a MatchedStar
+inline PSFShapeArcSeconds toArcSeconds(const PSFShape& shape, double plateScale) {
+  return PSFShapeArcSeconds{shape.fwhm * plateScale, shape.semiMajorAxis * plateScale,
+                            shape.semiMinorAxis * plateScale};
+}
@@ -0,0 +1,275 @@
+// Single-pass connected-component star detector
+// Labels 8-connected pixels above a background map threshold in one raster
+// pass, keeping only the runs of the previous and current row, and emits one
+// candidate window per star for the HFD pipeline.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "background_map.hpp"
+#include "thread_pool.hpp"
+
+// Component detection parameters
+constexpr double kComponentSigma = 5.0;               // Pixel threshold above the background map (sigma)
+constexpr int    kMinStarArea = 3;                    // Smaller blobs are hot pixels (pixels)
+constexpr int    kMaxStarArea = 4096;                 // Larger blobs are nebulae, trails or clouds (pixels)
+constexpr uint16_t kSaturationLevel = 65000;          // Pixels at or above this are saturated (ADU)
+constexpr float  kMaxPeakFluxFraction = 0.6f;         // Sharper blobs are hot pixels / cosmic rays
+constexpr int    kRowsPerComponentTask = 64;          // Frame rows per detection task
+
+struct StarDetectorConfig {
+  double sigma = kComponentSigma;
+  int minArea = kMinStarArea;
+  int maxArea = kMaxStarArea;
+  uint16_t saturationLevel = kSaturationLevel;
+  float maxPeakFluxFraction = kMaxPeakFluxFraction;
+};
+
+struct DetectedStar {
+  cv::Rect bounds;               // Bounding box of the component
+  cv::Point peak;                // Brightest pixel
+  uint16_t peakValue;
+  cv::Point2f centroid;          // Flux-weighted, pixel centers at +0.5
+  float flux;                    // Σ (value - local background level)
+  int area;                      // Pixels above threshold
+};
+
+struct StarDetection {
+  std::vector<DetectedStar> stars;   // Raster order of the first row of each star
+  size_t rejectedSaturated = 0;
+  size_t rejectedHotPixels = 0;      // Too small or too sharp
+  size_t rejectedSize = 0;           // Too large
+};
+
+namespace star_detector_detail {
+
+// Horizontal run of above-threshold pixels, inclusive bounds
+struct Run {
+  int xBegin;
+  int xEnd;
+  int label;
+};
+
+struct Component {
+  int top;
+  int bottom;
+  int left;
+  int right;
+  int area = 0;
+  int saturated = 0;
+  double flux = 0.0;
+  double sumX = 0.0;             // Σ flux · (x + 0.5)
+  double sumY = 0.0;
+  uint16_t peakValue = 0;
+  float peakFlux = 0.0f;         // Peak value above the local background
+  cv::Point peak;
+  int lastRow = -1;              // Last row a run joined this component
+  bool foreign = false;          // Touches the row above the band: owned by the previous band
+  bool emitted = false;
+};
+
+// Union-find over run labels with per-root component statistics
+class ComponentForest {
+ public:
+  void clear() {
+    parent_.clear();
+    components_.clear();
+  }
+
+  int add(const Component& component) {
+    parent_.push_back(static_cast<int>(parent_.size()));
+    components_.push_back(component);
+    return static_cast<int>(parent_.size()) - 1;
+  }
+
+  int find(int label) {
+    while (parent_[label] != label) {
+      parent_[label] = parent_[parent_[label]];  // Path halving
+      label = parent_[label];
+    }
+    return label;
+  }
+
+  void unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return;
+    if (a > b) std::swap(a, b);  // Older label stays root
+    Component& into = components_[a];
+    const Component& from = components_[b];
+    into.top = std::min(into.top, from.top);
+    into.bottom = std::max(into.bottom, from.bottom);
+    into.left = std::min(into.left, from.left);
+    into.right = std::max(into.right, from.right);
+    into.area += from.area;
+    into.saturated += from.saturated;
+    into.flux += from.flux;
+    into.sumX += from.sumX;
+    into.sumY += from.sumY;
+    if (from.peakValue > into.peakValue) {
+      into.peakValue = from.peakValue;
+      into.peakFlux = from.peakFlux;
+      into.peak = from.peak;
+    }
+    into.lastRow = std::max(into.lastRow, from.lastRow);
+    into.foreign = into.foreign || from.foreign;
+    parent_[b] = a;
+  }
+
+  Component& operator[](int root) { return components_[root]; }
+
+ private:
+  std::vector<int> parent_;
+  std::vector<Component> components_;
+};
+
+// Runs of row y above threshold, each a new single-run component
+inline void scanRow(const cv::Mat& frame, const BackgroundMap& background, int y, const StarDetectorConfig& config,
+                    bool foreign, ComponentForest& forest, std::vector<Run>& runs) {
+  runs.clear();
+  const uint16_t* row = frame.ptr<uint16_t>(y);
+  background.forEachAboveThreshold(row, y, 0, frame.cols, static_cast<float>(config.sigma), 1.0f,
+                                   [&](int x, float level, float) {
+    const uint16_t v = row[x];
+    if (runs.empty() || runs.back().xEnd != x - 1) {
+      Component c;
+      c.top = c.bottom = y;
+      c.left = c.right = x;
+      c.lastRow = y;
+      c.foreign = foreign;
+      runs.push_back(Run{x, x, forest.add(c)});
+    }
+    Run& run = runs.back();
+    run.xEnd = x;
+
+    Component& c = forest[run.label];
+    const double flux = v - level;
+    c.right = x;
+    c.area += 1;
+    c.saturated += v >= config.saturationLevel;
+    c.flux += flux;
+    c.sumX += flux * (x + 0.5);
+    c.sumY += flux * (y + 0.5);
+    if (v > c.peakValue) {
+      c.peakValue = v;
+      c.peakFlux = static_cast<float>(flux);
+      c.peak = cv::Point(x, y);
+    }
+  });
+}
+
+// Join each current run to the 8-connected runs of the previous row
+inline void connectRuns(const std::vector<Run>& previous, const std::vector<Run>& current, ComponentForest& forest) {
+  size_t p = 0;
+  for (const Run& run : current) {
+    while (p < previous.size() && previous[p].xEnd < run.xBegin - 1) ++p;
+    for (size_t q = p; q < previous.size() && previous[q].xBegin <= run.xEnd + 1; ++q) {
+      forest.unite(run.label, previous[q].label);
+    }
+  }
+}
+
+}  // namespace star_detector_detail
+
+// Label the components of rows [yBegin, yEnd) and append the stars they form
+// Components may run below yEnd: rows are scanned until every component that
+// started inside the band is complete. Components touching row yBegin - 1
+// belong to the band above and are skipped, so bands can run in parallel.
+inline void detectComponentsInBand(const cv::Mat& frame, const BackgroundMap& background, int yBegin, int yEnd,
+                                   const StarDetectorConfig& config, StarDetection& out) {
+  using namespace star_detector_detail;
+  thread_local ComponentForest forest;
+  thread_local std::vector<Run> previous, current;
+  forest.clear();
+  previous.clear();
+
+  auto finish = [&](int root) {
+    Component& c = forest[root];
+    if (c.emitted) return;
+    c.emitted = true;
+    if (c.foreign || c.top < yBegin || c.top >= yEnd) return;  // Another band's star
+
+    if (c.saturated > 0) {
+      out.rejectedSaturated++;
+    } else if (c.area < config.minArea || c.flux <= 0.0 || c.peakFlux > config.maxPeakFluxFraction * c.flux) {
+      out.rejectedHotPixels++;
+    } else if (c.area > config.maxArea) {
+      out.rejectedSize++;
+    } else {
+      const cv::Rect bounds(c.left, c.top, c.right - c.left + 1, c.bottom - c.top + 1);
+      const cv::Point2f centroid(static_cast<float>(c.sumX / c.flux), static_cast<float>(c.sumY / c.flux));
+      out.stars.push_back(DetectedStar{bounds, c.peak, c.peakValue, centroid, static_cast<float>(c.flux), c.area});
+    }
+  };
+
+  if (yBegin > 0) {
+    scanRow(frame, background, yBegin - 1, config, true, forest, previous);
+  }
+
+  for (int y = yBegin; y < frame.rows; ++y) {
+    scanRow(frame, background, y, config, false, forest, current);
+    connectRuns(previous, current, forest);
+
+    bool ownedAlive = false;
+    for (const Run& run : current) {
+      Component& c = forest[forest.find(run.label)];
+      c.lastRow = y;
+      c.bottom = y;
+      ownedAlive = ownedAlive || (!c.foreign && c.top < yEnd);
+    }
+    for (const Run& run : previous) {
+      const int root = forest.find(run.label);
+      if (forest[root].lastRow < y) finish(root);
+    }
+    std::swap(previous, current);
+
+    if (y >= yEnd - 1 && !ownedAlive) break;
+  }
+
+  for (const Run& run : previous) {
+    finish(forest.find(run.label));
+  }
+}
+
+// Detect stars across a 16-bit frame, one row band per pool task
+inline StarDetection detectStarComponents(const cv::Mat& frame, const BackgroundMap& background,
+                                          WorkStealingPool& pool,
+                                          const StarDetectorConfig& config = StarDetectorConfig()) {
+  const size_t bandCount = static_cast<size_t>((frame.rows + kRowsPerComponentTask - 1) / kRowsPerComponentTask);
+  std::vector<StarDetection> bands(bandCount);
+  pool.parallelFor(bandCount, 1, [&](size_t begin, size_t end, unsigned) {
+    for (size_t band = begin; band < end; ++band) {
+      const int yBegin = static_cast<int>(band) * kRowsPerComponentTask;
+      const int yEnd = std::min(frame.rows, yBegin + kRowsPerComponentTask);
+      detectComponentsInBand(frame, background, yBegin, yEnd, config, bands[band]);
+    }
+  });
+
+  StarDetection result;
+  for (StarDetection& band : bands) {
+    result.stars.insert(result.stars.end(), band.stars.begin(), band.stars.end());
+    result.rejectedSaturated += band.rejectedSaturated;
+    result.rejectedHotPixels += band.rejectedHotPixels;
+    result.rejectedSize += band.rejectedSize;
+  }
+  return result;
+}
+
+// Candidate windows for the HFD pipeline: a stampSize square centered on each
+// star's peak, clipped to the frame
+inline std::vector<cv::Rect> starWindows(const std::vector<DetectedStar>& stars, int stampSize,
+                                         const cv::Size& frameSize) {
+  std::vector<cv::Rect> windows;
+  windows.reserve(stars.size());
+  const cv::Rect frameRect(0, 0, frameSize.width, frameSize.height);
+  for (const DetectedStar& star : stars) {
+    const int half = stampSize / 2;
+    windows.push_back(cv::Rect(star.peak.x - half, star.peak.y - half, stampSize, stampSize) & frameRect);
+  }
+  return windows;
+}
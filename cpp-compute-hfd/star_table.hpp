@@ -0,0 +1,53 @@
+// Structure-of-arrays star measurement table
+// One contiguous column per quantity, so per-frame statistics (median HFD,
+// flux-weighted means, flag counts) stream through a single array instead of
+// striding over StarMeasurement records.
+// Requires: C++17 standard library
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-star flag bits
+constexpr uint32_t kStarFlagClipped = 1u << 0;         // Stamp extends past the frame edge
+constexpr uint32_t kStarFlagEmpty = 1u << 1;           // Stamp entirely outside the frame, nothing measured
+constexpr uint32_t kStarFlagNoHFD = 1u << 2;           // No flux above background inside the aperture
+constexpr uint32_t kStarFlagSaturated = 1u << 3;       // Peak at or above the saturation level
+constexpr uint32_t kStarFlagFlatBackground = 1u << 4;  // Background stddev 0: no centroid threshold
+constexpr uint32_t kStarFlagDefectsRepaired = 1u << 5; // Hot, bad or cosmic-ray pixels repaired in the stamp
+
+struct StarTable {
+  std::vector<float> x;                 // Centroid in frame coordinates
+  std::vector<float> y;
+  std::vector<float> backgroundLevel;
+  std::vector<float> backgroundStdDev;
+  std::vector<float> hfd;               // Half-flux diameter (pixels), 0 if not measurable
+  std::vector<float> flux;              // Background-subtracted flux inside the aperture
+  std::vector<float> peak;              // Brightest stamp pixel (ADU)
+  std::vector<uint32_t> flags;          // kStarFlag* bits
+  std::vector<float> fwhm;              // PSF shape (psf_shape.hpp), 0 unless measured
+  std::vector<float> ellipticity;
+  std::vector<float> positionAngle;
+
+  size_t size() const { return x.size(); }
+
+  // Vectors keep their capacity, so a table reused across frames stops
+  // allocating once it has held the largest star count
+  void resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    backgroundLevel.resize(count);
+    backgroundStdDev.resize(count);
+    hfd.resize(count);
+    flux.resize(count);
+    peak.resize(count);
+    flags.resize(count);
+    fwhm.resize(count);
+    ellipticity.resize(count);
+    positionAngle.resize(count);
+  }
+
+  void clear() { resize(0); }
+};
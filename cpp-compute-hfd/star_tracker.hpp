@@ -0,0 +1,182 @@
+// Frame-to-frame star tracking cache
+// During guiding and continuous capture the same stars sit in nearly the same
+// pixels frame after frame. StarTracker keeps the stars of the last frame
+// (centroid, background, flux), measures the next frame only in stamps around
+// their predicted positions, and falls back to full detection when too few of
+// them are found again.
+// Requires: OpenCV, C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "hfd_engine.hpp"
+
+// Tracking parameters
+constexpr double kTrackMinReacquiredFraction = 0.7;  // Redetect when fewer of the detected stars are found
+constexpr int    kTrackMinStars = 3;                 // Redetect when fewer stars are found
+constexpr float  kTrackMaxPositionError = 3.0f;      // Centroid distance from the prediction still accepted (pixels)
+constexpr float  kTrackMinFluxRatio = 0.3f;          // Star lost if its flux drops below this fraction of the last
+constexpr int    kTrackBackgroundRefreshFrames = 4;  // Stamp backgrounds re-estimated every N frames (1 = always)
+constexpr int    kTrackRedetectFrames = 0;           // Full detection every N frames to pick up new stars (0 = on loss only)
+
+struct StarTrackerConfig {
+  double minReacquiredFraction = kTrackMinReacquiredFraction;
+  int minStars = kTrackMinStars;
+  float maxPositionError = kTrackMaxPositionError;
+  float minFluxRatio = kTrackMinFluxRatio;
+  int backgroundRefreshFrames = kTrackBackgroundRefreshFrames;
+  int redetectFrames = kTrackRedetectFrames;
+};
+
+// Last measurement of a tracked star, frame coordinates
+struct StarTrack {
+  cv::Point2f centroid;
+  BackgroundStats background;
+  float hfd;
+  float flux;
+};
+
+struct TrackedFrame {
+  FrameHFDResult result;         // Stars found in this frame, as from HFDEngine::measureFrame
+  bool redetected = false;       // Full detection ran on this frame
+  size_t predicted = 0;          // Tracks carried into this frame
+  size_t reacquired = 0;         // Of those, stars found again
+  cv::Point2f motion;            // Median star motion since the previous frame (pixels)
+};
+
+class StarTracker {
+ public:
+  explicit StarTracker(HFDEngine& engine, StarTrackerConfig config = StarTrackerConfig())
+      : engine_(engine), config_(config) {}
+
+  // Measure the next frame of a sequence, assuming the stars keep the motion
+  // they had between the last two frames
+  TrackedFrame track(const cv::Mat& frame) { return process(frame, cv::Point2f()); }
+
+  // Same, with a known image shift since the last frame on top of that motion
+  // (guide pulses, dithers), in pixels
+  TrackedFrame track(const cv::Mat& frame, const cv::Point2f& mountOffset) { return process(frame, mountOffset); }
+
+  const std::vector<StarTrack>& tracks() const { return tracks_; }
+
+  // Forget all tracks: the next frame runs full detection
+  void reset() {
+    tracks_.clear();
+    drift_ = cv::Point2f();
+    detectedStars_ = 0;
+    framesSinceDetection_ = 0;
+    framesSinceBackground_ = 0;
+  }
+
+ private:
+  TrackedFrame process(const cv::Mat& frame, const cv::Point2f& mountOffset) {
+    const bool redetectDue = config_.redetectFrames > 0 && framesSinceDetection_ >= config_.redetectFrames;
+    if (tracks_.empty() || redetectDue) {
+      return redetect(frame);
+    }
+
+    // One stamp per track around its predicted centroid, as stampAround centers
+    // the engine's stamps on a peak pixel
+    const cv::Point2f shift = drift_ + mountOffset;
+    const int size = engine_.config().stampSize;
+    const cv::Rect frameRect(0, 0, frame.cols, frame.rows);
+    stamps_.clear();
+    backgrounds_.clear();
+    predictedTracks_.clear();
+    for (size_t i = 0; i < tracks_.size(); ++i) {
+      const cv::Point2f predicted = tracks_[i].centroid + shift;
+      const cv::Rect stamp(cvFloor(predicted.x) - size / 2, cvFloor(predicted.y) - size / 2, size, size);
+      if ((stamp & frameRect) != stamp) continue;  // Leaving the frame: lost
+      stamps_.push_back(stamp);
+      backgrounds_.push_back(tracks_[i].background);
+      predictedTracks_.push_back(i);
+    }
+
+    const bool refreshBackground = ++framesSinceBackground_ >= config_.backgroundRefreshFrames;
+    TrackedFrame tracked;
+    tracked.predicted = tracks_.size();
+    tracked.result = refreshBackground ? engine_.measureStamps(frame, stamps_)
+                                       : engine_.measureStamps(frame, stamps_, backgrounds_);
+    if (refreshBackground) {
+      framesSinceBackground_ = 0;
+    }
+
+    // Keep the stars found near their prediction with a comparable flux
+    std::vector<StarMeasurement>& stars = tracked.result.stars;
+    std::vector<StarTrack> next;
+    next.reserve(stars.size());
+    motionX_.clear();
+    motionY_.clear();
+    size_t kept = 0;
+    for (size_t i = 0; i < stars.size(); ++i) {
+      const StarMeasurement& star = stars[i];
+      const StarTrack& track = tracks_[predictedTracks_[i]];
+      const cv::Point2f error = star.centroid - (track.centroid + shift);
+      if (star.hfd <= 0.0f || (star.flags & (kStarFlagSaturated | kStarFlagFlatBackground)) ||
+          error.x * error.x + error.y * error.y > config_.maxPositionError * config_.maxPositionError ||
+          star.flux < config_.minFluxRatio * track.flux) {
+        continue;
+      }
+      motionX_.push_back(star.centroid.x - track.centroid.x);
+      motionY_.push_back(star.centroid.y - track.centroid.y);
+      next.push_back(StarTrack{star.centroid, star.background, star.hfd, star.flux});
+      stars[kept++] = star;
+    }
+    stars.resize(kept);
+    tracked.reacquired = kept;
+
+    if (static_cast<int>(kept) < config_.minStars ||
+        static_cast<double>(kept) < config_.minReacquiredFraction * static_cast<double>(detectedStars_)) {
+      return redetect(frame);
+    }
+
+    summarizeFrame(tracked.result);
+    tracked.motion = cv::Point2f(static_cast<float>(computeMedian(motionX_)),
+                                 static_cast<float>(computeMedian(motionY_)));
+    drift_ = tracked.motion - mountOffset;
+    tracks_ = std::move(next);
+    framesSinceDetection_++;
+    return tracked;
+  }
+
+  // Full detection; every measurable, unsaturated star becomes a track
+  TrackedFrame redetect(const cv::Mat& frame) {
+    TrackedFrame tracked;
+    tracked.redetected = true;
+    tracked.predicted = tracks_.size();
+    tracked.result = engine_.measureFrame(frame);
+
+    tracks_.clear();
+    for (const StarMeasurement& star : tracked.result.stars) {
+      if (star.hfd > 0.0f && !(star.flags & (kStarFlagSaturated | kStarFlagFlatBackground | kStarFlagClipped))) {
+        tracks_.push_back(StarTrack{star.centroid, star.background, star.hfd, star.flux});
+      }
+    }
+    drift_ = cv::Point2f();  // Stars are not matched across a detection
+    detectedStars_ = tracks_.size();
+    framesSinceDetection_ = 0;
+    framesSinceBackground_ = 0;
+    return tracked;
+  }
+
+  HFDEngine& engine_;
+  StarTrackerConfig config_;
+
+  std::vector<StarTrack> tracks_;
+  cv::Point2f drift_;                  // Star motion per frame not explained by mount offsets
+  size_t detectedStars_ = 0;           // Tracks right after the last detection
+  int framesSinceDetection_ = 0;
+  int framesSinceBackground_ = 0;
+
+  // Per-frame scratch, kept for its capacity
+  std::vector<cv::Rect> stamps_;
+  std::vector<BackgroundStats> backgrounds_;
+  std::vector<size_t> predictedTracks_;
+  std::vector<double> motionX_;
+  std::vector<double> motionY_;
+};
@@ -0,0 +1,80 @@
+// Linear-time robust background vs the sort + copying sigma clip
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "background_estimator.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr double kStdDevRelativeTolerance = 1e-12;
+
+std::string compareWithReference(const std::vector<uint16_t>& values, const std::string& label) {
+  const std::vector<double> asDouble(values.begin(), values.end());
+  const BackgroundStats expected = computeRobustBackground(asDouble);
+  const BackgroundStats actual = computeRobustBackgroundLinear(values);
+  const double stddevError = std::abs(expected.stddev - actual.stddev);
+  if (expected.level != actual.level ||
+      stddevError > kStdDevRelativeTolerance * std::max(1.0, expected.stddev)) {
+    return "mismatch on " + label + ": level " + std::to_string(expected.level) + " vs " +
+           std::to_string(actual.level) + ", stddev " + std::to_string(expected.stddev) + " vs " +
+           std::to_string(actual.stddev);
+  }
+  return "";
+}
+
+// Golden cases: both histogram and nth_element paths, odd/even counts, flat
+// data, heavy contamination and frame-sized samples
+std::string verifySamples() {
+  const double noises[] = {0.0, 0.4, 3.0, 15.0, 400.0};
+  for (uint32_t seed = 0; seed < 400; ++seed) {
+    const size_t count = 1 + (seed * 37) % 3000;
+    const double noise = noises[seed % 5];
+    const std::string label = "seed " + std::to_string(seed);
+    std::string error = compareWithReference(makeBackgroundSample(seed, count, noise, false), label + " clean");
+    if (error.empty()) error = compareWithReference(makeBackgroundSample(seed, count, noise, true), label + " contaminated");
+    if (!error.empty()) return error;
+  }
+  for (uint32_t seed = 0; seed < 4; ++seed) {
+    std::string error = compareWithReference(makeBackgroundSample(seed, 65536, 12.0, seed % 2 == 1), "frame sample");
+    if (!error.empty()) return error;
+  }
+  return "";
+}
+
+// Real annuli from noisy stamps: computeBackgroundStatsLinear vs computeBackgroundStats
+std::string verifyAnnuli() {
+  for (uint32_t seed = 0; seed < 200; ++seed) {
+    StarFieldConfig config;
+    config.width = config.height = 30 + static_cast<int>(seed % 40);
+    config.starCount = 1;
+    config.readNoise = 15.0;
+    config.seed = seed;
+    const cv::Mat stamp = makeStarField(config).image;
+    const cv::Point2f center(stamp.cols / 2.0f + (seed % 3) * 0.5f, stamp.rows / 2.0f);
+
+    const BackgroundStats expected = computeBackgroundStats(stamp, center);
+    const BackgroundStats actual = computeBackgroundStatsLinear(stamp, center);
+    if (expected.level != actual.level ||
+        std::abs(expected.stddev - actual.stddev) > kStdDevRelativeTolerance * std::max(1.0, expected.stddev)) {
+      return "annulus mismatch at seed " + std::to_string(seed);
+    }
+  }
+  return "";
+}
+
+}  // namespace
+
+int main() {
+  int failures = 0;
+  for (const auto& [name, check] : {std::pair{"samples", &verifySamples}, std::pair{"annuli", &verifyAnnuli}}) {
+    const std::string error = check();
+    std::cout << name << ": " << (error.empty() ? "ok" : error) << std::endl;
+    failures += error.empty() ? 0 : 1;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// In-stamp hot-pixel / cosmic-ray rejection: clean stars untouched, hits
+// repaired to the clean HFD and centroid, bad-pixel map applied by index
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hfd_engine.hpp"
+#include "stamp_defects.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr double kRepairedHFDTolerance = 0.01;        // Repaired vs defect-free stamp (relative)
+constexpr double kRepairedCentroidTolerance = 0.05;   // Pixels
+constexpr double kCoreHitHFDTolerance = 0.05;         // Repaired hit on the brightest pixels (relative)
+constexpr double kFieldMedianHFDTolerance = 0.01;     // Engine median HFD, hot-pixel vs clean field (relative)
+constexpr uint16_t kHotValue = 60000;
+
+struct Measured {
+  cv::Point2f centroid;
+  float hfd;
+};
+
+Measured measure(const cv::Mat& stamp) {
+  const BackgroundAndCentroid bc = computeBackgroundAndCentroid(stamp);
+  return Measured{bc.centroid, computeHFDHistogram(stamp, bc.centroid, bc.background)};
+}
+
+// Stamp through rejection, as HFDEngine runs it
+Measured measureRejected(const cv::Mat& stamp, StampDefects& defects, const StampDefectConfig& config = {}) {
+  cv::Mat repaired;
+  const BackgroundStats initial = computeBackgroundStats(stamp, cv::Point2f(25.0f, 25.0f));
+  defects = rejectStampDefects(stamp, initial, repaired, cv::Point(), config);
+  return measure(defects.repaired() > 0 ? repaired : stamp);
+}
+
+std::string compareMeasured(const Measured& clean, const Measured& repaired, double hfdTolerance) {
+  const cv::Point2f d = clean.centroid - repaired.centroid;
+  if (std::abs(repaired.hfd - clean.hfd) > hfdTolerance * clean.hfd ||
+      std::hypot(static_cast<double>(d.x), static_cast<double>(d.y)) > kRepairedCentroidTolerance) {
+    return "HFD " + std::to_string(repaired.hfd) + " vs " + std::to_string(clean.hfd);
+  }
+  return "";
+}
+
+// Empty string if clean stars are never touched, and single hot pixels,
+// 2-pixel cosmic-ray hits and mapped bad pixels anywhere in the stamp (star
+// core and border included) are repaired
+std::string verifyStamps() {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> position(0, 49);
+  for (double sigma : {0.8, 1.0, 1.5, 2.0, 3.0}) {
+    for (double peak : {300.0, 3000.0, 20000.0, 64000.0}) {
+      for (int trial = 0; trial < 20; ++trial) {
+        const cv::Mat clean = makeNoisyStar(sigma, peak, rng);
+        StampDefects defects;
+        measureRejected(clean, defects);
+        if (defects.repaired() > 0) {
+          return "clean star repaired (sigma " + std::to_string(sigma) + ", peak " + std::to_string(peak) + ")";
+        }
+
+        // One defect per kind, on the core, anywhere, and on the border. A hit
+        // is only sharp where the star is well below the hot value, and on an
+        // undersampled core the neighbour median is a poor stand-in for the
+        // true peak, so there only the repair itself is checked. Faint stars
+        // have no HFD worth comparing.
+        const Measured expected = measure(clean);
+        const cv::Point core(25, 25);
+        const cv::Point random(position(rng), position(rng));
+        const cv::Point hits[][2] = {{core, core}, {random, random}, {core, core + cv::Point(1, 0)},
+                                     {random, random + cv::Point(1, 1)}, {cv::Point(0, 0), cv::Point(0, 0)},
+                                     {cv::Point(49, 20), cv::Point(49, 20)}};
+        for (const auto& hit : hits) {
+          cv::Mat damaged = clean.clone();
+          for (const cv::Point& p : hit) {
+            if (cv::Rect(0, 0, 50, 50).contains(p)) damaged.at<uint16_t>(p.y, p.x) = kHotValue;
+          }
+          const double signal = std::max(0.0, clean.at<uint16_t>(hit[0].y, hit[0].x) - 1000.0);
+          if (4.0 * signal > kHotValue) continue;
+          const bool onCore = signal > 0.25 * peak;
+          const Measured repaired = measureRejected(damaged, defects);
+          const std::string where = " at (" + std::to_string(hit[0].x) + "," + std::to_string(hit[0].y) + ")";
+          if (defects.transients == 0) return "transient not repaired" + where;
+          if (peak < 1000.0 || (onCore && sigma < 1.5)) continue;
+          const std::string error =
+              compareMeasured(expected, repaired, onCore ? kCoreHitHFDTolerance : kRepairedHFDTolerance);
+          if (!error.empty()) return "repaired transient" + where + ": " + error;
+        }
+
+        // A mapped bad pixel reading low in the core is not sharp, only the map catches it
+        cv::Mat dead = clean.clone();
+        dead.at<uint16_t>(25, 24) = 0;
+        const BadPixelMap map(cv::Size(100, 100), {cv::Point(34, 35), cv::Point(60, 60)});
+        StampDefectConfig config;
+        config.badPixels = &map;
+        cv::Mat repaired;
+        const BackgroundStats initial = computeBackgroundStats(dead, cv::Point2f(25.0f, 25.0f));
+        defects = rejectStampDefects(dead, initial, repaired, cv::Point(10, 10), config);
+        if (defects.badPixels != 1) return "bad pixel map not applied by index";
+      }
+    }
+  }
+  return "";
+}
+
+// Empty string if the engine recovers the clean median HFD on a field full
+// of hot pixels
+std::string verifyField() {
+  StarFieldConfig fieldConfig;
+  fieldConfig.starCount = 500;
+  const StarField clean = makeStarField(fieldConfig);
+  fieldConfig.hotPixels = 20000;
+  const StarField hot = makeStarField(fieldConfig);
+  HFDEngineConfig config;
+  config.rejectDefects = true;
+  HFDEngine engine(config, 1);
+  const float cleanHFD = engine.measureFrame(clean.image).medianHFD;
+  const float hotHFD = engine.measureFrame(hot.image).medianHFD;
+  if (std::abs(hotHFD - cleanHFD) > kFieldMedianHFDTolerance * cleanHFD) {
+    return "engine median HFD " + std::to_string(hotHFD) + " on the hot-pixel field vs " + std::to_string(cleanHFD);
+  }
+  return "";
+}
+
+}  // namespace
+
+int main() {
+  int failures = 0;
+  for (const auto& [name, check] : {std::pair{"stamps", &verifyStamps}, std::pair{"field", &verifyField}}) {
+    const std::string error = check();
+    std::cout << name << ": " << (error.empty() ? "ok" : error) << std::endl;
+    failures += error.empty() ? 0 : 1;
+  }
+  return failures == 0 ? 0 : 1;
+}
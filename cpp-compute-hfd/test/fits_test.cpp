@@ -0,0 +1,178 @@
+// Memory-mapped FITS batch: plane decoding (byte swap plus BZERO), results
+// against measureFrame for any worker count, and the HFDCOLS1 columnar file
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fits_batch.hpp"
+#include "synthetic_fits.hpp"
+
+namespace {
+
+const FitsSet& cachedSet() {
+  static const FitsSet set =
+      writeFitsSet((std::filesystem::temp_directory_path() / "compute_hfd_fits_test_").string());
+  return set;
+}
+
+const FitsBatchResult& serialBatch() {
+  static const FitsBatchResult result = [] {
+    std::vector<std::string> paths = cachedSet().paths;
+    paths.push_back((std::filesystem::temp_directory_path() / "compute_hfd_fits_test_missing.fits").string());
+    FitsBatchConfig config;
+    config.threads = 1;
+    return measureFitsFiles(paths, config);
+  }();
+  return result;
+}
+
+// Empty string if the planes of the unsigned cube and of a signed file decode
+// to the source pixels, with the signed offset back to physical ADU
+std::string verifyDecode() {
+  const FitsSet& set = cachedSet();
+  cv::Mat buffer;
+  MappedFits cube(set.paths[0]);
+  if (cube.planes() != kFitsCubePlanes || cube.levelOffset() != 0.0) {
+    return "cube header misread";
+  }
+  MappedFits signedFile(set.paths[1]);
+  if (signedFile.levelOffset() != -kFitsUnsignedZero) {
+    return "signed file offset " + std::to_string(signedFile.levelOffset());
+  }
+
+  const std::pair<const MappedFits*, int> planes[] = {
+      {&cube, 0}, {&cube, 1}, {&cube, 2}, {&cube, 3}, {&signedFile, 0}};
+  for (const auto& [file, plane] : planes) {
+    const cv::Mat& decoded = file->plane(plane, buffer);
+    const cv::Mat& source = set.frames[file == &cube ? plane : kFitsCubePlanes];
+    for (int y = 0; y < source.rows; ++y) {
+      if (std::memcmp(decoded.ptr<uint16_t>(y), source.ptr<uint16_t>(y), source.cols * sizeof(uint16_t)) != 0) {
+        return std::string(file == &cube ? "cube" : "signed file") + " plane " + std::to_string(plane) +
+               " differs from the source at row " + std::to_string(y);
+      }
+    }
+  }
+  return "";
+}
+
+// Empty string if the batch matches measureFrame on the source frames (signed
+// files shifted back to physical ADU) for one worker and for four, and a
+// missing file is reported instead of measured
+std::string verifyBatch() {
+  const FitsSet& set = cachedSet();
+  const FitsBatchResult& serial = serialBatch();
+  if (serial.errors.size() != 1 || serial.frames.size() != set.frames.size()) {
+    return "unexpected frame or error count";
+  }
+
+  HFDEngine engine(HFDEngineConfig(), 1);
+  for (size_t i = 0; i < set.frames.size(); ++i) {
+    const FrameHFDResult expected = engine.measureFrame(set.frames[i]);
+    const FitsFrameResult& frame = serial.frames[i];
+    const double offset = (frame.file % 2 == 0) ? 0.0 : -kFitsUnsignedZero;
+    if (frame.starCount != expected.stars.size() || frame.medianHFD != expected.medianHFD) {
+      return "frame " + std::to_string(i) + " differs from measureFrame";
+    }
+    for (size_t s = 0; s < expected.stars.size(); ++s) {
+      const size_t row = frame.firstStar + s;
+      const StarMeasurement& star = expected.stars[s];
+      if (serial.stars.hfd[row] != star.hfd || serial.stars.x[row] != star.centroid.x ||
+          serial.starFrame[row] != i ||
+          serial.stars.backgroundLevel[row] != static_cast<float>(star.background.level + offset)) {
+        return "star " + std::to_string(s) + " of frame " + std::to_string(i) + " differs from measureFrame";
+      }
+    }
+  }
+
+  FitsBatchConfig config;
+  config.threads = 4;
+  const FitsBatchResult parallel = measureFitsFiles(set.paths, config);
+  if (parallel.stars.hfd != serial.stars.hfd || parallel.stars.x != serial.stars.x) {
+    return "results depend on the worker count";
+  }
+  return "";
+}
+
+template <typename T>
+T readAt(const std::vector<char>& bytes, size_t offset) {
+  T value;
+  std::memcpy(&value, bytes.data() + offset, sizeof(T));
+  return value;
+}
+
+// Empty string if the columnar file reads back unchanged and its bytes follow
+// the layout documented at writeStarColumns, which other readers rely on
+std::string verifyColumns() {
+  const FitsBatchResult& serial = serialBatch();
+  const std::string path = (std::filesystem::temp_directory_path() / "compute_hfd_fits_test.hfdcols").string();
+  FitsBatchResult reread;
+  if (!writeStarColumns(path, serial) || !readStarColumns(path, reread)) {
+    return "columnar file write or read failed";
+  }
+  if (reread.files != serial.files || reread.frames.size() != serial.frames.size() ||
+      reread.starFrame != serial.starFrame || reread.stars.hfd != serial.stars.hfd ||
+      reread.stars.flags != serial.stars.flags || reread.stars.peak != serial.stars.peak ||
+      reread.stars.positionAngle != serial.stars.positionAngle) {
+    return "columnar file does not read back unchanged";
+  }
+  for (size_t i = 0; i < serial.frames.size(); ++i) {
+    if (reread.frames[i].firstStar != serial.frames[i].firstStar ||
+        reread.frames[i].medianHFD != serial.frames[i].medianHFD) {
+      return "frame columns do not read back unchanged";
+    }
+  }
+
+  std::vector<char> bytes(std::filesystem::file_size(path));
+  std::FILE* in = std::fopen(path.c_str(), "rb");
+  const bool read = in && std::fread(bytes.data(), 1, bytes.size(), in) == bytes.size();
+  if (in) std::fclose(in);
+  std::remove(path.c_str());
+  if (!read) return "columnar file not readable";
+
+  // Header, file names, 28 bytes per frame, 48 per star
+  const size_t frames = serial.frames.size();
+  const size_t stars = serial.stars.size();
+  size_t names = 0;
+  for (const std::string& file : serial.files) names += 4 + file.size();
+  const size_t frameColumns = 32 + names;
+  const size_t starColumns = frameColumns + 28 * frames;
+  if (bytes.size() != starColumns + 48 * stars || std::memcmp(bytes.data(), "HFDCOLS1", 8) != 0 ||
+      readAt<uint32_t>(bytes, 8) != 1 || readAt<uint32_t>(bytes, 12) != serial.files.size() ||
+      readAt<uint32_t>(bytes, 16) != frames || readAt<uint64_t>(bytes, 24) != stars) {
+    return "columnar file header or size does not follow the HFDCOLS1 layout";
+  }
+  const size_t medianHFD = frameColumns + 24 * frames;     // After file, plane, firstStar, starCount, measuredStars
+  const size_t hfd = starColumns + 4 * stars + 16 * stars; // After frame, x, y, backgroundLevel, backgroundStdDev
+  const size_t flags = starColumns + 4 * stars + 28 * stars;
+  for (size_t i = 0; i < frames; ++i) {
+    if (readAt<float>(bytes, medianHFD + 4 * i) != serial.frames[i].medianHFD) {
+      return "medianHFD column not where HFDCOLS1 puts it";
+    }
+  }
+  for (size_t i = 0; i < stars; ++i) {
+    if (readAt<float>(bytes, hfd + 4 * i) != serial.stars.hfd[i] ||
+        readAt<uint32_t>(bytes, flags + 4 * i) != serial.stars.flags[i]) {
+      return "star columns not where HFDCOLS1 puts them";
+    }
+  }
+  return "";
+}
+
+}  // namespace
+
+int main() {
+  int failures = 0;
+  for (const auto& [name, check] : {std::pair{"decode", &verifyDecode}, std::pair{"batch", &verifyBatch},
+                                    std::pair{"columns", &verifyColumns}}) {
+    const std::string error = check();
+    std::cout << name << ": " << (error.empty() ? "ok" : error) << std::endl;
+    failures += error.empty() ? 0 : 1;
+  }
+  for (const std::string& path : cachedSet().paths) std::remove(path.c_str());
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// Fixed-point HFD pipeline: identical bits at every SimdLevel and thread
+// count, a golden hash of its results, and agreement with the floating-point
+// pipeline to within rounding
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hfd_engine.hpp"
+#include "hfd_fixed_point.hpp"
+#include "synthetic_star_field.hpp"
+
+namespace {
+
+constexpr int      kIntegerStamps = 64;               // Stamps in the golden set
+constexpr uint64_t kFixedPointGoldenHash = 0x743bfbee1b216021ull;  // FNV-1a of the golden set's fixed-point results
+constexpr double   kFixedHFDTolerance = 1e-3;         // Fixed vs floating-point HFD (pixels)
+constexpr double   kFixedCentroidTolerance = 1e-3;    // Fixed vs floating-point centroid (pixels)
+
+struct FixedResult {
+  BackgroundAndCentroid bc;
+  float hfd;
+  double flux;
+};
+
+FixedResult measureFixed(const cv::Mat& stamp, SimdLevel level) {
+  FixedResult r;
+  r.bc = computeBackgroundAndCentroidFixed(stamp, kBackgroundSigmaThreshold, kMinBackgroundRadius,
+                                           kMaxBackgroundRadius, level);
+  r.hfd = computeHFDFixed(stamp, r.bc.centroid, r.bc.background, kMaxApertureRadius, kHFDBackgroundMultiplier,
+                          &r.flux);
+  return r;
+}
+
+template <typename T>
+void hashBits(uint64_t& hash, const T& value) {
+  unsigned char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  for (unsigned char b : bytes) {
+    hash = (hash ^ b) * 0x100000001b3ull;
+  }
+}
+
+uint64_t hashResult(uint64_t hash, const FixedResult& r) {
+  hashBits(hash, r.bc.background.level);
+  hashBits(hash, r.bc.background.stddev);
+  hashBits(hash, r.bc.centroid.x);
+  hashBits(hash, r.bc.centroid.y);
+  hashBits(hash, r.hfd);
+  hashBits(hash, r.flux);
+  return hash;
+}
+
+// Empty string if the results are the same at every SimdLevel and match the
+// golden hash
+std::string verifyGoldenHash() {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (int i = 0; i < kIntegerStamps; ++i) {
+    const cv::Mat stamp = makeIntegerStamp(static_cast<uint32_t>(i));
+    const FixedResult active = measureFixed(stamp, activeSimdLevel());
+    const FixedResult scalar = measureFixed(stamp, SimdLevel::Scalar);
+    if (hashResult(0, active) != hashResult(0, scalar)) {
+      return std::string("result differs between scalar and ") + simdLevelName(activeSimdLevel()) + " at stamp " +
+             std::to_string(i);
+    }
+    hash = hashResult(hash, active);
+  }
+  if (hash != kFixedPointGoldenHash) {
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+    return std::string("results changed: hash ") + hex;
+  }
+  return "";
+}
+
+// Empty string if the results follow the floating-point pipeline (SIMD,
+// linear background) to within rounding
+std::string verifyAgainstFloatingPoint() {
+  for (int i = 0; i < kIntegerStamps; ++i) {
+    const cv::Mat stamp = makeIntegerStamp(static_cast<uint32_t>(i));
+    const FixedResult fixed = measureFixed(stamp, activeSimdLevel());
+    const BackgroundAndCentroid bc = computeBackgroundAndCentroidSIMD(
+        stamp, kBackgroundSigmaThreshold, kMinBackgroundRadius, kMaxBackgroundRadius, activeSimdLevel(),
+        BackgroundEstimator::Linear);
+    const float hfd = computeHFDHistogram(stamp, bc.centroid, bc.background);
+    const cv::Point2f d = bc.centroid - fixed.bc.centroid;
+    if (std::abs(hfd - fixed.hfd) > kFixedHFDTolerance ||
+        std::hypot(static_cast<double>(d.x), static_cast<double>(d.y)) > kFixedCentroidTolerance) {
+      return "stamp " + std::to_string(i) + ": fixed-point HFD " + std::to_string(fixed.hfd) + " vs floating-point " +
+             std::to_string(hfd);
+    }
+  }
+  return "";
+}
+
+bool sameColumns(const StarTable& a, const StarTable& b) {
+  return a.x == b.x && a.y == b.y && a.hfd == b.hfd && a.flux == b.flux && a.backgroundLevel == b.backgroundLevel &&
+         a.backgroundStdDev == b.backgroundStdDev && a.flags == b.flags;
+}
+
+// Empty string if an engine in fixedPoint mode gives the same table with one
+// thread and with four
+std::string verifyThreadCounts() {
+  StarFieldConfig fieldConfig;
+  fieldConfig.starCount = 300;
+  const StarField field = makeStarField(fieldConfig);
+  HFDEngineConfig config;
+  config.fixedPoint = true;
+  HFDEngine serial(config, 1);
+  HFDEngine parallel(config, 4);
+  const std::vector<StarCandidate> candidates = serial.detectStars(field.image);
+  std::vector<cv::Rect> stamps;
+  for (const StarCandidate& candidate : candidates) {
+    stamps.emplace_back(candidate.peak.x - 25, candidate.peak.y - 25, 50, 50);
+  }
+  StarTable a, b;
+  serial.measureStamps(field.image, stamps, a);
+  parallel.measureStamps(field.image, stamps, b);
+  if (a.x.empty()) {
+    return "no stars measured";
+  }
+  if (!sameColumns(a, b)) {
+    return "engine results depend on the thread count";
+  }
+  return "";
+}
+
+}  // namespace
+
+int main() {
+  int failures = 0;
+  for (const auto& [name, check] : {std::pair{"golden hash", &verifyGoldenHash},
+                                    std::pair{"floating point", &verifyAgainstFloatingPoint},
+                                    std::pair{"thread counts", &verifyThreadCounts}}) {
+    const std::string error = check();
+    std::cout << name << ": " << (error.empty() ? "ok" : error) << std::endl;
+    failures += error.empty() ? 0 : 1;
+  }
+  return failures == 0 ? 0 : 1;
+}
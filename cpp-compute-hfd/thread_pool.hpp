@@ -0,0 +1,175 @@
+// Work-stealing thread pool used to spread per-star work across cores
+// Requires: C++17 standard library
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Each worker owns a queue: it pops its own work from the front and, when
+// empty, steals from the back of the other workers' queues. Star stamps vary
+// in cost (edge rejects, faint vs bright stars), so stealing keeps all cores
+// busy to the end of a frame without tuning the chunk size per frame.
+// Tasks are plain structs in vectors that keep their capacity, so after the
+// first few calls parallelFor itself does not allocate.
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(unsigned threadCount = 0) {
+    if (threadCount == 0) {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queues_.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+      queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    workers_.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+      workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      stopping_ = true;
+    }
+    wakeCondition_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  unsigned threadCount() const { return static_cast<unsigned>(workers_.size()); }
+
+  // Run fn(begin, end, workerIndex) over [0, count) in chunks of `grain` items
+  // Blocks until every chunk has completed
+  template <typename Fn>
+  void parallelFor(size_t count, size_t grain, Fn&& fn) {
+    if (count == 0) {
+      return;
+    }
+    grain = std::max<size_t>(1, grain);
+    const size_t chunkCount = (count + grain - 1) / grain;
+
+    // Lives on this stack frame until every chunk has run
+    struct Job {
+      Fn& fn;
+      size_t remaining;  // Guarded by doneMutex
+      std::mutex doneMutex;
+      std::condition_variable doneCondition;
+    } job{fn, chunkCount, {}, {}};
+
+    auto run = [](void* context, size_t begin, size_t end, unsigned workerIndex) {
+      Job& j = *static_cast<Job*>(context);
+      j.fn(begin, end, workerIndex);
+      std::lock_guard<std::mutex> doneLock(j.doneMutex);
+      if (--j.remaining == 0) {
+        j.doneCondition.notify_all();
+      }
+    };
+
+    // Count the tasks before publishing them so a worker that pops one early
+    // never sees the pending count go negative
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex_);
+      pendingTasks_ += chunkCount;
+    }
+
+    // Deal chunks round-robin so every worker starts with local work
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+      const size_t begin = chunk * grain;
+      const size_t end = std::min(count, begin + grain);
+      WorkerQueue& queue = *queues_[chunk % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(Task{run, &job, begin, end});
+    }
+    wakeCondition_.notify_all();
+
+    std::unique_lock<std::mutex> doneLock(job.doneMutex);
+    job.doneCondition.wait(doneLock, [&] { return job.remaining == 0; });
+  }
+
+ private:
+  struct Task {
+    void (*run)(void* context, size_t begin, size_t end, unsigned workerIndex);
+    void* context;
+    size_t begin;
+    size_t end;
+  };
+
+  // Owner pops from `head`, thieves pop from the back; the vector is cleared
+  // (keeping its capacity) whenever it drains
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::vector<Task> tasks;
+    size_t head = 0;
+  };
+
+  bool popLocal(unsigned workerIndex, Task& task) {
+    WorkerQueue& queue = *queues_[workerIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.head == queue.tasks.size()) {
+      return false;
+    }
+    task = queue.tasks[queue.head++];
+    if (queue.head == queue.tasks.size()) {
+      queue.tasks.clear();
+      queue.head = 0;
+    }
+    return true;
+  }
+
+  bool steal(unsigned thiefIndex, Task& task) {
+    const size_t queueCount = queues_.size();
+    for (size_t offset = 1; offset < queueCount; ++offset) {
+      WorkerQueue& victim = *queues_[(thiefIndex + offset) % queueCount];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.head < victim.tasks.size()) {
+        task = victim.tasks.back();
+        victim.tasks.pop_back();
+        if (victim.head == victim.tasks.size()) {
+          victim.tasks.clear();
+          victim.head = 0;
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void workerLoop(unsigned workerIndex) {
+    Task task;
+    for (;;) {
+      if (popLocal(workerIndex, task) || steal(workerIndex, task)) {
+        {
+          std::lock_guard<std::mutex> lock(wakeMutex_);
+          --pendingTasks_;
+        }
+        task.run(task.context, task.begin, task.end, workerIndex);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(wakeMutex_);
+      wakeCondition_.wait(lock, [this] { return stopping_ || pendingTasks_ > 0; });
+      if (stopping_ && pendingTasks_ == 0) {
+        return;
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+
+  std::mutex wakeMutex_;
+  std::condition_variable wakeCondition_;
+  size_t pendingTasks_ = 0;
+  bool stopping_ = false;
+};
@@ -0,0 +1,86 @@
+// Preprocessing time of one FITS frame in both resize modes, to the
+// InceptionV3 input (299x299x3). Meant for full-size frames from
+// scripts/generate_test_fits.py --synthetic:
+//
+//   preprocess_bench /tmp/field.fits [repetitions] [area threads]
+//
+// The network does nothing, so a request's time is the FITS read and the
+// resize, plus a hand-off to the worker thread of a few microseconds.
+
+#include "image_processor.h"
+#include "inference_backend.h"
+#include "inference_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A network that returns zero scores without computing anything
+class NullBackend : public InferenceBackend {
+public:
+    NullBackend() : input_(shape_.size()), output_(1) {}
+
+    const InputShape& input_shape() const override { return shape_; }
+    float* input(size_t) override { return input_.data(); }
+    void execute(size_t) override {}
+    const float* output(size_t) const override { return output_.data(); }
+    size_t output_size() const override { return output_.size(); }
+
+private:
+    InputShape shape_{299, 299, 3};
+    std::vector<float> input_;
+    std::vector<float> output_;
+};
+
+// Median time of `repetitions` requests, after one to warm up the page
+// cache and the per-thread buffers
+static double median_ms(InferencePool& pool, const PreprocessOptions& options,
+                        const std::string& path, int repetitions) {
+    std::vector<double> times;
+    for (int i = 0; i <= repetitions; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        const ProcessResult result = process_image(pool, options, path, 600.0);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (!result.success) {
+            throw std::runtime_error(result.error);
+        }
+        if (i > 0) {
+            times.push_back(elapsed.count());
+        }
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <frame.fits> [repetitions] [area threads]" << std::endl;
+        return 2;
+    }
+    const std::string path = argv[1];
+    const int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 10;
+    const unsigned threads = argc > 3 ? static_cast<unsigned>(std::max(1, std::atoi(argv[3]))) : 1;
+
+    std::vector<std::unique_ptr<InferenceBackend>> instances;
+    instances.push_back(std::make_unique<NullBackend>());
+    InferencePool pool(std::move(instances), {});
+
+    try {
+        PreprocessOptions bilinear;
+        PreprocessOptions area;
+        area.resize_mode = ResizeMode::Area;
+        area.threads = fits_reads_thread_safe() ? threads : 1;
+        std::cout << "bilinear: " << median_ms(pool, bilinear, path, repetitions) << " ms" << std::endl;
+        std::cout << "area (" << area.threads << " thread" << (area.threads == 1 ? "" : "s")
+                  << "): " << median_ms(pool, area, path, repetitions) << " ms" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Preprocessing failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
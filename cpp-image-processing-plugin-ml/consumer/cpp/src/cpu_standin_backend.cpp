@@ -0,0 +1,78 @@
+#include "cpu_standin_backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+CpuStandInBackend::CpuStandInBackend(InputShape shape,
+                                     size_t classes,
+                                     std::chrono::microseconds latency,
+                                     size_t max_batch)
+    : input_shape_(shape), classes_(classes), latency_(latency), max_batch_(max_batch) {
+    if (shape.height < kGrid || shape.width < kGrid || shape.channels == 0 || classes == 0 ||
+        max_batch == 0) {
+        throw std::runtime_error(
+            "Stand-in input must be at least 8x8 with one channel, one class and a batch of one");
+    }
+    input_.assign(max_batch * shape.size(), 0.0f);
+    features_.assign(kGrid * kGrid * shape.channels, 0.0f);
+    output_.assign(max_batch * classes, 0.0f);
+
+    // Same weights for every instance, so every worker gives the same answer
+    weights_.resize(classes * features_.size());
+    uint32_t state = 0x9e3779b9u;
+    for (auto& w : weights_) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        w = static_cast<float>(state) / 4294967296.0f * 2.0f - 1.0f;
+    }
+}
+
+void CpuStandInBackend::execute(size_t batch) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t item = 0; item < std::min(batch, max_batch_); ++item) {
+        classify(input(item), output_.data() + item * classes_);
+    }
+    std::this_thread::sleep_until(start + latency_);
+}
+
+void CpuStandInBackend::classify(const float* image, float* scores) {
+    const size_t h = input_shape_.height;
+    const size_t w = input_shape_.width;
+    const size_t c = input_shape_.channels;
+
+    // Average-pool the HWC input into a kGrid x kGrid x c feature map
+    std::fill(features_.begin(), features_.end(), 0.0f);
+    for (size_t y = 0; y < h; ++y) {
+        float* cell_row = features_.data() + (y * kGrid / h) * kGrid * c;
+        const float* row = image + y * w * c;
+        for (size_t x = 0; x < w; ++x) {
+            float* cell = cell_row + (x * kGrid / w) * c;
+            for (size_t ch = 0; ch < c; ++ch) {
+                cell[ch] += row[x * c + ch];
+            }
+        }
+    }
+    const float cell_pixels = static_cast<float>(h * w) / (kGrid * kGrid);
+    for (auto& f : features_) f /= cell_pixels;
+
+    // Linear layer + softmax
+    const size_t n = features_.size();
+    float max_score = -INFINITY;
+    for (size_t k = 0; k < classes_; ++k) {
+        const float* wk = weights_.data() + k * n;
+        float score = 0.0f;
+        for (size_t i = 0; i < n; ++i) score += wk[i] * features_[i];
+        scores[k] = score;
+        max_score = std::max(max_score, score);
+    }
+    float sum = 0.0f;
+    for (size_t k = 0; k < classes_; ++k) {
+        scores[k] = std::exp(scores[k] - max_score);
+        sum += scores[k];
+    }
+    for (size_t k = 0; k < classes_; ++k) scores[k] /= sum;
+}
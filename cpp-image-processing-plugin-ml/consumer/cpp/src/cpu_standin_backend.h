@@ -0,0 +1,41 @@
+#pragma once
+
+#include "inference_backend.h"
+
+#include <chrono>
+#include <vector>
+
+// Stand-in for an SNPE network when no SDK or accelerator is available: a
+// fixed random linear classifier over 8x8 average-pooled input cells,
+// softmax-normalized. Deterministic, reads the whole input like a real
+// network would, and optionally holds each execution to a minimum latency
+// (waiting, not computing) to emulate an accelerator round trip. A batch
+// shares one round trip, as on an accelerator with room for the whole batch.
+class CpuStandInBackend : public InferenceBackend {
+public:
+    explicit CpuStandInBackend(InputShape shape = {299, 299, 3},
+                               size_t classes = 1001,
+                               std::chrono::microseconds latency = std::chrono::microseconds(0),
+                               size_t max_batch = 1);
+
+    const InputShape& input_shape() const override { return input_shape_; }
+    size_t max_batch() const override { return max_batch_; }
+    float* input(size_t item) override { return input_.data() + item * input_shape_.size(); }
+    void execute(size_t batch) override;
+    const float* output(size_t item) const override { return output_.data() + item * classes_; }
+    size_t output_size() const override { return classes_; }
+
+private:
+    static constexpr size_t kGrid = 8;  // Pooled cells per side
+
+    void classify(const float* image, float* scores);
+
+    InputShape input_shape_;
+    size_t classes_;
+    std::chrono::microseconds latency_;
+    size_t max_batch_;
+    std::vector<float> input_;
+    std::vector<float> features_;       // kGrid * kGrid * channels
+    std::vector<float> weights_;        // classes x features
+    std::vector<float> output_;         // max_batch x classes
+};
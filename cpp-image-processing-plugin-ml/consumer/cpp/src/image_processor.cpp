@@ -1,24 +1,58 @@
 #include "image_processor.h"
-#include "snpe_worker.h"
+#include "inference_pool.h"
+#include "latency_estimate.h"
+#include "resample.h"
 
 #include <nlohmann/json.hpp>
 
 #include <algorithm>
-#include <cmath>
+#include <chrono>
+#include <exception>
 #include <filesystem>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <fitsio.h>
 
 namespace fs = std::filesystem;
 
-struct FitsImage {
-    std::vector<float> data; // HWC interleaved, normalized [0,1]
-    int height;
-    int width;
-    int channels;
+using Clock = InferencePool::Clock;
+
+// Rows read per fits_read_pix call: the unit of the range scan and the
+// horizontal resize, and the deadline is checked between them
+static constexpr long kReadBandRows = 64;
+
+// Decode and normalize time of recent requests. The wait for a slot is left
+// out: InferencePool::expected_latency() accounts for that.
+static LatencyEstimate preprocess_latency;
+
+static void check_deadline(Clock::time_point deadline, const char* stage) {
+    if (Clock::now() >= deadline) {
+        throw DeadlineExceeded(std::string("Deadline passed during ") + stage);
+    }
+}
+
+// Buffers of one thread reading a frame
+struct BandScratch {
+    std::vector<unsigned char> band;  // kReadBandRows raw rows of one plane
+    std::vector<unsigned char> sums;  // Area mode: BoxSum accumulator, one per source column
+};
+
+// Per handler thread and reused from request to request, so preprocessing
+// allocates only when an image is larger than any before it
+struct PreprocessScratch {
+    std::vector<BandScratch> parts;   // One per thread reading the frame
+    std::vector<float> decimated;     // Area mode: [plane][row][column] box means
+    AxisTaps x_taps;
+    AxisTaps y_taps;                  // i0/i1 index `needed`, not source rows
+    std::vector<int> needed;          // Rows the vertical pass blends, ascending
+    std::vector<float> rows;          // [needed row][plane][model width], not normalized
+    std::vector<float> line;          // One blended output row, [plane][model width]
+    long depth = 0;
+    float min_val = 0;
+    float max_val = 0;
 };
 
 // RAII wrapper for cfitsio file handle
@@ -46,9 +80,14 @@ struct FitsFile {
     FitsFile& operator=(const FitsFile&) = delete;
 };
 
-static FitsImage read_fits_image(const std::string& path) {
-    FitsFile fits(path);
+struct FitsGeometry {
+    long width;
+    long height;
+    long depth;
+    int pixel_type;  // Equivalent BITPIX, after BZERO/BSCALE
+};
 
+static FitsGeometry open_image(FitsFile& fits) {
     // If the primary HDU is empty (NAXIS==0), move to the first image HDU.
     // This handles compressed FITS files where the image is in an extension.
     int naxis = 0;
@@ -69,7 +108,9 @@ static FitsImage read_fits_image(const std::string& path) {
     }
 
     long naxes[3] = {1, 1, 1};
+    int pixel_type = 0;
     fits_get_img_size(fits.fptr, std::min(naxis, 3), naxes, &fits.status);
+    fits_get_img_equivtype(fits.fptr, &pixel_type, &fits.status);
     if (fits.status) {
         char msg[80];
         fits_get_errstatus(fits.status, msg);
@@ -79,87 +120,268 @@ static FitsImage read_fits_image(const std::string& path) {
     long width  = naxes[0]; // NAXIS1
     long height = naxes[1]; // NAXIS2
     long depth  = (naxis >= 3) ? naxes[2] : 1; // NAXIS3 or 1
+    return {width, height, depth, pixel_type};
+}
 
-    // Read all pixels as float (cfitsio converts any BITPIX automatically)
-    long nelements = width * height * depth;
-    std::vector<float> pixels(nelements);
-    long fpixel[3] = {1, 1, 1}; // FITS is 1-indexed
-    fits_read_pix(fits.fptr, TFLOAT, fpixel, nelements,
-                  nullptr, pixels.data(), nullptr, &fits.status);
+static void read_band(FitsFile& fits, int datatype, long plane, long row, long rows, long width,
+                      void* band) {
+    long fpixel[3] = {1, row + 1, plane + 1}; // FITS is 1-indexed
+    fits_read_pix(fits.fptr, datatype, fpixel, rows * width, nullptr, band, nullptr, &fits.status);
     if (fits.status) {
         char msg[80];
         fits_get_errstatus(fits.status, msg);
         throw std::runtime_error("Failed to read FITS pixels: " + std::string(msg));
     }
+}
+
+// Calls fn(T{}, datatype) with the C type a FITS image of `pixel_type` is
+// read as: integers up to 32 bits as stored, anything else (floating point,
+// scaled integers, 64-bit) as float, converted by cfitsio
+template <typename Fn>
+static void with_pixel_type(int pixel_type, Fn&& fn) {
+    switch (pixel_type) {
+    case BYTE_IMG:   fn(static_cast<unsigned char>(0), TBYTE); break;
+    case SHORT_IMG:  fn(static_cast<short>(0), TSHORT); break;
+    case USHORT_IMG: fn(static_cast<unsigned short>(0), TUSHORT); break;
+    case LONG_IMG:   fn(0, TINT); break;
+    default:         fn(0.0f, TFLOAT); break;
+    }
+}
 
-    // Normalize to [0, 1]
-    float min_val = *std::min_element(pixels.begin(), pixels.end());
-    float max_val = *std::max_element(pixels.begin(), pixels.end());
-    float range = max_val - min_val;
-    if (range > 0) {
-        for (auto& p : pixels) {
-            p = (p - min_val) / range;
+// Taps of the bilinear resize from src_w x src_h to dst_w x dst_h, with the
+// vertical taps renumbered to the rows they need, which come in ascending
+// order
+static void plan_resize(PreprocessScratch& scratch, long src_w, long src_h, int dst_w, int dst_h) {
+    scratch.x_taps.build(static_cast<int>(src_w), dst_w);
+    scratch.y_taps.build(static_cast<int>(src_h), dst_h);
+    scratch.needed.clear();
+    for (int y = 0; y < dst_h; ++y) {
+        for (int* tap : {&scratch.y_taps.i0[y], &scratch.y_taps.i1[y]}) {
+            if (scratch.needed.empty() || scratch.needed.back() != *tap) {
+                scratch.needed.push_back(*tap);
+            }
+            *tap = static_cast<int>(scratch.needed.size()) - 1;
         }
     }
+    scratch.rows.resize(scratch.needed.size() * scratch.depth * dst_w);
+}
+
+// Reads every pixel once, in its stored type, a band of rows at a time: each
+// band is scanned for the value range, and the rows the resize needs are
+// resized horizontally on the spot. The full-resolution image is never held
+// in memory, and a large image stops early past the deadline.
+template <typename T>
+static void read_resampled(FitsFile& fits, const FitsGeometry& geometry, int datatype,
+                           Clock::time_point deadline, PreprocessScratch& scratch) {
+    const long width = geometry.width;
+    const long height = geometry.height;
+    const size_t dst_w = scratch.x_taps.f.size();
 
-    int channels = static_cast<int>(depth);
+    scratch.parts.resize(std::max<size_t>(scratch.parts.size(), 1));
+    std::vector<unsigned char>& buffer = scratch.parts[0].band;
+    buffer.resize(kReadBandRows * width * sizeof(T));
+    T* band = reinterpret_cast<T*>(buffer.data());
 
-    if (channels == 1) {
-        // Grayscale: replicate to 3 channels for the RGB model
-        std::vector<float> rgb(height * width * 3);
-        for (long i = 0; i < height * width; ++i) {
-            rgb[i * 3 + 0] = pixels[i];
-            rgb[i * 3 + 1] = pixels[i];
-            rgb[i * 3 + 2] = pixels[i];
+    PixelRange<T> range;
+    for (long c = 0; c < geometry.depth; ++c) {
+        size_t next = 0;  // Into scratch.needed
+        for (long y = 0; y < height; y += kReadBandRows) {
+            check_deadline(deadline, "FITS read");
+            long rows = std::min(kReadBandRows, height - y);
+            read_band(fits, datatype, c, y, rows, width, band);
+
+            scan_range(band, static_cast<size_t>(rows * width), range);
+            for (; next < scratch.needed.size() && scratch.needed[next] < y + rows; ++next) {
+                resample_row(band + (scratch.needed[next] - y) * width, scratch.x_taps,
+                             scratch.rows.data() + (next * geometry.depth + c) * dst_w);
+            }
         }
-        return {std::move(rgb), static_cast<int>(height), static_cast<int>(width), 3};
     }
+    scratch.min_val = static_cast<float>(range.min);
+    scratch.max_val = static_cast<float>(range.max);
+}
+
+// Area mode: the frame is cut into kx x ky boxes, as many as fit, centered
+// (the at most kx - 1 columns and ky - 1 rows left over are split between
+// the edges), and each box is averaged into one pixel
+struct BoxGrid {
+    long kx;
+    long ky;
+    long x_offset;
+    long y_offset;
+    long width;   // Boxes across
+    long height;  // Boxes down
+};
+
+static BoxGrid box_grid(const FitsGeometry& geometry, int dst_w, int dst_h) {
+    BoxGrid grid;
+    grid.kx = std::max(1L, geometry.width / dst_w);
+    grid.ky = std::max(1L, geometry.height / dst_h);
+    grid.width = geometry.width / grid.kx;
+    grid.height = geometry.height / grid.ky;
+    grid.x_offset = geometry.width % grid.kx / 2;
+    grid.y_offset = geometry.height % grid.ky / 2;
+    return grid;
+}
+
+// Box-averages source rows [row_begin, row_end) of every plane, which start
+// on a box boundary (or at the top), into scratch.decimated; every row is
+// scanned for the value range
+template <typename T>
+static void decimate_rows(FitsFile& fits, const FitsGeometry& geometry, int datatype,
+                          const BoxGrid& grid, long row_begin, long row_end,
+                          Clock::time_point deadline, BandScratch& part, PixelRange<T>& range,
+                          float* decimated) {
+    const long width = geometry.width;
+    const long box_rows_end = grid.y_offset + grid.height * grid.ky;
+    const float inv_area = 1.0f / static_cast<float>(grid.kx * grid.ky);
+
+    part.band.resize(kReadBandRows * width * sizeof(T));
+    part.sums.resize(grid.width * grid.kx * sizeof(BoxSum<T>));
+    T* band = reinterpret_cast<T*>(part.band.data());
+    BoxSum<T>* sums = reinterpret_cast<BoxSum<T>*>(part.sums.data());
+
+    for (long c = 0; c < geometry.depth; ++c) {
+        for (long y = row_begin; y < row_end; y += kReadBandRows) {
+            check_deadline(deadline, "FITS read");
+            long rows = std::min(kReadBandRows, row_end - y);
+            read_band(fits, datatype, c, y, rows, width, band);
+            scan_range(band, static_cast<size_t>(rows * width), range);
 
-    // Multi-channel: FITS stores planes sequentially [plane0][plane1][plane2]
-    // Convert to interleaved HWC layout
-    std::vector<float> hwc(height * width * channels);
-    for (long y = 0; y < height; ++y) {
-        for (long x = 0; x < width; ++x) {
-            for (int c = 0; c < channels; ++c) {
-                hwc[(y * width + x) * channels + c] =
-                    pixels[c * height * width + y * width + x];
+            for (long r = std::max(y, grid.y_offset); r < std::min(y + rows, box_rows_end); ++r) {
+                const long box_row = (r - grid.y_offset) / grid.ky;
+                const long row_in_box = (r - grid.y_offset) % grid.ky;
+                if (row_in_box == 0) {
+                    std::fill(sums, sums + grid.width * grid.kx, BoxSum<T>(0));
+                }
+                accumulate_row(band + (r - y) * width + grid.x_offset,
+                               static_cast<size_t>(grid.width * grid.kx), sums);
+                if (row_in_box == grid.ky - 1) {
+                    reduce_boxes(sums, static_cast<size_t>(grid.width), static_cast<size_t>(grid.kx),
+                                 inv_area, decimated + (c * grid.height + box_row) * grid.width);
+                }
             }
         }
     }
-    return {std::move(hwc), static_cast<int>(height), static_cast<int>(width), channels};
 }
 
-// Bilinear interpolation resize for HWC float data
-static std::vector<float> bilinear_resize(
-        const float* src, int src_h, int src_w, int channels,
-        int dst_h, int dst_w) {
-    std::vector<float> dst(dst_h * dst_w * channels);
+// Area mode: box-averages the frame, with up to `threads` threads each
+// reading its own share of box rows through its own file handle, then
+// resizes the box means horizontally like read_resampled does the frame
+template <typename T>
+static void read_decimated(FitsFile& fits, const std::string& path, const FitsGeometry& geometry,
+                           int datatype, const BoxGrid& grid, unsigned threads,
+                           Clock::time_point deadline, PreprocessScratch& scratch) {
+    const long parts = std::max(1L, std::min<long>(threads, grid.height));
+    scratch.parts.resize(std::max<size_t>(scratch.parts.size(), parts));
+    scratch.decimated.resize(geometry.depth * grid.height * grid.width);
 
-    for (int y = 0; y < dst_h; ++y) {
-        float src_y = (y + 0.5f) * src_h / dst_h - 0.5f;
-        int y0 = std::max(0, static_cast<int>(std::floor(src_y)));
-        int y1 = std::min(src_h - 1, y0 + 1);
-        float fy = src_y - static_cast<float>(y0);
-
-        for (int x = 0; x < dst_w; ++x) {
-            float src_x = (x + 0.5f) * src_w / dst_w - 0.5f;
-            int x0 = std::max(0, static_cast<int>(std::floor(src_x)));
-            int x1 = std::min(src_w - 1, x0 + 1);
-            float fx = src_x - static_cast<float>(x0);
-
-            for (int c = 0; c < channels; ++c) {
-                float v00 = src[(y0 * src_w + x0) * channels + c];
-                float v01 = src[(y0 * src_w + x1) * channels + c];
-                float v10 = src[(y1 * src_w + x0) * channels + c];
-                float v11 = src[(y1 * src_w + x1) * channels + c];
-
-                dst[(y * dst_w + x) * channels + c] =
-                    (1 - fy) * ((1 - fx) * v00 + fx * v01) +
-                    fy * ((1 - fx) * v10 + fx * v11);
+    // Part p takes box rows [p * height / parts, (p + 1) * height / parts);
+    // the first and last also take the rows left over at the edges, which
+    // only count towards the value range
+    std::vector<PixelRange<T>> ranges(parts);
+    std::vector<std::exception_ptr> errors(parts);
+    auto run_part = [&](long p, FitsFile& file) {
+        try {
+            const long begin = p == 0 ? 0 : grid.y_offset + p * grid.height / parts * grid.ky;
+            const long end = p == parts - 1 ? geometry.height
+                                            : grid.y_offset + (p + 1) * grid.height / parts * grid.ky;
+            decimate_rows(file, geometry, datatype, grid, begin, end, deadline, scratch.parts[p],
+                          ranges[p], scratch.decimated.data());
+        } catch (...) {
+            errors[p] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    helpers.reserve(parts - 1);
+    for (long p = 1; p < parts; ++p) {
+        helpers.emplace_back([&, p] {
+            try {
+                FitsFile file(path);
+                open_image(file);
+                run_part(p, file);
+            } catch (...) {
+                errors[p] = std::current_exception();
             }
+        });
+    }
+    run_part(0, fits);
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    PixelRange<T> range;
+    for (const auto& part : ranges) {
+        range.add(part);
+    }
+    scratch.min_val = static_cast<float>(range.min);
+    scratch.max_val = static_cast<float>(range.max);
+
+    const size_t dst_w = scratch.x_taps.f.size();
+    for (long c = 0; c < geometry.depth; ++c) {
+        for (size_t k = 0; k < scratch.needed.size(); ++k) {
+            resample_row(scratch.decimated.data() + (c * grid.height + scratch.needed[k]) * grid.width,
+                         scratch.x_taps, scratch.rows.data() + (k * geometry.depth + c) * dst_w);
+        }
+    }
+}
+
+// Decodes the image at `path` as far as the resize to dst_h x dst_w allows
+// without knowing its value range
+static void read_fits_image(const std::string& path, const PreprocessOptions& options,
+                            Clock::time_point deadline, int dst_h, int dst_w, int dst_c,
+                            PreprocessScratch& scratch) {
+    FitsFile fits(path);
+    const FitsGeometry geometry = open_image(fits);
+    if (geometry.depth != 1 && geometry.depth != dst_c) {
+        throw std::runtime_error(
+            "FITS image has " + std::to_string(geometry.depth) + " planes, model expects " +
+            std::to_string(dst_c) + " channels");
+    }
+    scratch.depth = geometry.depth;
+
+    // A frame less than twice the model input has no whole boxes to average
+    const BoxGrid grid = box_grid(geometry, dst_w, dst_h);
+    const bool area = options.resize_mode == ResizeMode::Area && (grid.kx > 1 || grid.ky > 1);
+
+    with_pixel_type(geometry.pixel_type, [&](auto zero, int datatype) {
+        using T = decltype(zero);
+        if (area) {
+            plan_resize(scratch, grid.width, grid.height, dst_w, dst_h);
+            read_decimated<T>(fits, path, geometry, datatype, grid, options.threads, deadline, scratch);
+        } else {
+            plan_resize(scratch, geometry.width, geometry.height, dst_w, dst_h);
+            read_resampled<T>(fits, geometry, datatype, deadline, scratch);
         }
+    });
+}
+
+// Finishes the resize vertically into HWC float `dst`, normalized to [0, 1].
+// A single plane is replicated to every channel; otherwise the planes map to
+// the channels one to one.
+static void write_normalized(PreprocessScratch& scratch, float* dst, int dst_h, int dst_w, int dst_c) {
+    // Interpolation is linear, so normalizing the result is the same as
+    // normalizing the source
+    const float range = scratch.max_val - scratch.min_val;
+    const float offset = range > 0 ? scratch.min_val : 0.0f;
+    const float scale = range > 0 ? 1.0f / range : 1.0f;
+
+    const size_t planes = static_cast<size_t>(scratch.depth);
+    const size_t row_size = planes * dst_w;
+    scratch.line.resize(row_size);
+    for (int y = 0; y < dst_h; ++y) {
+        const float* row0 = scratch.rows.data() + scratch.y_taps.i0[y] * row_size;
+        const float* row1 = scratch.rows.data() + scratch.y_taps.i1[y] * row_size;
+        blend_rows(row0, row1, scratch.y_taps.f[y], row_size, offset, scale, scratch.line.data());
+        interleave_rows(scratch.line.data(), planes, dst_w,
+                        dst + static_cast<size_t>(y) * dst_w * dst_c, dst_c);
     }
-    return dst;
 }
 
 static nlohmann::json classifications_to_json(const std::vector<Classification>& results) {
@@ -172,34 +394,70 @@ static nlohmann::json classifications_to_json(const std::vector<Classification>&
     return j;
 }
 
-ProcessResult process_image(SnpeWorker& worker,
+int response_status(const ProcessResult& result) {
+    if (result.shed) {
+        return 503;
+    }
+    return result.success ? 200 : 422;
+}
+
+bool fits_reads_thread_safe() {
+    return fits_is_reentrant() != 0;
+}
+
+ProcessResult process_image(InferencePool& pool,
+                            const PreprocessOptions& options,
                             const std::string& image_path,
-                            double /*timeout_seconds*/) {
+                            double timeout_seconds) {
+    const auto start = Clock::now();
+    const auto deadline = start +
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout_seconds));
+
+    // Shed up front what the recent latencies say cannot finish in time;
+    // the caller is better off moving on to its next image now
+    if (start + preprocess_latency.get() + pool.expected_latency() > deadline) {
+        return {false, "Cannot finish within timeoutSeconds at the current load", {}, true};
+    }
+
     if (!fs::exists(image_path)) {
         return {false, "Image file does not exist: " + image_path, {}};
     }
 
+    // Preprocessing time, for the estimate also when a deadline cuts it short
+    bool decoded = false;
+    bool recorded = false;
+    Clock::duration work{};
     try {
-        auto fits = read_fits_image(image_path);
+        // Decode first, then lease: a leased slot holds its batch open, so
+        // only the last, vertical step of the resize happens while holding one
+        const int dst_h = static_cast<int>(pool.input_height());
+        const int dst_w = static_cast<int>(pool.input_width());
+        const int dst_c = static_cast<int>(pool.input_channels());
+        static thread_local PreprocessScratch scratch;
+        read_fits_image(image_path, options, deadline, dst_h, dst_w, dst_c, scratch);
+        work = Clock::now() - start;
+        decoded = true;
 
-        // Resize to model's expected dimensions if needed
-        std::vector<float> image_data;
-        int target_h = static_cast<int>(worker.input_height());
-        int target_w = static_cast<int>(worker.input_width());
+        InputSlot slot = pool.acquire(deadline);
+        const auto write_start = Clock::now();
+        write_normalized(scratch, slot.data(), dst_h, dst_w, dst_c);
+        work += Clock::now() - write_start;
+        preprocess_latency.update(work);
+        recorded = true;
+        check_deadline(deadline, "preprocessing");
 
-        if (fits.height == target_h && fits.width == target_w &&
-            fits.channels == static_cast<int>(worker.input_channels())) {
-            image_data = std::move(fits.data);
-        } else {
-            image_data = bilinear_resize(
-                fits.data.data(), fits.height, fits.width, fits.channels,
-                target_h, target_w);
-        }
-
-        auto results = worker.infer(image_data);
+        auto results = pool.infer(std::move(slot));
         auto json_results = classifications_to_json(results);
 
         return {true, "", json_results};
+    } catch (const DeadlineExceeded& e) {
+        // A read cut off by the deadline would have taken at least this long.
+        // Leaving it out would keep the estimate low exactly when decodes
+        // start to overrun, and requests that cannot finish would be admitted.
+        if (!recorded) {
+            preprocess_latency.update_at_least(decoded ? work : Clock::now() - start);
+        }
+        return {false, e.what(), {}, true};
     } catch (const std::exception& e) {
         return {false, e.what(), {}};
     }
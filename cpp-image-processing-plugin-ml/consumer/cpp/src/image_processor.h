@@ -3,14 +3,38 @@
 #include <nlohmann/json.hpp>
 #include <string>
 
-class SnpeWorker;
+class InferencePool;
+
+// How a frame is shrunk to the model input
+enum class ResizeMode {
+    Bilinear,  // Four source pixels per output pixel
+    Area,      // Average of integer-factor boxes, then bilinear for the remainder
+};
+
+struct PreprocessOptions {
+    ResizeMode resize_mode = ResizeMode::Bilinear;
+    unsigned threads = 1;  // Threads reading one frame in Area mode
+};
 
 struct ProcessResult {
     bool success;
     std::string error;
     nlohmann::json classifications; // JSON array of classification results
+    bool shed = false;              // Dropped to meet timeout_seconds, not for the image
 };
 
-ProcessResult process_image(SnpeWorker& worker,
+// Gives up, with shed set, as soon as the image cannot be classified within
+// timeout_seconds: up front from the recent latencies, then between stages
+// and while waiting for inference.
+ProcessResult process_image(InferencePool& pool,
+                            const PreprocessOptions& options,
                             const std::string& image_path,
                             double timeout_seconds);
+
+// HTTP status of a result: 200 on success, 503 if it was shed to meet its
+// deadline (the consumer is overloaded, not the image bad), otherwise 422
+int response_status(const ProcessResult& result);
+
+// Whether cfitsio was built reentrant, so that several threads may read one
+// frame through their own file handles
+bool fits_reads_thread_safe();
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+// Input geometry of a network, HWC float
+struct InputShape {
+    size_t height = 0;
+    size_t width = 0;
+    size_t channels = 0;
+
+    size_t size() const { return height * width * channels; }
+};
+
+// One independently built network instance with its own input and output
+// tensors for max_batch() images, allocated once at construction. Not
+// thread-safe: the pool hands each instance to a single worker thread.
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() = default;
+
+    virtual const InputShape& input_shape() const = 0;
+
+    // Images per execute(); the network's batch dimension
+    virtual size_t max_batch() const { return 1; }
+
+    // input_shape().size() floats of image `item` < max_batch(), written
+    // before each execute()
+    virtual float* input(size_t item) = 0;
+
+    // Runs the network on the first `batch` images (a fixed-batch network may
+    // compute all max_batch()); throws std::runtime_error on failure
+    virtual void execute(size_t batch) = 0;
+
+    // output_size() scores of image `item` from the last execute(), valid
+    // until the next one
+    virtual const float* output(size_t item) const = 0;
+    virtual size_t output_size() const = 0;
+};
@@ -0,0 +1,413 @@
+#include "inference_pool.h"
+
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+std::vector<std::string> load_labels(const std::string& path) {
+    std::vector<std::string> labels;
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open labels file: " + path);
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        labels.push_back(line);
+    }
+    return labels;
+}
+
+InferencePool::Clock::duration InferencePool::LatencyModel::expected(size_t batch) const {
+    // An unmeasured size is assumed to take as long as the largest measured one
+    Clock::duration longest{0};
+    for (size_t size = 1; size < by_batch.size(); ++size) {
+        if (size == batch && by_batch[size].count() > 0) {
+            return by_batch[size];
+        }
+        longest = std::max(longest, by_batch[size]);
+    }
+    return longest;
+}
+
+void InferencePool::LatencyModel::update(size_t batch, Clock::duration measured) {
+    if (batch >= by_batch.size()) {
+        return;
+    }
+    Clock::duration& estimate = by_batch[batch];
+    estimate = estimate.count() == 0 ? measured : estimate + (measured - estimate) / 8;
+}
+
+InputSlot::InputSlot(InputSlot&& other) noexcept
+    : pool_(other.pool_), instance_(other.instance_), item_(other.item_),
+      data_(other.data_), size_(other.size_) {
+    other.pool_ = nullptr;
+}
+
+InputSlot& InputSlot::operator=(InputSlot&& other) noexcept {
+    if (this != &other) {
+        if (pool_) {
+            pool_->release(*this);
+        }
+        pool_ = other.pool_;
+        instance_ = other.instance_;
+        item_ = other.item_;
+        data_ = other.data_;
+        size_ = other.size_;
+        other.pool_ = nullptr;
+    }
+    return *this;
+}
+
+InputSlot::~InputSlot() {
+    if (pool_) {
+        pool_->release(*this);
+    }
+}
+
+InferencePool::InferencePool(std::vector<std::unique_ptr<InferenceBackend>> instances,
+                             std::vector<std::string> labels,
+                             std::chrono::microseconds batch_window)
+    : batch_window_(batch_window),
+      labels_(std::move(labels)) {
+    if (instances.empty()) {
+        throw std::runtime_error("Inference pool needs at least one network instance");
+    }
+    input_shape_ = instances.front()->input_shape();
+    for (auto& backend : instances) {
+        if (backend->input_shape().size() != input_shape_.size()) {
+            throw std::runtime_error("Network instances disagree on the input shape");
+        }
+        auto instance = std::make_unique<Instance>();
+        instance->slots = std::vector<Slot>(backend->max_batch());
+        instance->backend = std::move(backend);
+        batch_capacity_ += instance->slots.size();
+        instances_.push_back(std::move(instance));
+    }
+
+    workers_.reserve(instances_.size());
+    for (auto& instance : instances_) {
+        workers_.emplace_back(&InferencePool::run_worker, this, std::ref(*instance));
+    }
+}
+
+InferencePool::~InferencePool() {
+    stopping_ = true;
+    for (auto& instance : instances_) {
+        std::lock_guard<std::mutex> lock(instance->mutex);
+        instance->work_cv.notify_all();
+    }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+InputSlot InferencePool::acquire(Clock::time_point deadline) {
+    InputSlot lease;
+    if (try_lease(deadline, lease)) {
+        return lease;
+    }
+
+    // Counted as waiting before looking again, under the lock the wait is on.
+    // A slot is freed before its releaser checks waiting_ (all sequentially
+    // consistent), so a slot freed after the last look is either seen by the
+    // next one or notified.
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    ++waiting_;
+    // No use waiting for a slot once there is no time left to run it
+    const bool bounded = deadline != Clock::time_point::max();
+    const Clock::time_point give_up = bounded ? deadline - batch_latency_.get() : deadline;
+    while (!try_lease(deadline, lease)) {
+        if (!bounded) {
+            slot_cv_.wait(lock);
+        } else if (slot_cv_.wait_until(lock, give_up) == std::cv_status::timeout) {
+            if (try_lease(deadline, lease)) {
+                break;
+            }
+            --waiting_;
+            throw DeadlineExceeded("No inference slot freed up before the deadline");
+        }
+    }
+    --waiting_;
+    return lease;
+}
+
+bool InferencePool::try_lease(Clock::time_point deadline, InputSlot& lease) {
+    for (;;) {
+        const size_t index = open_instance();
+        if (index == instances_.size()) {
+            return false;
+        }
+
+        // The counters may have moved since open_instance() read them
+        Instance& instance = *instances_[index];
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        if (instance.executing || instance.taken == instance.slots.size()) {
+            continue;
+        }
+        size_t item = 0;
+        while (instance.slots[item].state != Slot::State::Free) {
+            ++item;
+        }
+        Slot& slot = instance.slots[item];
+        slot.state = Slot::State::Leased;
+        slot.arrival = Clock::now();
+        slot.deadline = deadline;
+        slot.results.clear();
+        slot.error.clear();
+        slot.expired = false;
+        ++instance.leased;
+        ++instance.taken;
+        ++pending_;
+        instance.work_cv.notify_one();
+
+        lease.pool_ = this;
+        lease.instance_ = index;
+        lease.item_ = item;
+        lease.data_ = instance.backend->input(item);
+        lease.size_ = input_shape_.size();
+        return true;
+    }
+}
+
+void InferencePool::notify_slot_freed(bool all) {
+    // Called after the instance lock is released; see acquire()
+    if (waiting_ == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    if (all) {
+        slot_cv_.notify_all();
+    } else {
+        slot_cv_.notify_one();
+    }
+}
+
+std::vector<Classification> InferencePool::infer(InputSlot lease, size_t top_n) {
+    if (lease.pool_ != this) {
+        throw std::runtime_error("Input slot was not leased from this pool");
+    }
+    Instance& instance = *instances_[lease.instance_];
+    Slot& slot = instance.slots[lease.item_];
+
+    std::unique_lock<std::mutex> lock(instance.mutex);
+    lease.pool_ = nullptr;  // The worker gives the slot back from here on
+    slot.top_n = top_n;
+    slot.state = Slot::State::Ready;
+    --instance.leased;
+    ++instance.ready;
+    instance.work_cv.notify_one();
+
+    slot.done_cv.wait(lock, [&slot] { return slot.state == Slot::State::Done; });
+    std::vector<Classification> results = std::move(slot.results);
+    std::string error = std::move(slot.error);
+    const bool expired = slot.expired;
+    slot.state = Slot::State::Free;
+    --instance.taken;
+    lock.unlock();
+    notify_slot_freed(false);
+
+    if (expired) {
+        throw DeadlineExceeded(error);
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+    return results;
+}
+
+void InferencePool::release(InputSlot& lease) {
+    Instance& instance = *instances_[lease.instance_];
+    {
+        std::lock_guard<std::mutex> lock(instance.mutex);
+        instance.slots[lease.item_].state = Slot::State::Free;
+        --instance.leased;
+        --instance.taken;
+        --pending_;
+        instance.work_cv.notify_one();
+    }
+    lease.pool_ = nullptr;
+    notify_slot_freed(false);
+}
+
+InferencePool::Clock::duration InferencePool::expected_latency() const {
+    // Rounds of batches ahead of a new request, plus its own; with no slot
+    // free, on average half a batch more until one is
+    const Clock::duration batch = batch_latency_.get();
+    const size_t rounds = (pending_ + waiting_) / batch_capacity_ + 1;
+    Clock::duration expected = batch * static_cast<Clock::rep>(rounds);
+    if (open_instance() == instances_.size()) {
+        expected += batch / 2;
+    }
+    return expected;
+}
+
+size_t InferencePool::open_instance() const {
+    // The fullest batch that still has room, so batches fill before another
+    // instance starts one; instances_.size() if every slot is taken. Read
+    // without the instance locks, so only a hint for try_lease().
+    size_t best = instances_.size();
+    size_t best_taken = 0;
+    if (stopping_) {
+        return best;
+    }
+    for (size_t i = 0; i < instances_.size(); ++i) {
+        const Instance& instance = *instances_[i];
+        if (instance.executing) {
+            continue;
+        }
+        const size_t taken = instance.taken;
+        if (taken < instance.slots.size() && (best == instances_.size() || taken > best_taken)) {
+            best = i;
+            best_taken = taken;
+        }
+    }
+    return best;
+}
+
+void InferencePool::run_worker(Instance& instance) {
+    LatencyModel latency;
+    latency.by_batch.assign(instance.slots.size() + 1, Clock::duration(0));
+    std::vector<size_t> batch;
+    batch.reserve(instance.slots.size());
+
+    std::unique_lock<std::mutex> lock(instance.mutex);
+    for (;;) {
+        instance.work_cv.wait(lock, [&] { return instance.ready > 0 || stopping_; });
+        if (instance.ready == 0) {
+            return;
+        }
+        collect_batch(instance, latency, lock);
+        run_batch(instance, latency, batch, lock);
+    }
+}
+
+void InferencePool::collect_batch(Instance& instance, const LatencyModel& latency,
+                                  std::unique_lock<std::mutex>& lock) {
+    for (;;) {
+        Clock::time_point first_arrival = Clock::time_point::max();
+        Clock::time_point earliest_deadline = Clock::time_point::max();
+        for (const Slot& slot : instance.slots) {
+            if (slot.state == Slot::State::Leased || slot.state == Slot::State::Ready) {
+                first_arrival = std::min(first_arrival, slot.arrival);
+                earliest_deadline = std::min(earliest_deadline, slot.deadline);
+            }
+        }
+        const size_t taken = instance.leased + instance.ready;
+        if (taken >= instance.slots.size() || stopping_) {
+            break;
+        }
+
+        // Wait for one more only while the batch that would make still
+        // finishes before the earliest deadline in it, with a quarter of its
+        // expected time to spare for jitter
+        Clock::time_point close = first_arrival + batch_window_;
+        if (earliest_deadline != Clock::time_point::max()) {
+            const Clock::duration expected = latency.expected(taken + 1);
+            close = std::min(close, earliest_deadline - expected - expected / 4);
+        }
+        if (Clock::now() >= close) {
+            break;
+        }
+        instance.work_cv.wait_until(lock, close);
+    }
+
+    // Take no new leases, and let the images still being written finish:
+    // the network reads the whole input tensor
+    instance.executing = true;
+    instance.work_cv.wait(lock, [&instance] { return instance.leased == 0; });
+}
+
+void InferencePool::run_batch(Instance& instance, LatencyModel& latency, std::vector<size_t>& batch,
+                              std::unique_lock<std::mutex>& lock) {
+    // Cancel what could no longer finish in time, then run the rest
+    const Clock::time_point finish = Clock::now() + latency.expected(instance.ready);
+    batch.clear();
+    for (size_t item = 0; item < instance.slots.size(); ++item) {
+        Slot& slot = instance.slots[item];
+        if (slot.state != Slot::State::Ready) {
+            continue;
+        }
+        if (finish > slot.deadline) {
+            slot.error = "Deadline would pass before inference finished";
+            slot.expired = true;
+            slot.state = Slot::State::Done;
+            --instance.ready;
+            --pending_;
+            slot.done_cv.notify_one();
+            continue;
+        }
+        batch.push_back(item);
+    }
+
+    if (!batch.empty()) {
+        // The batch's slots are the worker's until marked done, so the
+        // network runs and the results are picked out without the lock.
+        // Timed to the last result, which is what a deadline has to cover.
+        InferenceBackend& backend = *instance.backend;
+        lock.unlock();
+        const Clock::time_point start = Clock::now();
+        std::string error;
+        try {
+            // The network runs a prefix of its input tensor. Images behind a
+            // slot that is free, cancelled or not yet collected move up into
+            // it; such a slot's input is not read again. Ascending, so an
+            // image is moved before its own place is written.
+            for (size_t k = 0; k < batch.size(); ++k) {
+                if (batch[k] != k) {
+                    std::copy_n(backend.input(batch[k]), input_shape_.size(), backend.input(k));
+                }
+            }
+            backend.execute(batch.size());
+            for (size_t k = 0; k < batch.size(); ++k) {
+                Slot& slot = instance.slots[batch[k]];
+                slot.results = top_results(backend.output(k), backend.output_size(), slot.top_n);
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        const Clock::duration elapsed = Clock::now() - start;
+        lock.lock();
+
+        // Hand the results back to the waiting handlers
+        for (size_t item : batch) {
+            Slot& slot = instance.slots[item];
+            slot.error = error;
+            slot.state = Slot::State::Done;
+            --instance.ready;
+            --pending_;
+            slot.done_cv.notify_one();
+        }
+        if (error.empty()) {
+            latency.update(batch.size(), elapsed);
+            batch_latency_.update(elapsed);
+        }
+    }
+
+    instance.executing = false;
+    lock.unlock();
+    notify_slot_freed(true);
+    lock.lock();
+}
+
+std::vector<Classification> InferencePool::top_results(const float* scores,
+                                                       size_t count,
+                                                       size_t top_n) const {
+    std::vector<int> indices(count);
+    std::iota(indices.begin(), indices.end(), 0);
+    size_t n = std::min(top_n, count);
+    std::partial_sort(indices.begin(), indices.begin() + n, indices.end(),
+                      [scores](int a, int b) { return scores[a] > scores[b]; });
+
+    std::vector<Classification> results;
+    results.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        int idx = indices[i];
+        std::string label = (static_cast<size_t>(idx) < labels_.size())
+                                ? labels_[idx]
+                                : "unknown";
+        results.push_back({idx, scores[idx], label});
+    }
+    return results;
+}
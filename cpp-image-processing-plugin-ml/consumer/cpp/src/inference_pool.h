@@ -0,0 +1,172 @@
+#pragma once
+
+#include "inference_backend.h"
+#include "latency_estimate.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Classification {
+    int index;
+    float confidence;
+    std::string label;
+};
+
+std::vector<std::string> load_labels(const std::string& path);
+
+// A request dropped because it could no longer finish before its deadline
+class DeadlineExceeded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+class InferencePool;
+
+// One image's place in a network instance's input tensor, leased from the
+// pool. The handler writes its preprocessed image straight into data() and
+// hands the slot to InferencePool::infer(); a slot dropped without that is
+// given back.
+class InputSlot {
+public:
+    InputSlot() = default;
+    InputSlot(InputSlot&& other) noexcept;
+    InputSlot& operator=(InputSlot&& other) noexcept;
+    ~InputSlot();
+
+    float* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    friend class InferencePool;
+
+    InferencePool* pool_ = nullptr;
+    size_t instance_ = 0;
+    size_t item_ = 0;
+    float* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// A fixed set of network instances, each owned by its own worker thread.
+// HTTP handlers lease a slot in an instance's input tensor, write their image
+// into it, and wait for the result, so requests run concurrently on as many
+// instances as there are and an image is never copied on its way in. An
+// instance takes no new leases while it executes; the others keep theirs
+// open, so one can be executing while the rest are being written.
+//
+// Instances with max_batch() > 1 run micro-batches: a lease goes to the
+// instance with the fullest open batch, and a worker keeps its batch open for
+// up to batch_window after the first lease, as long as the earliest deadline
+// in it still leaves time for the expected execution.
+//
+// A request that could no longer finish before its deadline, whether still
+// waiting for a slot or already in a batch, is cancelled instead of run: its
+// caller will have given up on it by then.
+//
+// Each instance has its own lock, so handlers and workers of different
+// instances never wait for each other. A lease picks its instance from
+// counters read without locking, and only handlers with no slot to lease
+// share the lock they wait on.
+class InferencePool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    InferencePool(std::vector<std::unique_ptr<InferenceBackend>> instances,
+                  std::vector<std::string> labels,
+                  std::chrono::microseconds batch_window = std::chrono::microseconds(0));
+    ~InferencePool();
+
+    InferencePool(const InferencePool&) = delete;
+    InferencePool& operator=(const InferencePool&) = delete;
+
+    // Leases a slot for one image, waiting for one to free up. A batch
+    // waiting for more images closes in time for `deadline`. Throws
+    // DeadlineExceeded if no slot frees up in time.
+    InputSlot acquire(Clock::time_point deadline = Clock::time_point::max());
+
+    // Runs the image written into `slot`; blocks the calling thread until it
+    // is done. Throws DeadlineExceeded if the image was cancelled for its
+    // deadline, std::runtime_error on a failed execution.
+    std::vector<Classification> infer(InputSlot slot, size_t top_n = 5);
+
+    // Expected time from now until a new request's results are back: the
+    // batches waiting ahead of it plus its own, from the measured batch
+    // times. Zero until the first batch has run.
+    Clock::duration expected_latency() const;
+
+    size_t instance_count() const { return workers_.size(); }
+    size_t input_size() const { return input_shape_.size(); }
+    size_t input_height() const { return input_shape_.height; }
+    size_t input_width() const { return input_shape_.width; }
+    size_t input_channels() const { return input_shape_.channels; }
+
+private:
+    friend class InputSlot;
+
+    // One image position in an instance's input tensor
+    struct Slot {
+        enum class State { Free, Leased, Ready, Done };
+
+        State state = State::Free;
+        size_t top_n = 0;
+        Clock::time_point arrival;
+        Clock::time_point deadline;
+        std::vector<Classification> results;
+        std::string error;
+        bool expired = false;
+        std::condition_variable done_cv;
+    };
+
+    // Slots and counters are guarded by `mutex`; `taken` and `executing`
+    // are written under it too, and read without it to pick an instance
+    struct Instance {
+        std::unique_ptr<InferenceBackend> backend;
+        std::vector<Slot> slots;      // One per batch item
+        size_t leased = 0;            // Slots being written
+        size_t ready = 0;             // Slots handed to infer() and not yet run
+        std::atomic<size_t> taken{0};         // Slots not free
+        std::atomic<bool> executing{false};   // Takes no new leases
+        std::mutex mutex;
+        std::condition_variable work_cv;
+    };
+
+    // Expected execution time by batch size, learned per instance
+    struct LatencyModel {
+        std::vector<Clock::duration> by_batch;   // Zero until measured
+
+        Clock::duration expected(size_t batch) const;
+        void update(size_t batch, Clock::duration measured);
+    };
+
+    void run_worker(Instance& instance);
+    void collect_batch(Instance& instance, const LatencyModel& latency,
+                       std::unique_lock<std::mutex>& lock);
+    void run_batch(Instance& instance, LatencyModel& latency, std::vector<size_t>& batch,
+                   std::unique_lock<std::mutex>& lock);
+    size_t open_instance() const;
+    bool try_lease(Clock::time_point deadline, InputSlot& lease);
+    void notify_slot_freed(bool all);
+    void release(InputSlot& slot);
+    std::vector<Classification> top_results(const float* scores, size_t count,
+                                            size_t top_n) const;
+
+    InputShape input_shape_;
+    std::chrono::microseconds batch_window_;
+    std::vector<std::string> labels_;
+    std::vector<std::unique_ptr<Instance>> instances_;
+    std::vector<std::thread> workers_;
+    size_t batch_capacity_ = 0;           // Images all instances run at once
+    LatencyEstimate batch_latency_;       // Any batch, any instance
+
+    std::mutex wait_mutex_;               // Handlers waiting for a slot
+    std::condition_variable slot_cv_;     // A slot was freed or an instance reopened
+    std::atomic<size_t> waiting_{0};      // Handlers waiting for a slot
+    std::atomic<size_t> pending_{0};      // Slots leased or ready, not yet run
+    std::atomic<bool> stopping_{false};
+};
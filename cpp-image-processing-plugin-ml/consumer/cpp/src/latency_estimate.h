@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Running mean of a duration (exponentially weighted, 1/8 per sample),
+// updated and read lock-free from any thread. Zero until the first sample.
+class LatencyEstimate {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration get() const {
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::nanoseconds(nanos_.load(std::memory_order_relaxed)));
+    }
+
+    void update(Clock::duration sample) {
+        const int64_t measured = std::chrono::duration_cast<std::chrono::nanoseconds>(sample).count();
+        int64_t current = nanos_.load(std::memory_order_relaxed);
+        int64_t next;
+        do {
+            next = current == 0 ? measured : current + (measured - current) / 8;
+        } while (!nanos_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+    }
+
+    // A duration known only to be at least `bound`, such as work cut off by
+    // its deadline: counts as a sample if it is above the estimate, and is
+    // ignored otherwise, since the work could have taken any longer
+    void update_at_least(Clock::duration bound) {
+        const int64_t measured = std::chrono::duration_cast<std::chrono::nanoseconds>(bound).count();
+        int64_t current = nanos_.load(std::memory_order_relaxed);
+        int64_t next;
+        do {
+            if (current != 0 && measured <= current) {
+                return;
+            }
+            next = current == 0 ? measured : current + (measured - current) / 8;
+        } while (!nanos_.compare_exchange_weak(current, next, std::memory_order_relaxed));
+    }
+
+private:
+    std::atomic<int64_t> nanos_{0};
+};
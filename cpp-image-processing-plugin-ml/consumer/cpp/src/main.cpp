@@ -1,34 +1,91 @@
 #include "image_processor.h"
+#include "inference_pool.h"
 #include "models.h"
-#include "snpe_worker.h"
+
+#ifdef HAVE_SNPE
+#include "snpe_backend.h"
 
 #include <SNPE/DlSystem/DlEnums.hpp>
+#endif
+#ifdef HAVE_CPU_STANDIN
+#include "cpu_standin_backend.h"
+#endif
 
 #include <crow.h>
+#include <chrono>
 #include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 static std::string env_or(const char* name, const std::string& fallback) {
     const char* val = std::getenv(name);
     return val ? val : fallback;
 }
 
-static DlSystem::Runtime_t parse_runtime(const std::string& name) {
-    static const std::unordered_map<std::string, DlSystem::Runtime_t> map = {
-        {"cpu",    DlSystem::Runtime_t::CPU_FLOAT32},
-        {"gpu",    DlSystem::Runtime_t::GPU_FLOAT32_16_HYBRID},
-        {"gpu16",  DlSystem::Runtime_t::GPU_FLOAT16},
-        {"dsp",    DlSystem::Runtime_t::DSP_FIXED8_TF},
-        {"aip",    DlSystem::Runtime_t::AIP_FIXED8_TF},
+// How to build one network instance for a runtime (with a batch dimension of
+// max_batch), and how many instances to run by default. Accelerator runtimes
+// take a few instances so one can be executing while the others have their
+// inputs written and outputs read; past that the accelerator is saturated
+// and more only add latency.
+struct RuntimeOption {
+    size_t default_instances;
+    std::function<std::unique_ptr<InferenceBackend>(const std::string& model_path, size_t max_batch)> build;
+};
+
+static RuntimeOption parse_runtime(const std::string& name) {
+#ifdef HAVE_SNPE
+    auto snpe = [](DlSystem::Runtime_t runtime) {
+        return [runtime](const std::string& model_path, size_t max_batch) -> std::unique_ptr<InferenceBackend> {
+            return std::make_unique<SnpeBackend>(model_path, runtime, max_batch);
+        };
+    };
+#endif
+#ifdef HAVE_CPU_STANDIN
+    // Emulated accelerator latency of the stand-in, STANDIN_LATENCY_MS
+    const auto standin_latency = std::chrono::microseconds(
+        static_cast<long long>(std::atof(env_or("STANDIN_LATENCY_MS", "0").c_str()) * 1000.0));
+#endif
+
+    const std::unordered_map<std::string, RuntimeOption> map = {
+#ifdef HAVE_SNPE
+        {"cpu",     {2, snpe(DlSystem::Runtime_t::CPU_FLOAT32)}},
+        {"gpu",     {2, snpe(DlSystem::Runtime_t::GPU_FLOAT32_16_HYBRID)}},
+        {"gpu16",   {2, snpe(DlSystem::Runtime_t::GPU_FLOAT16)}},
+        {"dsp",     {3, snpe(DlSystem::Runtime_t::DSP_FIXED8_TF)}},
+        {"aip",     {3, snpe(DlSystem::Runtime_t::AIP_FIXED8_TF)}},
+#endif
+#ifdef HAVE_CPU_STANDIN
+        {"standin", {4, [standin_latency](const std::string&, size_t max_batch) -> std::unique_ptr<InferenceBackend> {
+                         return std::make_unique<CpuStandInBackend>(InputShape{299, 299, 3}, 1001,
+                                                                    standin_latency, max_batch);
+                     }}},
+#endif
     };
 
     auto it = map.find(name);
     if (it != map.end()) return it->second;
 
-    std::cerr << "Unknown SNPE_RUNTIME '" << name
-              << "'. Options: cpu, gpu, gpu16, dsp, aip" << std::endl;
+    std::string options;
+    for (const auto& entry : map) {
+        options += (options.empty() ? "" : ", ") + entry.first;
+    }
+    std::cerr << "Unknown SNPE_RUNTIME '" << name << "'. Options in this build: " << options << std::endl;
+    std::exit(1);
+}
+
+static ResizeMode parse_resize_mode(const std::string& name) {
+    const std::unordered_map<std::string, ResizeMode> map = {
+        {"bilinear", ResizeMode::Bilinear},
+        {"area",     ResizeMode::Area},
+    };
+    auto it = map.find(name);
+    if (it != map.end()) return it->second;
+
+    std::cerr << "Unknown RESIZE_MODE '" << name << "'. Options: bilinear, area" << std::endl;
     std::exit(1);
 }
 
@@ -49,16 +106,46 @@ int main() {
     int port = std::atoi(env_or("PORT", "8099").c_str());
 
     auto runtime = parse_runtime(runtime_str);
-    std::cout << "Runtime:  " << runtime_str << std::endl;
-    std::cout << "Model:    " << model_path << std::endl;
-    std::cout << "Labels:   " << labels_path << std::endl;
-
-    SnpeWorker worker(model_path, labels_path, runtime);
+    if (runtime_str == "standin") {
+        std::cerr << "WARNING: SNPE_RUNTIME=standin classifies with random weights; for testing only" << std::endl;
+    }
+    int instances = std::atoi(env_or("INFERENCE_INSTANCES", std::to_string(runtime.default_instances)).c_str());
+    int batch_size = std::atoi(env_or("INFERENCE_BATCH_SIZE", "1").c_str());
+    double batch_window_ms = std::atof(env_or("BATCH_WINDOW_MS", "2").c_str());
+    std::string resize_mode = env_or("RESIZE_MODE", "bilinear");
+    int resize_threads = std::atoi(env_or("RESIZE_THREADS", "1").c_str());
+    if (instances < 1 || batch_size < 1 || batch_window_ms < 0 || resize_threads < 1) {
+        std::cerr << "INFERENCE_INSTANCES, INFERENCE_BATCH_SIZE and RESIZE_THREADS must be at least 1, "
+                  << "BATCH_WINDOW_MS at least 0" << std::endl;
+        return 1;
+    }
+
+    PreprocessOptions preprocess;
+    preprocess.resize_mode = parse_resize_mode(resize_mode);
+    preprocess.threads = static_cast<unsigned>(resize_threads);
+    if (preprocess.threads > 1 && !fits_reads_thread_safe()) {
+        std::cerr << "cfitsio is not built reentrant: RESIZE_THREADS ignored" << std::endl;
+        preprocess.threads = 1;
+    }
+    std::cout << "Runtime:   " << runtime_str << std::endl;
+    std::cout << "Instances: " << instances << std::endl;
+    std::cout << "Batch:     " << batch_size << " (window " << batch_window_ms << " ms)" << std::endl;
+    std::cout << "Resize:    " << resize_mode << " (" << preprocess.threads << " threads)" << std::endl;
+    std::cout << "Model:     " << model_path << std::endl;
+    std::cout << "Labels:    " << labels_path << std::endl;
+
+    // Every instance is a separately built network with its own tensors
+    std::vector<std::unique_ptr<InferenceBackend>> networks;
+    for (int i = 0; i < instances; ++i) {
+        networks.push_back(runtime.build(model_path, static_cast<size_t>(batch_size)));
+    }
+    InferencePool pool(std::move(networks), load_labels(labels_path),
+                       std::chrono::microseconds(static_cast<long long>(batch_window_ms * 1000.0)));
 
     crow::SimpleApp app;
 
     CROW_ROUTE(app, "/custom-image-processing/v1/images")
-        .methods(crow::HTTPMethod::POST)([&worker](const crow::request& req) {
+        .methods(crow::HTTPMethod::POST)([&pool, &preprocess](const crow::request& req) {
             std::cerr << "Request body: " << req.body << std::endl;
 
             ProcessImageRequest request;
@@ -73,13 +160,19 @@ int main() {
             }
 
             auto result = process_image(
-                worker,
+                pool,
+                preprocess,
                 request.raw_image_path,
                 request.timeout_seconds);
 
+            const int status = response_status(result);
+            if (result.shed) {
+                std::cerr << "Shed " << request.raw_image_path << ": " << result.error << std::endl;
+                return error_response(status, result.error);
+            }
             if (!result.success) {
                 std::cerr << "Processing failed: " << result.error << std::endl;
-                return error_response(422, result.error);
+                return error_response(status, result.error);
             }
 
             std::cerr << "Predictions for " << request.raw_image_path << ":" << std::endl;
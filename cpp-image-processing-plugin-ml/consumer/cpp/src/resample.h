@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+// Kernels of the FITS preprocessing: a min/max scan over raw pixels, a
+// separable bilinear resize and a box decimation, all working on one source
+// row at a time, so a frame can be resized while it is being read. The range
+// scan, the vertical blend and the channel interleave use 16-byte vectors;
+// the horizontal resize gathers pixels at per-column positions and stays
+// scalar.
+
+// Running minimum and maximum of raw pixel values; NaNs are ignored. Empty
+// (min > max) until a number has been seen.
+template <typename T>
+struct PixelRange {
+    T min = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                 : std::numeric_limits<T>::max();
+    T max = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+                                                 : std::numeric_limits<T>::lowest();
+
+    void add(const PixelRange& other) {
+        min = other.min < min ? other.min : min;
+        max = max < other.max ? other.max : max;
+    }
+};
+
+// Extends `range` over n pixels, 16 bytes at a time (GCC/Clang vector
+// extensions: NEON on aarch64, SSE on x86-64). The comparisons are written so
+// that a NaN never replaces a number.
+template <typename T>
+void scan_range(const T* pixels, size_t n, PixelRange<T>& range) {
+    typedef T Vec __attribute__((vector_size(16)));
+    constexpr size_t kLanes = sizeof(Vec) / sizeof(T);
+
+    size_t i = 0;
+    if (n >= kLanes) {
+        Vec lo, hi;
+        for (size_t k = 0; k < kLanes; ++k) {
+            lo[k] = range.min;
+            hi[k] = range.max;
+        }
+        for (; i + kLanes <= n; i += kLanes) {
+            Vec v;
+            std::memcpy(&v, pixels + i, sizeof(Vec));
+            lo = v < lo ? v : lo;
+            hi = hi < v ? v : hi;
+        }
+        for (size_t k = 0; k < kLanes; ++k) {
+            range.add({lo[k], hi[k]});
+        }
+    }
+    for (; i < n; ++i) {
+        range.add({pixels[i], pixels[i]});
+    }
+}
+
+// Source positions of a bilinear resize along one axis, pixel centers
+// aligned: output i blends source i0[i] and i1[i] with weights (1 - f[i]) and
+// f[i]. Computed once per image instead of once per pixel.
+struct AxisTaps {
+    std::vector<int> i0;
+    std::vector<int> i1;
+    std::vector<float> f;
+
+    void build(int src, int dst) {
+        i0.resize(dst);
+        i1.resize(dst);
+        f.resize(dst);
+        for (int i = 0; i < dst; ++i) {
+            float pos = (i + 0.5f) * src / dst - 0.5f;
+            int lo = std::max(0, static_cast<int>(std::floor(pos)));
+            i0[i] = lo;
+            i1[i] = std::min(src - 1, lo + 1);
+            f[i] = pos - static_cast<float>(lo);
+        }
+    }
+};
+
+// One source row resized horizontally to taps.f.size() floats
+template <typename T>
+void resample_row(const T* src, const AxisTaps& taps, float* dst) {
+    const size_t n = taps.f.size();
+    for (size_t x = 0; x < n; ++x) {
+        float fx = taps.f[x];
+        dst[x] = (1 - fx) * static_cast<float>(src[taps.i0[x]]) +
+                 fx * static_cast<float>(src[taps.i1[x]]);
+    }
+}
+
+// Four floats in a 16-byte vector, as in scan_range
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int32_t Int4 __attribute__((vector_size(16)));
+
+inline Float4 load4(const float* p) {
+    Float4 v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void store4(float* p, Float4 v) {
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// Lanes A..D of the 8 in (a, b)
+template <int A, int B, int C, int D>
+inline Float4 shuffle4(Float4 a, Float4 b) {
+#if defined(__clang__)
+    return __builtin_shufflevector(a, b, A, B, C, D);
+#else
+    return __builtin_shuffle(a, b, Int4{A, B, C, D});
+#endif
+}
+
+// Blend of two horizontally resized rows, mapped to [0, 1] as
+// (v - offset) * scale, four pixels at a time
+inline void blend_rows(const float* row0, const float* row1, float fy, size_t n,
+                       float offset, float scale, float* dst) {
+    const float gy = 1 - fy;
+    size_t x = 0;
+    for (; x + 4 <= n; x += 4) {
+        store4(dst + x, (gy * load4(row0 + x) + fy * load4(row1 + x) - offset) * scale);
+    }
+    for (; x < n; ++x) {
+        dst[x] = (gy * row0[x] + fy * row1[x] - offset) * scale;
+    }
+}
+
+// `planes` rows of n floats (one plane: replicated to every channel) into
+// interleaved (HWC) pixels of `channels` floats. Three channels, the usual
+// model input, are interleaved four pixels (three vectors) at a time.
+inline void interleave_rows(const float* src, size_t planes, size_t n, float* dst, size_t channels) {
+    size_t x = 0;
+    if (channels == 3 && planes == 1) {
+        for (; x + 4 <= n; x += 4) {
+            const Float4 v = load4(src + x);                      // a b c d
+            store4(dst + 3 * x, shuffle4<0, 0, 0, 1>(v, v));      // a a a b
+            store4(dst + 3 * x + 4, shuffle4<1, 1, 2, 2>(v, v));  // b b c c
+            store4(dst + 3 * x + 8, shuffle4<2, 3, 3, 3>(v, v));  // c d d d
+        }
+    } else if (channels == 3 && planes == 3) {
+        for (; x + 4 <= n; x += 4) {
+            const Float4 r = load4(src + x);
+            const Float4 g = load4(src + n + x);
+            const Float4 b = load4(src + 2 * n + x);
+            const Float4 rg = shuffle4<0, 4, 1, 5>(r, g);          // r0 g0 r1 g1
+            const Float4 gb = shuffle4<1, 5, 2, 6>(g, b);          // g1 b1 g2 b2
+            const Float4 rg3 = shuffle4<3, 7, 3, 7>(r, g);         // r3 g3 r3 g3
+            store4(dst + 3 * x, shuffle4<0, 1, 4, 2>(rg, b));      // r0 g0 b0 r1
+            store4(dst + 3 * x + 4, shuffle4<0, 1, 6, 2>(gb, r));  // g1 b1 r2 g2
+            store4(dst + 3 * x + 8, shuffle4<2, 4, 5, 3>(b, rg3)); // b2 r3 g3 b3
+        }
+    }
+    for (; x < n; ++x) {
+        for (size_t c = 0; c < channels; ++c) {
+            dst[x * channels + c] = src[(planes == 1 ? 0 : c) * n + x];
+        }
+    }
+}
+
+// Box (area-average) decimation by integer factors, for shrinking frames many
+// times larger than the model input: every source pixel contributes, where
+// bilinear sampling reads four per output pixel and aliases. Rows are summed
+// into a full-width accumulator, which is collapsed into box averages every
+// `ky` rows. Integer pixels sum exactly, in 64 bits: a box of full-range
+// 16-bit pixels passes 2^31 at 32768 pixels, e.g. 9576x6388 into 32x32.
+template <typename T>
+using BoxSum = typename std::conditional<std::is_floating_point<T>::value, float, int64_t>::type;
+
+template <typename T>
+void accumulate_row(const T* src, size_t n, BoxSum<T>* sums) {
+    for (size_t i = 0; i < n; ++i) {
+        sums[i] += static_cast<BoxSum<T>>(src[i]);
+    }
+}
+
+// Means of `boxes` runs of kx accumulated sums, each over kx * ky pixels
+template <typename S>
+void reduce_boxes(const S* sums, size_t boxes, size_t kx, float inv_area, float* dst) {
+    for (size_t j = 0; j < boxes; ++j) {
+        S total = 0;
+        for (size_t t = 0; t < kx; ++t) {
+            total += sums[j * kx + t];
+        }
+        dst[j] = static_cast<float>(total) * inv_area;
+    }
+}
@@ -0,0 +1,112 @@
+#include "snpe_backend.h"
+
+#include <iostream>
+#include <stdexcept>
+
+#include <SNPE/SNPE/SNPEBuilder.hpp>
+#include <SNPE/SNPE/SNPEFactory.hpp>
+
+SnpeBackend::SnpeBackend(const std::string& dlc_path,
+                         DlSystem::Runtime_t runtime,
+                         size_t max_batch)
+    : max_batch_(max_batch) {
+    auto container = DlContainer::IDlContainer::open(dlc_path);
+    if (!container) {
+        throw std::runtime_error("Failed to open DLC: " + dlc_path);
+    }
+
+    // Verify the requested runtime is available on this platform
+    if (!SNPE::SNPEFactory::isRuntimeAvailable(runtime)) {
+        std::string name = DlSystem::RuntimeList::runtimeToString(runtime);
+        throw std::runtime_error("Runtime not available: " + name);
+    }
+
+    auto build = [&](const DlSystem::TensorShapeMap* input_dimensions) {
+        SNPE::SNPEBuilder builder(container.get());
+        DlSystem::RuntimeList runtime_list(runtime);
+        builder.setRuntimeProcessorOrder(runtime_list)
+               .setPerformanceProfile(DlSystem::PerformanceProfile_t::HIGH_PERFORMANCE);
+        if (input_dimensions) {
+            builder.setInputDimensions(*input_dimensions);
+        }
+
+        snpe_ = builder.build();
+        if (!snpe_) {
+            throw std::runtime_error(
+                std::string("Failed to build SNPE: ") + SNPE::SNPEFactory::getLastError());
+        }
+
+        // Cache input shape for reuse during inference
+        auto dims = snpe_->getInputDimensions();
+        if (!dims) {
+            throw std::runtime_error("Failed to query input dimensions");
+        }
+        tensor_shape_ = *dims;
+    };
+    build(nullptr);
+
+    // Rebuild with the batch dimension resized to max_batch
+    if (max_batch_ > 1 && !(tensor_shape_.rank() == 4 && tensor_shape_[0] == max_batch_)) {
+        auto names = snpe_->getInputTensorNames();
+        if (tensor_shape_.rank() != 4 || !names || (*names).size() != 1) {
+            throw std::runtime_error("Batching needs a model with one NHWC input");
+        }
+        DlSystem::TensorShapeMap input_dimensions;
+        input_dimensions.add((*names).at(0),
+                             DlSystem::TensorShape({max_batch_, tensor_shape_[1],
+                                                    tensor_shape_[2], tensor_shape_[3]}));
+        build(&input_dimensions);
+        if (tensor_shape_[0] != max_batch_) {
+            throw std::runtime_error("Model does not accept a batch of " + std::to_string(max_batch_));
+        }
+    }
+
+    // Extract spatial dimensions assuming NHWC (4D) or HWC (3D) layout
+    if (tensor_shape_.rank() == 4) {
+        input_shape_ = {tensor_shape_[1], tensor_shape_[2], tensor_shape_[3]};
+    } else if (tensor_shape_.rank() == 3) {
+        input_shape_ = {tensor_shape_[0], tensor_shape_[1], tensor_shape_[2]};
+    }
+
+    // The input tensor lives as long as the network; requests write into it
+    // (the raw-data overload of createTensor is for special formats like NV21)
+    input_tensor_ = SNPE::SNPEFactory::getTensorFactory().createTensor(tensor_shape_);
+    if (!input_tensor_) {
+        throw std::runtime_error("Failed to create input tensor");
+    }
+
+    std::cout << "SNPE ready — input " << max_batch_ << "x" << input_shape_.height << "x"
+              << input_shape_.width << "x" << input_shape_.channels
+              << " (" << input_tensor_->getSize() << " floats)" << std::endl;
+}
+
+float* SnpeBackend::input(size_t item) {
+    return &(*input_tensor_->begin()) + item * input_shape_.size();
+}
+
+void SnpeBackend::execute(size_t /*batch*/) {
+    output_map_.clear();
+    output_tensor_ = nullptr;
+    if (!snpe_->execute(input_tensor_.get(), output_map_)) {
+        throw std::runtime_error(
+            std::string("SNPE execute failed: ") + SNPE::SNPEFactory::getLastError());
+    }
+
+    auto names = output_map_.getTensorNames();
+    if (names.size() == 0) {
+        throw std::runtime_error("SNPE returned no output tensors");
+    }
+
+    output_tensor_ = output_map_.getTensor(names.at(0));
+    if (!output_tensor_) {
+        throw std::runtime_error("Failed to retrieve output tensor");
+    }
+}
+
+const float* SnpeBackend::output(size_t item) const {
+    return &(*output_tensor_->begin()) + item * output_size();
+}
+
+size_t SnpeBackend::output_size() const {
+    return output_tensor_ ? output_tensor_->getSize() / max_batch_ : 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "inference_backend.h"
+
+#include <memory>
+#include <string>
+
+#include <SNPE/DlContainer/IDlContainer.hpp>
+#include <SNPE/DlSystem/ITensor.hpp>
+#include <SNPE/DlSystem/TensorMap.hpp>
+#include <SNPE/DlSystem/TensorShape.hpp>
+#include <SNPE/SNPE/SNPE.hpp>
+
+// One SNPE network built from a DLC for a given runtime, with an input
+// tensor created once and an output map reused between executions. With
+// max_batch > 1 the network's batch dimension is resized to it at build
+// time (NHWC models only); a batched network always computes the full batch.
+class SnpeBackend : public InferenceBackend {
+public:
+    SnpeBackend(const std::string& dlc_path,
+                DlSystem::Runtime_t runtime = DlSystem::Runtime_t::CPU_FLOAT32,
+                size_t max_batch = 1);
+
+    const InputShape& input_shape() const override { return input_shape_; }
+    size_t max_batch() const override { return max_batch_; }
+    float* input(size_t item) override;
+    void execute(size_t batch) override;
+    const float* output(size_t item) const override;
+    size_t output_size() const override;
+
+private:
+    size_t max_batch_;
+    std::unique_ptr<SNPE::SNPE> snpe_;
+    DlSystem::TensorShape tensor_shape_;
+    InputShape input_shape_;
+    std::unique_ptr<DlSystem::ITensor> input_tensor_;
+    DlSystem::TensorMap output_map_;
+    DlSystem::ITensor* output_tensor_ = nullptr;
+};
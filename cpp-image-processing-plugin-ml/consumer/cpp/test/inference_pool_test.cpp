@@ -0,0 +1,211 @@
+// InferencePool on the CPU stand-in backend: slot leases, micro-batches and
+// deadline shedding. Exits non-zero if any check fails.
+
+#include "cpu_standin_backend.h"
+#include "image_processor.h"
+#include "inference_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Clock = InferencePool::Clock;
+
+static const InputShape kShape{32, 32, 3};
+static constexpr size_t kClasses = 10;
+
+// Stand-in that records the batch size of every execution
+class RecordingBackend : public CpuStandInBackend {
+public:
+    RecordingBackend(std::chrono::microseconds latency, size_t max_batch)
+        : CpuStandInBackend(kShape, kClasses, latency, max_batch) {}
+
+    void execute(size_t batch) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batches_.push_back(batch);
+        }
+        CpuStandInBackend::execute(batch);
+    }
+
+    std::vector<size_t> batches() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return batches_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<size_t> batches_;
+};
+
+struct TestPool {
+    RecordingBackend* backend;
+    std::unique_ptr<InferencePool> pool;
+};
+
+// One instance, so every execution shows up in `backend`
+static TestPool make_pool(size_t max_batch, std::chrono::microseconds window,
+                          std::chrono::microseconds latency = std::chrono::microseconds(0)) {
+    auto backend = std::make_unique<RecordingBackend>(latency, max_batch);
+    RecordingBackend* recorder = backend.get();
+    std::vector<std::unique_ptr<InferenceBackend>> instances;
+    instances.push_back(std::move(backend));
+    return {recorder, std::make_unique<InferencePool>(std::move(instances), std::vector<std::string>{}, window)};
+}
+
+static std::vector<Classification> classify(InferencePool& pool, float value,
+                                            Clock::time_point deadline = Clock::time_point::max()) {
+    InputSlot slot = pool.acquire(deadline);
+    std::fill(slot.data(), slot.data() + slot.size(), value);
+    return pool.infer(std::move(slot), 3);
+}
+
+static bool deadline_exceeded(const std::function<void()>& call) {
+    try {
+        call();
+    } catch (const DeadlineExceeded&) {
+        return true;
+    }
+    return false;
+}
+
+// Empty string if a leased slot is unavailable to others until it is handed
+// to infer() or dropped, and free again afterwards
+static std::string check_lease_and_release() {
+    TestPool t = make_pool(2, std::chrono::microseconds(0));
+    InferencePool& pool = *t.pool;
+
+    InputSlot first = pool.acquire();
+    InputSlot second = pool.acquire();
+    if (first.size() != kShape.size() || first.data() == second.data()) {
+        return "leases do not get their own input of the model's size";
+    }
+    if (!deadline_exceeded([&] { pool.acquire(Clock::now() + std::chrono::milliseconds(20)); })) {
+        return "a third lease succeeded with both slots leased";
+    }
+
+    // A dropped lease frees its slot without running it
+    first = InputSlot();
+    InputSlot third = pool.acquire(Clock::now() + std::chrono::milliseconds(20));
+    std::fill(third.data(), third.data() + third.size(), 0.5f);
+    std::fill(second.data(), second.data() + second.size(), 0.5f);
+    std::vector<Classification> results;
+    std::thread other([&] { results = pool.infer(std::move(second), 3); });
+    if (pool.infer(std::move(third), 3).size() != 3) {
+        return "infer() did not return top_n results";
+    }
+    other.join();
+    if (results.size() != 3) {
+        return "infer() did not return top_n results";
+    }
+
+    // Both slots are free again once their results are collected
+    InputSlot a = pool.acquire(Clock::now() + std::chrono::milliseconds(20));
+    InputSlot b = pool.acquire(Clock::now() + std::chrono::milliseconds(20));
+    const std::vector<size_t> batches = t.backend->batches();
+    if (std::count(batches.begin(), batches.end(), 0) > 0 || batches.empty()) {
+        return "the dropped lease or an empty batch was executed";
+    }
+    return "";
+}
+
+// Empty string if images arriving within the batch window run as one batch,
+// and a lone image runs by itself once the window has passed
+static std::string check_micro_batches() {
+    const auto window = std::chrono::milliseconds(100);
+    TestPool t = make_pool(4, window);
+    InferencePool& pool = *t.pool;
+
+    const Clock::time_point start = Clock::now();
+    classify(pool, 0.25f);
+    const Clock::duration lone = Clock::now() - start;
+    if (t.backend->batches() != std::vector<size_t>{1}) {
+        return "a lone image did not run as a batch of one";
+    }
+    if (lone < window * 9 / 10) {
+        return "a lone image ran before the batch window closed";
+    }
+
+    std::vector<std::thread> clients;
+    std::vector<std::vector<Classification>> results(4);
+    for (size_t i = 0; i < results.size(); ++i) {
+        clients.emplace_back([&, i] { results[i] = classify(pool, 0.1f * static_cast<float>(i + 1)); });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    if (t.backend->batches() != std::vector<size_t>{1, 4}) {
+        return "four images within the window did not run as one batch of four";
+    }
+
+    // Every image gets its own results back, as if it had run alone
+    for (size_t i = 0; i < results.size(); ++i) {
+        const std::vector<Classification> alone = classify(pool, 0.1f * static_cast<float>(i + 1));
+        if (results[i].empty() || results[i][0].index != alone[0].index ||
+            results[i][0].confidence != alone[0].confidence) {
+            return "batched image " + std::to_string(i) + " got another image's results";
+        }
+    }
+    return "";
+}
+
+// Empty string if requests that cannot finish in time are dropped instead of
+// run: in the batch, up front (503) and while waiting for a slot
+static std::string check_deadline_shedding() {
+    const auto latency = std::chrono::milliseconds(30);
+    TestPool t = make_pool(1, std::chrono::microseconds(0), latency);
+    InferencePool& pool = *t.pool;
+
+    classify(pool, 0.5f);  // Teaches the pool how long a batch takes
+    if (pool.expected_latency() < latency) {
+        return "expected latency is below the measured execution time";
+    }
+
+    // Cancelled by the worker: never reaches the network
+    const size_t executed = t.backend->batches().size();
+    if (!deadline_exceeded([&] { classify(pool, 0.5f, Clock::now() + std::chrono::milliseconds(5)); })) {
+        return "an image that could not finish in time was run";
+    }
+    if (t.backend->batches().size() != executed) {
+        return "a cancelled image reached the network";
+    }
+
+    // Rejected on arrival, answered with 503
+    const ProcessResult shed = process_image(pool, PreprocessOptions(), "/nonexistent.fits", 0.005);
+    if (!shed.shed || response_status(shed) != 503) {
+        return "a request that cannot finish in time was not shed with 503";
+    }
+    const ProcessResult missing = process_image(pool, PreprocessOptions(), "/nonexistent.fits", 10.0);
+    if (missing.shed || response_status(missing) != 422) {
+        return "a missing image with time to spare was not answered with 422";
+    }
+
+    // Gives up waiting for a slot that frees up too late
+    InputSlot held = pool.acquire();
+    if (!deadline_exceeded([&] { pool.acquire(Clock::now() + std::chrono::milliseconds(50)); })) {
+        return "a lease was granted with the only slot held";
+    }
+    return "";
+}
+
+int main() {
+    const std::pair<const char*, std::string (*)()> checks[] = {
+        {"lease and release", &check_lease_and_release},
+        {"micro-batches", &check_micro_batches},
+        {"deadline shedding", &check_deadline_shedding},
+    };
+    int failures = 0;
+    for (const auto& [name, check] : checks) {
+        const std::string error = check();
+        std::cout << name << ": " << (error.empty() ? "ok" : error) << std::endl;
+        failures += error.empty() ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
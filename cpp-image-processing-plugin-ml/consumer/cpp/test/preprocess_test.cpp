@@ -0,0 +1,283 @@
+// FITS preprocessing in both resize modes against a reference computed here
+// from the raw pixels. Takes the path of a frame written by
+// scripts/generate_test_fits.py --synthetic, sized kScale times the model
+// input, so that both modes reduce to simple averages: area mode to the mean
+// of each kScale x kScale box, bilinear to the mean of the 2x2 pixels at its
+// center. Writes two more frames next to it: a bright one with boxes too
+// large for 32-bit sums, one of odd size that leaves rows over at the edges
+// for the threaded area read, and one with a plane per channel. Exits
+// non-zero if any check fails.
+
+#include "image_processor.h"
+#include "inference_backend.h"
+#include "inference_pool.h"
+
+#include <fitsio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+static constexpr size_t kScale = 8;         // Source pixels per model input pixel, each axis
+static const InputShape kShape{48, 64, 3};  // Model input of a 512x384 frame
+static constexpr double kTolerance = 1e-5;  // Of the [0, 1] model input
+
+// 182 x 182 = 33124 full-range pixels per box sum past 2^31
+static constexpr size_t kBrightScale = 182;
+static const InputShape kBrightShape{2, 2, 3};
+
+// Keeps a copy of the model input of every execution; the scores are zero
+class CapturingBackend : public InferenceBackend {
+public:
+    explicit CapturingBackend(InputShape shape) : shape_(shape), input_(shape.size()), output_(1) {}
+
+    const InputShape& input_shape() const override { return shape_; }
+    float* input(size_t) override { return input_.data(); }
+    void execute(size_t) override { captured_ = input_; }
+    const float* output(size_t) const override { return output_.data(); }
+    size_t output_size() const override { return output_.size(); }
+
+    const std::vector<float>& captured() const { return captured_; }
+
+private:
+    InputShape shape_;
+    std::vector<float> input_;
+    std::vector<float> output_;
+    std::vector<float> captured_;
+};
+
+// A pool of one capturing instance
+struct Model {
+    InputShape shape;
+    const CapturingBackend* backend;
+    std::unique_ptr<InferencePool> pool;
+};
+
+static Model make_model(InputShape shape) {
+    auto owned = std::make_unique<CapturingBackend>(shape);
+    const CapturingBackend* backend = owned.get();
+    std::vector<std::unique_ptr<InferenceBackend>> instances;
+    instances.push_back(std::move(owned));
+    return {shape, backend, std::make_unique<InferencePool>(std::move(instances), std::vector<std::string>{})};
+}
+
+struct Frame {
+    long width = 0;
+    long height = 0;
+    long depth = 1;
+    std::vector<double> pixels;  // [plane][row][column]
+
+    double at(size_t x, size_t y, size_t plane) const { return pixels[(plane * height + y) * width + x]; }
+};
+
+static Frame read_frame(const std::string& path) {
+    Frame frame;
+    fitsfile* fptr = nullptr;
+    int status = 0;
+    long naxes[3] = {1, 1, 1};
+    fits_open_file(&fptr, path.c_str(), READONLY, &status);
+    int naxis = 0;
+    fits_get_img_dim(fptr, &naxis, &status);
+    fits_get_img_size(fptr, 3, naxes, &status);
+    frame.width = naxes[0];
+    frame.height = naxes[1];
+    frame.depth = naxis >= 3 ? naxes[2] : 1;
+    frame.pixels.resize(frame.width * frame.height * frame.depth);
+    long fpixel[3] = {1, 1, 1};  // FITS is 1-indexed
+    fits_read_pix(fptr, TDOUBLE, fpixel, static_cast<long>(frame.pixels.size()), nullptr,
+                  frame.pixels.data(), nullptr, &status);
+    if (fptr) {
+        int s = 0;
+        fits_close_file(fptr, &s);
+    }
+    if (status) {
+        throw std::runtime_error("Cannot read " + path);
+    }
+    return frame;
+}
+
+// Writes `pixels` as a 16-bit unsigned image (BITPIX 16, BZERO 32768) of
+// `depth` planes, like a raw camera frame
+static void write_frame(const std::string& path, long width, long height, long depth,
+                        std::vector<uint16_t>& pixels) {
+    fitsfile* fptr = nullptr;
+    int status = 0;
+    long naxes[3] = {width, height, depth};
+    fits_create_file(&fptr, ("!" + path).c_str(), &status);  // '!' overwrites
+    fits_create_img(fptr, USHORT_IMG, depth > 1 ? 3 : 2, naxes, &status);
+    fits_write_img(fptr, TUSHORT, 1, static_cast<long>(pixels.size()), pixels.data(), &status);
+    if (fptr) {
+        int s = 0;
+        fits_close_file(fptr, &s);
+    }
+    if (status) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+// Model input pixel (x, y) from `plane` of a frame `scale` times the input,
+// before normalization
+using Reference = double (*)(const Frame&, size_t scale, size_t x, size_t y, size_t plane);
+
+static double box_mean(const Frame& frame, size_t scale, size_t x, size_t y, size_t plane) {
+    double sum = 0;
+    for (size_t v = 0; v < scale; ++v) {
+        for (size_t u = 0; u < scale; ++u) {
+            sum += frame.at(x * scale + u, y * scale + v, plane);
+        }
+    }
+    return sum / static_cast<double>(scale * scale);
+}
+
+static double center_mean(const Frame& frame, size_t scale, size_t x, size_t y, size_t plane) {
+    const size_t x0 = x * scale + scale / 2 - 1;
+    const size_t y0 = y * scale + scale / 2 - 1;
+    return (frame.at(x0, y0, plane) + frame.at(x0 + 1, y0, plane) + frame.at(x0, y0 + 1, plane) +
+            frame.at(x0 + 1, y0 + 1, plane)) / 4;
+}
+
+// The model input `path` is preprocessed into
+static std::vector<float> preprocess(Model& model, const std::string& path, ResizeMode mode,
+                                     unsigned threads = 1) {
+    PreprocessOptions options;
+    options.resize_mode = mode;
+    options.threads = threads;
+    const ProcessResult result = process_image(*model.pool, options, path, 10.0);
+    if (!result.success) {
+        throw std::runtime_error("preprocessing failed: " + result.error);
+    }
+    return model.backend->captured();
+}
+
+// Empty string if the model input of `path` in `mode` matches `reference`,
+// normalized by the frame's value range, on every channel: from its own
+// plane, or from the only one
+static std::string check_reference(Model& model, const Frame& frame, const std::string& path,
+                                   size_t scale, ResizeMode mode, Reference reference) {
+    const std::vector<float> input = preprocess(model, path, mode);
+    const auto [lo, hi] = std::minmax_element(frame.pixels.begin(), frame.pixels.end());
+    const InputShape& shape = model.shape;
+    double worst = 0;
+    for (size_t y = 0; y < shape.height; ++y) {
+        for (size_t x = 0; x < shape.width; ++x) {
+            for (size_t c = 0; c < shape.channels; ++c) {
+                const size_t plane = frame.depth == 1 ? 0 : c;
+                const double expected = (reference(frame, scale, x, y, plane) - *lo) / (*hi - *lo);
+                worst = std::max(worst, std::abs(input[(y * shape.width + x) * shape.channels + c] - expected));
+            }
+        }
+    }
+    if (worst > kTolerance) {
+        return "differs from the reference by up to " + std::to_string(worst);
+    }
+    return "";
+}
+
+// Empty string if area mode gives bit for bit the same model input read by
+// `threads` threads as by one
+static std::string check_threads(Model& model, const std::string& path, unsigned threads) {
+    if (!fits_reads_thread_safe()) {
+        std::cout << "(cfitsio is not reentrant, threaded read not checked) ";
+        return "";
+    }
+    const std::vector<float> single = preprocess(model, path, ResizeMode::Area, 1);
+    const std::vector<float> threaded = preprocess(model, path, ResizeMode::Area, threads);
+    if (threaded != single) {
+        return "differs from the single-threaded read";
+    }
+    return "";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <frame.fits>" << std::endl;
+        return 2;
+    }
+    const std::string path = argv[1];
+    const std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    const std::string bright_path = (dir / "bright_frame.fits").string();
+    const std::string odd_path = (dir / "odd_frame.fits").string();
+    const std::string rgb_path = (dir / "rgb_frame.fits").string();
+
+    Frame frame;
+    Frame bright;
+    Frame rgb;
+    try {
+        frame = read_frame(path);
+        if (frame.width != static_cast<long>(kShape.width * kScale) ||
+            frame.height != static_cast<long>(kShape.height * kScale)) {
+            std::cerr << "Expected a " << kShape.width * kScale << "x" << kShape.height * kScale
+                      << " frame, got " << frame.width << "x" << frame.height << std::endl;
+            return 2;
+        }
+
+        // Saturated but for one dark pixel, which gives the frame a range
+        const long bright_size = static_cast<long>(kBrightShape.width * kBrightScale);
+        std::vector<uint16_t> pixels(bright_size * bright_size, 65535);
+        pixels[0] = 0;
+        write_frame(bright_path, bright_size, bright_size, 1, pixels);
+        bright = read_frame(bright_path);
+
+        // Not a multiple of the box size either way: boxes are centered, with
+        // rows and columns left over at the edges
+        const long odd_width = 521;
+        const long odd_height = 389;
+        pixels.resize(odd_width * odd_height);
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            pixels[i] = static_cast<uint16_t>((i * 2654435761u) >> 16);
+        }
+        write_frame(odd_path, odd_width, odd_height, 1, pixels);
+
+        // One plane per channel: the synthetic frame, its negative and a ramp
+        const size_t plane_size = frame.pixels.size();
+        pixels.resize(3 * plane_size);
+        for (size_t i = 0; i < plane_size; ++i) {
+            pixels[i] = static_cast<uint16_t>(frame.pixels[i]);
+            pixels[plane_size + i] = static_cast<uint16_t>(65535 - frame.pixels[i]);
+            pixels[2 * plane_size + i] = static_cast<uint16_t>(i % 40000);
+        }
+        write_frame(rgb_path, frame.width, frame.height, 3, pixels);
+        rgb = read_frame(rgb_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    Model model = make_model(kShape);
+    Model bright_model = make_model(kBrightShape);
+
+    const std::pair<const char*, std::function<std::string()>> checks[] = {
+        {"area", [&] { return check_reference(model, frame, path, kScale, ResizeMode::Area, &box_mean); }},
+        {"bilinear", [&] { return check_reference(model, frame, path, kScale, ResizeMode::Bilinear, &center_mean); }},
+        {"area, bright",
+         [&] { return check_reference(bright_model, bright, bright_path, kBrightScale, ResizeMode::Area, &box_mean); }},
+        {"bilinear, bright",
+         [&] { return check_reference(bright_model, bright, bright_path, kBrightScale, ResizeMode::Bilinear, &center_mean); }},
+        {"area, 3 planes", [&] { return check_reference(model, rgb, rgb_path, kScale, ResizeMode::Area, &box_mean); }},
+        {"bilinear, 3 planes",
+         [&] { return check_reference(model, rgb, rgb_path, kScale, ResizeMode::Bilinear, &center_mean); }},
+        {"area, 3 threads", [&] { return check_threads(model, path, 3); }},
+        {"area, 3 threads, odd size", [&] { return check_threads(model, odd_path, 3); }},
+        {"area, 7 threads, odd size", [&] { return check_threads(model, odd_path, 7); }},
+    };
+    int failures = 0;
+    for (const auto& [name, check] : checks) {
+        std::string error;
+        try {
+            error = check();
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        std::cout << name << ": " << (error.empty() ? "ok" : error) << std::endl;
+        failures += error.empty() ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -1,13 +1,20 @@
 #!/usr/bin/env python3
 """Convert a sample InceptionV3 JPEG to a 3-channel FITS file.
 
-Usage: python3 generate_test_fits.py <output_path>
+Usage: python3 generate_test_fits.py <output_path> [--synthetic WIDTHxHEIGHT]
 
 Finds a sample JPEG from the SNPE SDK's InceptionV3 example data and
 writes it as a 3-channel (RGB) FITS file. Requires Pillow (pip install Pillow).
+
+With --synthetic, writes a 16-bit mono star field of the given size instead,
+like a raw camera frame (BITPIX 16, BZERO 32768). It needs neither Pillow nor
+the SDK, and is meant for timing preprocessing on full-size frames.
 """
+import array
 import glob
+import math
 import os
+import random
 import struct
 import sys
 
@@ -69,13 +76,66 @@ def write_fits_rgb(path, pixels, width, height):
         f.write(pixel_data)
 
 
+def write_fits_star_field(path, width, height, stars=400, seed=1):
+    """Write a synthetic 16-bit mono star field: sky background, noise and
+    Gaussian stars of random brightness and width.
+    """
+    cards = [
+        "SIMPLE  =                    T / Standard FITS format",
+        "BITPIX  =                   16 / 16-bit integers",
+        "NAXIS   =                    2 / 2D image",
+        f"NAXIS1  =          {width:>10d} / Image width",
+        f"NAXIS2  =          {height:>10d} / Image height",
+        "BZERO   =                32768 / Unsigned 16-bit data",
+        "BSCALE  =                    1",
+        "END",
+    ]
+    header = b"".join(card.ljust(80).encode("ascii") for card in cards)
+    header += b" " * (-len(header) % 2880)
+
+    rng = random.Random(seed)
+    stars_by_row = {}
+    for _ in range(stars):
+        cx, cy = rng.uniform(0, width), rng.uniform(0, height)
+        sigma = rng.uniform(1.5, 4.0)
+        peak = rng.uniform(500, 40000)
+        radius = int(4 * sigma) + 1
+        for y in range(max(0, int(cy) - radius), min(height, int(cy) + radius + 1)):
+            stars_by_row.setdefault(y, []).append((cx, cy, sigma, peak, radius))
+
+    # Noise rows are drawn from a small pool at random offsets: the values
+    # only need to look like sky, and this keeps large frames quick to write
+    noise = array.array("H", (1000 + int(rng.gauss(0, 12)) for _ in range(width * 2)))
+    with open(path, "wb") as f:
+        f.write(header)
+        for y in range(height):
+            start = rng.randrange(width)
+            row = noise[start:start + width]
+            for cx, cy, sigma, peak, radius in stars_by_row.get(y, ()):
+                dy2 = (y - cy) ** 2
+                for x in range(max(0, int(cx) - radius), min(width, int(cx) + radius + 1)):
+                    value = row[x] + peak * math.exp(-((x - cx) ** 2 + dy2) / (2 * sigma * sigma))
+                    row[x] = min(65535, int(value))
+            signed = array.array("h", (v - 32768 for v in row))
+            if sys.byteorder == "little":
+                signed.byteswap()
+            f.write(signed.tobytes())
+        f.write(b"\0" * (-(width * height * 2) % 2880))
+
+
 def main():
     if len(sys.argv) < 2:
-        print(f"Usage: {sys.argv[0]} <output_path>", file=sys.stderr)
+        print(f"Usage: {sys.argv[0]} <output_path> [--synthetic WIDTHxHEIGHT]", file=sys.stderr)
         sys.exit(1)
 
     out_path = sys.argv[1]
 
+    if len(sys.argv) >= 4 and sys.argv[2] == "--synthetic":
+        width, height = (int(v) for v in sys.argv[3].lower().split("x"))
+        write_fits_star_field(out_path, width, height)
+        print(f"Wrote {width}x{height} 16-bit star field to {out_path}")
+        return
+
     try:
         from PIL import Image
     except ImportError:
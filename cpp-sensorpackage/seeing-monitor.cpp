@@ -0,0 +1,526 @@
+/** External Dependencies */
+#include <flatbuffers/flatbuffers.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/version.hpp>
+#include <boost/endian/conversion.hpp>
+#include <nlohmann/json.hpp>
+#include <opencv2/core.hpp>
+
+/** Generated FlatBuffers Headers */
+#include "ImageResult_generated.h"
+
+/** HFD Engine (../cpp-compute-hfd, header-only) */
+#include "hfd_engine.hpp"
+#include "star_tracker.hpp"
+
+/** Standard Library Dependencies */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct HttpResponseData {
+  unsigned statusCode = 0;
+  std::vector<uint8_t> bodyBytes;
+};
+
+static constexpr uint32_t kMaxFrameBytes = 128u << 20;
+static constexpr size_t kFrameRingCapacity = 2;        // Frames queued for the HFD worker; more are dropped
+static constexpr size_t kRollingWindowFrames = 16;     // Frames in the rolling median HFD
+static constexpr size_t kMinDriftMatches = 3;          // Stars matched across a re-detection to carry the drift over,
+static constexpr double kMinDriftMatchFraction = 0.5;  // and at least this fraction of the re-detected stars
+
+std::optional<HttpResponseData> performHttpRequest(const std::string& serverHostName,
+                                                   const std::string& serverPortString,
+                                                   boost::beast::http::verb httpMethod,
+                                                   const std::string& resourceTargetPath,
+                                                   std::optional<std::string> requestBodyTextOptional = std::nullopt) {
+  try {
+    boost::asio::io_context ioContext;
+    boost::asio::ip::tcp::resolver tcpResolver{ioContext};
+    boost::beast::tcp_stream tcpStream{ioContext};
+
+    auto const resolverResults = tcpResolver.resolve(serverHostName, serverPortString);
+    tcpStream.connect(resolverResults);
+
+    boost::beast::http::request<boost::beast::http::string_body> httpRequestMessage{httpMethod, resourceTargetPath, 11};
+    httpRequestMessage.set(boost::beast::http::field::host, serverHostName);
+    httpRequestMessage.set(boost::beast::http::field::accept_encoding, "identity");  // avoid gzip on binaries
+    if (requestBodyTextOptional) {
+      httpRequestMessage.set(boost::beast::http::field::content_type, "application/json");
+      httpRequestMessage.body() = *requestBodyTextOptional;
+      httpRequestMessage.prepare_payload();  // sets Content-Length
+    }
+    httpRequestMessage.keep_alive(false);
+
+    boost::beast::http::write(tcpStream, httpRequestMessage);
+
+    boost::beast::flat_buffer readBuffer;
+    boost::beast::http::response_parser<boost::beast::http::string_body> httpResponseParser;
+    httpResponseParser.body_limit(static_cast<std::uint64_t>(-1));  // unlimited for large binaries
+
+    boost::beast::http::read(tcpStream, readBuffer, httpResponseParser);
+
+    boost::beast::error_code shutdownErrorCode;
+    tcpStream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, shutdownErrorCode);
+
+    auto httpResponseMessage = httpResponseParser.release();
+
+    HttpResponseData httpResponseData;
+    httpResponseData.statusCode = httpResponseMessage.result_int();
+
+    const std::string& responseBodyString = httpResponseMessage.body();
+    httpResponseData.bodyBytes.assign(
+        reinterpret_cast<const uint8_t*>(responseBodyString.data()),
+        reinterpret_cast<const uint8_t*>(responseBodyString.data()) + responseBodyString.size());
+
+    return httpResponseData;
+  } catch (...) {
+    return std::nullopt;
+  }
+}
+
+static bool readData(boost::asio::ip::tcp::socket& sock, void* data, std::size_t n) {
+  boost::system::error_code ec;
+  boost::asio::read(sock, boost::asio::buffer(data, n), ec);
+  if (ec) {
+    std::cerr << "TCP read error: " << ec.message() << "\n";
+    return false;
+  }
+  return true;
+}
+
+
+// Bounded single-producer / single-consumer ring. Neither side ever waits:
+// tryPush fails on a full ring, tryPop on an empty one. Items are moved in
+// and out, so a slot holding a frame buffer hands over its allocation.
+template <typename T, size_t Capacity>
+class SpscRing {
+ public:
+  bool tryPush(T& item) {  // Moves from item only on success
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = (tail + 1) % kSlots;
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(item);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop(T& item) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(slots_[head]);
+    head_.store((head + 1) % kSlots, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  static constexpr size_t kSlots = Capacity + 1;  // One slot stays free to tell full from empty
+
+  std::array<T, kSlots> slots_;
+  alignas(64) std::atomic<size_t> head_{0};  // Consumer side
+  alignas(64) std::atomic<size_t> tail_{0};  // Producer side
+};
+
+// One size-prefixed ImageResult as read from the socket. The byte vector is
+// recycled between reader and worker, so it only grows.
+struct FrameBuffer {
+  std::vector<uint8_t> bytes;
+  size_t size = 0;               // Bytes of this frame (prefix included)
+  uint64_t frameIndex = 0;       // Position in the stream, dropped frames included
+};
+
+// Pixels of a received frame as a cv::Mat view into its raw_bytes, no copy.
+// The HFD engine measures 16-bit frames, so 8-bit ones are widened into
+// `widened`. Returns an empty Mat if the frame can't be measured.
+static cv::Mat decodeFrame(const FrameBuffer& frame, cv::Mat& widened, std::string& imageId) {
+  // identifier check (pointer includes size prefix)
+  if (!flatbuffers::BufferHasIdentifier(frame.bytes.data(), "OSSP", /*size_prefixed=*/true)) {
+    std::cerr << "  - payload identifier: FAILED (expected OSSP).\n";
+    return cv::Mat();
+  }
+
+  flatbuffers::Verifier verifier(frame.bytes.data(), frame.size);
+  if (!hwdaemon::VerifySizePrefixedImageResultBuffer(verifier)) {
+    std::cerr << "  - verification: FAILED (invalid FlatBuffer).\n";
+    return cv::Mat();
+  }
+
+  const hwdaemon::ImageResult* imageResultTable = hwdaemon::GetSizePrefixedImageResult(frame.bytes.data());
+  const hwdaemon::ImageMetadata* imageMetadataTable = imageResultTable->metadata();
+  const flatbuffers::Vector<uint8_t>* rawBytes = imageResultTable->raw_bytes();
+  if (!imageMetadataTable || !rawBytes) {
+    std::cerr << "  - metadata / raw_bytes: not present\n";
+    return cv::Mat();
+  }
+
+  const int width = imageMetadataTable->width();
+  const int height = imageMetadataTable->height();
+  const size_t bytesPerPixel = imageMetadataTable->bit_depth() > 8 ? 2 : 1;
+  if (width <= 0 || height <= 0 ||
+      rawBytes->size() != static_cast<size_t>(width) * static_cast<size_t>(height) * bytesPerPixel) {
+    std::cerr << "  - raw_bytes: FAILED (" << rawBytes->size() << " bytes for " << width << "x" << height << ", "
+              << static_cast<int>(imageMetadataTable->bit_depth()) << " bit).\n";
+    return cv::Mat();
+  }
+  imageId = imageMetadataTable->image_id() ? imageMetadataTable->image_id()->str() : std::string();
+
+  // Native-endian pixels, as the sensor package writes them on this machine.
+  // The view lives as long as the frame buffer; nothing writes through it.
+  uint8_t* pixels = const_cast<uint8_t*>(rawBytes->data());
+  if (bytesPerPixel == 2) {
+    return cv::Mat(height, width, CV_16UC1, pixels);
+  }
+  cv::Mat(height, width, CV_8UC1, pixels).convertTo(widened, CV_16U, 256.0);
+  return widened;
+}
+
+// Seeing / focus figures published after every measured frame
+struct SeeingSample {
+  float medianHFD = 0.0f;        // This frame (pixels), 0 if no star was measured
+  float rollingMedianHFD = 0.0f; // Over the last kRollingWindowFrames frames with stars
+  size_t starCount = 0;          // Stars with a measured HFD
+  cv::Point2f drift;             // Star motion since the first frame or the last drift reset (pixels)
+  bool redetected = false;       // Stars detected afresh and matched to the last frame's by position
+  bool driftReset = false;       // Too few stars matched across the re-detection: drift starts again at 0
+};
+
+// HFD engine plus star tracker over consecutive measured frames. Tracking
+// measures only stamps around the known stars, which keeps a frame well
+// below the cost of full detection; drift is the tracked motion summed up.
+// After a re-detection the new stars are matched to the last frame's nearest
+// ones, whose median offset carries the drift over.
+class SeeingMonitor {
+ public:
+  explicit SeeingMonitor(unsigned threadCount) : engine_(HFDEngineConfig(), threadCount), tracker_(engine_) {}
+
+  SeeingSample measure(const cv::Mat& frame) {
+    const TrackedFrame tracked = tracker_.track(frame);
+
+    SeeingSample sample;
+    sample.medianHFD = tracked.result.medianHFD;
+    sample.starCount = tracked.result.measuredStars;
+    sample.redetected = tracked.redetected;
+    if (!tracked.redetected) {
+      drift_ += tracked.motion;
+    } else if (!previousStars_.empty()) {
+      cv::Point2f motion;
+      if (matchedMotion(tracker_.tracks(), motion)) {
+        drift_ += motion;
+      } else {
+        drift_ = cv::Point2f();
+        sample.driftReset = true;
+      }
+    }
+    sample.drift = drift_;
+
+    previousStars_.clear();
+    for (const StarTrack& track : tracker_.tracks()) {
+      previousStars_.push_back(track.centroid);
+    }
+
+    if (sample.medianHFD > 0.0f) {
+      recentHFD_.push_back(sample.medianHFD);
+      if (recentHFD_.size() > kRollingWindowFrames) {
+        recentHFD_.pop_front();
+      }
+    }
+    if (!recentHFD_.empty()) {
+      std::vector<float> sorted(recentHFD_.begin(), recentHFD_.end());
+      std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+      sample.rollingMedianHFD = sorted[sorted.size() / 2];
+    }
+    return sample;
+  }
+
+ private:
+  // Median offset of the stars in `tracks` from their nearest star of the last
+  // frame, false if too few are close enough to one (kMinDriftMatches,
+  // kMinDriftMatchFraction): then the offset would be noise. The
+  // engine keeps detected stars half a stamp apart, so within a quarter stamp
+  // a star matches at most one.
+  bool matchedMotion(const std::vector<StarTrack>& tracks, cv::Point2f& motion) {
+    const float maxDistance = engine_.config().stampSize / 4.0f;
+    motionX_.clear();
+    motionY_.clear();
+    for (const StarTrack& track : tracks) {
+      float bestDistance = maxDistance * maxDistance;
+      const cv::Point2f* nearest = nullptr;
+      for (const cv::Point2f& previous : previousStars_) {
+        const cv::Point2f offset = track.centroid - previous;
+        const float distance = offset.x * offset.x + offset.y * offset.y;
+        if (distance <= bestDistance) {
+          bestDistance = distance;
+          nearest = &previous;
+        }
+      }
+      if (nearest) {
+        motionX_.push_back(track.centroid.x - nearest->x);
+        motionY_.push_back(track.centroid.y - nearest->y);
+      }
+    }
+    if (motionX_.size() < kMinDriftMatches ||
+        static_cast<double>(motionX_.size()) < kMinDriftMatchFraction * static_cast<double>(tracks.size())) {
+      return false;
+    }
+    motion = cv::Point2f(static_cast<float>(computeMedian(motionX_)), static_cast<float>(computeMedian(motionY_)));
+    return true;
+  }
+
+  HFDEngine engine_;
+  StarTracker tracker_;
+  cv::Point2f drift_;
+  std::vector<cv::Point2f> previousStars_;   // Star positions of the last measured frame
+  std::deque<float> recentHFD_;
+
+  // Scratch of matchedMotion, kept for its capacity
+  std::vector<double> motionX_;
+  std::vector<double> motionY_;
+};
+
+int main() {
+  const std::string serverHostName = "localhost";
+  const std::string serverPortString = "9080";
+
+  // Query connected cameras
+  std::cout << "Querying connected cameras..." << std::endl;
+
+  std::optional<HttpResponseData> connectedCamerasResponse = performHttpRequest(
+      serverHostName, serverPortString, boost::beast::http::verb::get, "/sensor-package/v1/connected-cameras");
+
+  if (!connectedCamerasResponse || connectedCamerasResponse->statusCode != 200) {
+    std::cerr << "Failed to fetch connected cameras." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string connectedCamerasResponseBodyText(connectedCamerasResponse->bodyBytes.begin(),
+                                               connectedCamerasResponse->bodyBytes.end());
+
+  nlohmann::json connectedCamerasDocument = nlohmann::json::parse(connectedCamerasResponseBodyText);
+
+  if (!connectedCamerasDocument.is_array() || connectedCamerasDocument.empty()) {
+    std::cerr << "No cameras found. Exiting..." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Connected cameras (" << connectedCamerasDocument.size() << "):" << std::endl;
+  for (const nlohmann::json& cameraObject : connectedCamerasDocument) {
+    if (cameraObject.is_object()) {
+      const std::string cameraIdentifierString = cameraObject.value("id", std::string{});
+      const std::string cameraDisplayNameString = cameraObject.value("name", std::string{});
+      std::cout << "  - id: \"" << cameraIdentifierString << "\""
+                << (cameraDisplayNameString.empty() ? "" : std::string{", name: \"" + cameraDisplayNameString + "\""})
+                << std::endl;
+    }
+  }
+
+  // Choose a camera (prefer ZWO if present)
+  std::string chosenCameraIdentifierString = connectedCamerasDocument.front().value("id", std::string{});
+  for (const nlohmann::json& cameraObject : connectedCamerasDocument) {
+    if (cameraObject.is_object()) {
+      const std::string cameraIdentifierString = cameraObject.value("id", std::string{});
+      if (cameraIdentifierString.find("QHY") != std::string::npos) {
+        chosenCameraIdentifierString = cameraIdentifierString;
+        break;
+      }
+    }
+  }
+
+  if (chosenCameraIdentifierString.empty()) {
+    std::cerr << "No usable camera identifier. Exiting..." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Using camera: " << chosenCameraIdentifierString << std::endl;
+
+  // Start continuous image capture
+  std::cout << "Starting continuous exposure..." << std::endl;
+
+  nlohmann::json captureRequestBodyDocument = {{"cameraId", chosenCameraIdentifierString},
+                                               {"exposureSeconds", 1.0},
+                                               {"gain", 50},
+                                               {"binning", 2},
+                                               {"flatCorrection", false},
+                                               {"darkCorrection", false},
+                                               {"plateSolve", false},
+                                               {"createStretchedJPEG", false},
+                                               {"createStretchedJPEGThumbnail", false}};
+
+  std::optional<HttpResponseData> continuousExposureResponse =
+      performHttpRequest(serverHostName, serverPortString, boost::beast::http::verb::post,
+                         "/sensor-package/v1/start-continuous-image-capture",
+                         std::optional<std::string>{captureRequestBodyDocument.dump()});
+
+  if (!continuousExposureResponse || continuousExposureResponse->statusCode != 200) {
+    std::cerr << "Continuous exposure failed." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::string responseBodyText(continuousExposureResponse->bodyBytes.begin(),
+                               continuousExposureResponse->bodyBytes.end());
+
+  nlohmann::json responseDocument = nlohmann::json::parse(responseBodyText);
+
+  bool successResponse = responseDocument.value("success", false);
+  if (!successResponse) {
+    std::cerr << "Continuous exposure failed. Response: " << responseBodyText << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Continuous exposure started successfully!" << std::endl;
+  std::cout << "Response: " << responseBodyText << std::endl;
+
+  boost::asio::io_context streamIoContext;
+  boost::asio::ip::tcp::acceptor frameListenerAcceptor{
+      streamIoContext, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)};
+  const auto port = frameListenerAcceptor.local_endpoint().port();
+
+  std::string streamUrl = "tcp://127.0.0.1:" + std::to_string(port);
+  std::cout << "Stream URL: " << streamUrl << std::endl;
+
+  nlohmann::json streamRequestBodyDocument = {{"streamReceiverUrl", streamUrl}};
+
+  std::optional<HttpResponseData> streamResponse = performHttpRequest(
+      serverHostName, serverPortString, boost::beast::http::verb::post, "/sensor-package/v1/start-stream-frames",
+      std::optional<std::string>{streamRequestBodyDocument.dump()});
+
+  if (!streamResponse || streamResponse->statusCode != 200) {
+    std::cerr << "Streaming failed to start." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Streaming started successfully! Waiting for TCP connection..." << std::endl;
+
+  boost::asio::ip::tcp::socket frameSocket{streamIoContext};
+  frameListenerAcceptor.accept(frameSocket);  // blocks until your sender connects to tcp://127.0.0.1:<port>
+  std::cout << "Sender connected from " << frameSocket.remote_endpoint() << std::endl;
+
+  frameSocket.set_option(boost::asio::ip::tcp::no_delay(true));
+
+  // The socket reader (this thread) hands frames to the HFD worker through a
+  // bounded ring and gets the emptied buffers back through a second one. The
+  // reader never waits for the worker: a frame that finds the ring full is
+  // dropped on the spot and its buffer reused for the next read.
+  SpscRing<FrameBuffer, kFrameRingCapacity> frameRing;          // Reader -> worker
+  SpscRing<FrameBuffer, kFrameRingCapacity + 2> recycleRing;    // Worker -> reader, every buffer fits
+  std::atomic<uint32_t> frameSignal{0};                         // Bumped on every push, the worker waits on it
+  std::atomic<bool> streamEnded{false};
+  std::atomic<uint64_t> receivedFrames{0};
+  std::atomic<uint64_t> droppedFrames{0};
+
+  // One core stays with the reader; the engine spreads each frame over the rest
+  const unsigned hfdThreadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  std::cout << "Measuring HFD on " << hfdThreadCount << " thread(s)\n";
+
+  std::thread hfdWorker([&] {
+    SeeingMonitor seeingMonitor(hfdThreadCount);
+    FrameBuffer frame;
+    cv::Mat widened;
+    std::string imageId;
+    for (;;) {
+      const uint32_t signal = frameSignal.load(std::memory_order_acquire);
+      if (!frameRing.tryPop(frame)) {
+        if (streamEnded.load(std::memory_order_acquire)) {
+          break;
+        }
+        frameSignal.wait(signal, std::memory_order_acquire);
+        continue;
+      }
+
+      const cv::Mat image = decodeFrame(frame, widened, imageId);
+      if (!image.empty()) {
+        const auto measureStart = std::chrono::steady_clock::now();
+        const SeeingSample sample = seeingMonitor.measure(image);
+        const double measureMilliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - measureStart).count();
+
+        std::cout << std::fixed << std::setprecision(2) << "Frame #" << frame.frameIndex << " (" << imageId
+                  << "): HFD " << sample.medianHFD << " px, rolling " << sample.rollingMedianHFD << " px, "
+                  << sample.starCount << " stars, drift (" << sample.drift.x << ", " << sample.drift.y << ") px"
+                  << (sample.redetected ? " [redetected]" : "") << (sample.driftReset ? " [drift reset]" : "")
+                  << ", " << std::setprecision(0)
+                  << measureMilliseconds << " ms | dropped " << droppedFrames.load(std::memory_order_relaxed)
+                  << " of " << receivedFrames.load(std::memory_order_relaxed) << "\n";
+      }
+
+      recycleRing.tryPush(frame);  // Never full; if it were, the buffer would just be freed
+    }
+  });
+
+  uint64_t frameIndex = 0;
+  FrameBuffer buffer;
+
+  for (;;) {
+    uint32_t payloadLength = 0;
+    if (!readData(frameSocket, &payloadLength, sizeof(payloadLength))) {
+      std::cerr << "  - payload length: FAILED (socket read).\n";
+      break;
+    }
+    if (payloadLength == 0 || payloadLength > kMaxFrameBytes) {
+      // The next prefix can't be found after a bad one
+      std::cerr << "  - payload length: FAILED (invalid size " << payloadLength << ").\n";
+      break;
+    }
+
+    // Only the first few frames allocate; after that a buffer comes back from the worker
+    if (buffer.bytes.empty()) {
+      recycleRing.tryPop(buffer);
+    }
+    buffer.size = sizeof(payloadLength) + payloadLength;
+    if (buffer.bytes.size() < buffer.size) {
+      buffer.bytes.resize(buffer.size);
+    }
+
+    // keep prefix + payload contiguous in `buffer.bytes`
+    buffer.bytes[0] = static_cast<uint8_t>(payloadLength & 0xFF);
+    buffer.bytes[1] = static_cast<uint8_t>((payloadLength >> 8) & 0xFF);
+    buffer.bytes[2] = static_cast<uint8_t>((payloadLength >> 16) & 0xFF);
+    buffer.bytes[3] = static_cast<uint8_t>((payloadLength >> 24) & 0xFF);
+
+    if (!readData(frameSocket, buffer.bytes.data() + sizeof(payloadLength), payloadLength)) {
+      std::cerr << "  - payload read: FAILED (socket read).\n";
+      break;
+    }
+    buffer.frameIndex = frameIndex++;
+    receivedFrames.fetch_add(1, std::memory_order_relaxed);
+
+    if (frameRing.tryPush(buffer)) {
+      buffer = FrameBuffer();
+      frameSignal.fetch_add(1, std::memory_order_release);
+      frameSignal.notify_one();
+    } else {
+      droppedFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  streamEnded.store(true, std::memory_order_release);
+  frameSignal.fetch_add(1, std::memory_order_release);
+  frameSignal.notify_one();
+  hfdWorker.join();
+
+  std::cout << "Frames received: " << receivedFrames.load() << ", dropped: " << droppedFrames.load() << "\n";
+
+  boost::system::error_code ec;
+  frameSocket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+  frameSocket.close(ec);
+
+  return EXIT_SUCCESS;
+}